@@ -2,9 +2,15 @@
 #include <iostream>
 #include <vector>
 #include <string>
+#include <cstdlib>
 #include "clr_interpret.hpp"
 #include "clr_types.hpp"
 #include "clr_base_functions.hpp"
+#include "clr_session.hpp"
+#include "clr_arrays.hpp"
+#include "clr_memstat.hpp"
+#include "clr_trace.hpp"
+#include "clr_reload.hpp"
 #include "IEGA/string_manip.hpp"
 
 #define FUNCTION_LIST_FILE "/usr/local/share/clr/interpreted_functions.list"
@@ -17,61 +23,128 @@
 
 using namespace std;
 
+/*
+Formats a register for the display printed after each command.
+*/
+string regstr(const clr_value& v){
+    if (v.arr) return valuestr(v);
+    return dtos(v.num.real(), 4, 3);
+}
+
 int main(int argc, char** argv){
 
     //********************************************************//
     //******************* INITIALIZE STATE *******************//
 
     bool run_dev_mode = false;
-    for (size_t i = 0 ; i < argc ; i++){
+    string session_path = "";
+    vector<string> load_paths;
+    string record_path = "";
+    string replay_path = "";
+    size_t replay_threads = 1;
+    size_t replay_sessions = 1;
+    for (int i = 0 ; i < argc ; i++){
         if (to_uppercase(argv[i]) == "-DEV"){
             cout << "Starting CLR in developer mode." << endl;
             run_dev_mode = true;
+        }else if (to_uppercase(argv[i]) == "-SESSION" && i+1 < argc){ //Persist registers & variables in a session file
+            session_path = argv[++i];
+        }else if (to_uppercase(argv[i]) == "-LOAD" && i+1 < argc){ //Load a CSV file into array variables before starting
+            load_paths.push_back(argv[++i]);
+        }else if ((to_uppercase(argv[i]) == "-RECORD" || to_uppercase(argv[i]) == "--RECORD") && i+1 < argc){ //Record input lines to a trace file
+            record_path = argv[++i];
+        }else if ((to_uppercase(argv[i]) == "-REPLAY" || to_uppercase(argv[i]) == "--REPLAY") && i+1 < argc){ //Replay a trace file as a benchmark, then exit
+            replay_path = argv[++i];
+        }else if ((to_uppercase(argv[i]) == "-THREADS" || to_uppercase(argv[i]) == "--THREADS") && i+1 < argc){ //Replay the trace in this many sessions at once, one per thread
+            replay_threads = strtoul(argv[++i], NULL, 10);
+        }else if ((to_uppercase(argv[i]) == "-SESSIONS" || to_uppercase(argv[i]) == "--SESSIONS") && i+1 < argc){ //Replay the trace in this many sessions, taking turns on the threads
+            replay_sessions = strtoul(argv[++i], NULL, 10);
         }
     }
 
     //Create and initialize 'state' object
     clr_state state;
-    state.running = true;
-    state.help_dir = HELP_DIR;
+    init_state(&state, HELP_DIR, &cout); //Empty library (filled with interpreted functions below), critical variables (i+j), zeroed registers
     state.developer_mode = run_dev_mode;
-    fill_keywords(&state); //Populate keywords
-    fill_critical_variables(&state); //Populate critical variables (i+j)
 
-    //Populate functions
-    load_clr_base_functions(&state); //Populate base functions
+    //Populate functions (keywords and base functions are built in - see clr_keywords.cpp & clr_base_functions.cpp)
     if (!load_functions(FUNCTION_LIST_FILE, FUNCTION_DEFAULT_DIR, &state)){
         cout << "Warning: Some interpreted functions failed to load." << endl;
     } //Populate interpreted function
 
+    //Reload functions when their files change
+    clr_reload reload;
+    string reload_err;
+    if (!reload_open(FUNCTION_LIST_FILE, FUNCTION_DEFAULT_DIR, &reload, reload_err)){
+        cout << "Warning: " << reload_err << " Functions will not be reloaded when their files change." << endl;
+    }
+
     //Populate functions
     //TODO
     //NOTE: The CLR interpreter requires that a variable named 'i' or 'j' always exist;
 
-    //Initialize registers
-    state.x = 0;
-    state.y = 0;
-    state.z = 0;
-    state.t = 0;
+    //Replay a trace instead of starting the REPL
+    if (replay_path != ""){
+        string err;
+        if (!trace_replay(replay_path, &state, replay_threads, replay_sessions, err)){
+            cout << "ERROR: " << err << endl;
+            return 1;
+        }
+        return 0;
+    }
+
+    //Resume session if requested
+    clr_session session;
+    if (session_path != ""){
+        string err;
+        if (session_open(session_path, &session, err)){
+            session_restore(&session, &state);
+            state.session = &session;
+        }else{
+            cout << "Warning: " << err << " Continuing without a session file." << endl;
+        }
+    }
+
+    //Start recording once the starting state is final
+    clr_trace trace;
+    bool recording = false;
+    if (record_path != ""){
+        string err;
+        recording = trace_open(record_path, &state, &trace, err);
+        if (!recording) cout << "Warning: " << err << " Continuing without recording." << endl;
+    }
 
     string line, print_out;
-    bool success;
+
+    //Load files requested on the command line
+    for (size_t l = 0 ; l < load_paths.size() ; l++){
+        if (recording) trace_line(&trace, "LOAD " + load_paths[l]);
+        if (!interpret_clr("LOAD " + load_paths[l], &state, print_out)){
+            cout << print_out;
+        }
+    }
+
     vector<token> tks;
-    comp last_x, last_y, last_z, last_t;
+    clr_value last_x, last_y, last_z, last_t;
     while (state.running){
         tks.clear();
         cout << "> " << std::flush;
         getline(cin, line);
 
+        reload_poll(&reload, &state); //Pick up edited functions before running the line
         last_x = state.x; last_y = state.y;last_z = state.z; last_t = state.t; //Save register values from before execution...
+        if (recording) trace_line(&trace, line);
+        alloc_stats_begin_line();
         interpret_clr(line, &state, print_out);
+        alloc_stats_end_line();
         cout << print_out;
+        if (state.session != NULL) session_store_registers(state.session, &state);
 
-        if (last_x != state.x || last_y != state.y || last_z != state.z || last_t != state.t){
-            cout << "\tT: " << dtos(state.t.real(), 4, 3) << endl;
-            cout << "\tZ: " << dtos(state.z.real(), 4, 3) << endl;
-            cout << "\tY: " << dtos(state.y.real(), 4, 3) << endl;
-            cout << "\tX: " << dtos(state.x.real(), 4, 3) << endl;
+        if (!same_value(last_x, state.x) || !same_value(last_y, state.y) || !same_value(last_z, state.z) || !same_value(last_t, state.t)){
+            cout << "\tT: " << regstr(state.t) << endl;
+            cout << "\tZ: " << regstr(state.z) << endl;
+            cout << "\tY: " << regstr(state.y) << endl;
+            cout << "\tX: " << regstr(state.x) << endl;
         }
 
         // tks = clr_lex(line, &state, success);
@@ -84,4 +157,7 @@ int main(int argc, char** argv){
         // }
     }
 
+    if (state.session != NULL) session_close(state.session);
+    reload_close(&reload);
+
 }
@@ -0,0 +1,172 @@
+#include "clr_api.h"
+#include "clr_interpret.hpp"
+#include "clr_arrays.hpp"
+#include "clr_sink.hpp"
+#include <sstream>
+#include <cstring>
+#include <new>
+
+using namespace std;
+
+#define CLR_API_HELP_DIR "/usr/local/share/clr/docs/"
+
+/*
+An instance of CLR behind the C interface.
+
+state = Interpreter state. Prints to 'printed', or 'sink_out' if a callback is set.
+printed = Collects what commands print while clr_eval runs
+sink = Passes output to the callback set with clr_set_output. NULL if none.
+sink_out = Stream over 'sink'. NULL if none.
+*/
+struct clr_handle{
+	clr_state state;
+	ostringstream printed;
+	unique_ptr<clr_sink_buffer> sink;
+	unique_ptr<ostream> sink_out;
+};
+
+/*
+Returns the register of 'h' named 'reg', or NULL if there is no such register.
+*/
+static clr_value* find_register(clr_handle* h, char reg){
+	switch (reg){
+		case 'x': case 'X': return &h->state.x;
+		case 'y': case 'Y': return &h->state.y;
+		case 'z': case 'Z': return &h->state.z;
+		case 't': case 'T': return &h->state.t;
+		default: return NULL;
+	}
+}
+
+/*
+Copies 'text' to the caller's buffer, truncating it and NUL terminating it.
+*/
+static void copy_out(const string& text, char* out, size_t out_size, size_t* out_len){
+	if (out_len != NULL) *out_len = text.length();
+	if (out == NULL || out_size == 0) return;
+	size_t n = min(text.length(), out_size-1);
+	memcpy(out, text.data(), n);
+	out[n] = '\0';
+}
+
+clr_handle* clr_create(void){
+	clr_handle* h = new(nothrow) clr_handle();
+	if (h == NULL) return NULL;
+	try{
+		init_state(&h->state, CLR_API_HELP_DIR, &h->printed);
+	}catch (...){
+		delete h;
+		return NULL;
+	}
+	return h;
+}
+
+void clr_destroy(clr_handle* h){
+	delete h;
+}
+
+int clr_eval(clr_handle* h, const char* line, size_t len, char* out, size_t out_size, size_t* out_len){
+
+	h->printed.str("");
+	int status = CLR_OK;
+	try{
+		string input(line, len), print_out;
+		size_t start = 0;
+		while (start <= input.length() && h->state.running){
+			size_t end = input.find('\n', start);
+			if (end == string::npos) end = input.length();
+			bool ran = interpret_clr(input.substr(start, end - start), &h->state, print_out);
+			*h->state.out << print_out;
+			if (!ran){
+				status = CLR_ERROR;
+				break;
+			}
+			start = end + 1;
+		}
+	}catch (const std::exception& e){
+		*h->state.out << "ERROR: " << e.what() << "\n";
+		status = CLR_ERROR;
+	}catch (...){
+		*h->state.out << "ERROR: Unknown exception.\n";
+		status = CLR_ERROR;
+	}
+	h->state.out->flush();
+
+	copy_out(h->printed.str(), out, out_size, out_len);
+	h->printed.str("");
+	return status;
+}
+
+int clr_set_output(clr_handle* h, clr_output_fn fn, void* user){
+	h->state.out = &h->printed;
+	h->sink_out.reset();
+	h->sink.reset();
+	if (fn == NULL) return CLR_OK;
+	try{
+		h->sink.reset(new clr_sink_buffer(fn, user));
+		h->sink_out.reset(new ostream(h->sink.get()));
+	}catch (...){
+		h->sink.reset();
+		return CLR_ERROR;
+	}
+	h->state.out = h->sink_out.get();
+	return CLR_OK;
+}
+
+int clr_get_register(clr_handle* h, char reg, double* re, double* im){
+	clr_value* r = find_register(h, reg);
+	if (r == NULL || r->arr) return CLR_ERROR;
+	*re = r->num.real();
+	*im = r->num.imag();
+	return CLR_OK;
+}
+
+int clr_set_register(clr_handle* h, char reg, double re, double im){
+	clr_value* r = find_register(h, reg);
+	if (r == NULL) return CLR_ERROR;
+	*r = clr_value(comp(re, im));
+	return CLR_OK;
+}
+
+int clr_get_register_array(clr_handle* h, char reg, double* values, size_t size, size_t* length){
+	clr_value* r = find_register(h, reg);
+	if (r == NULL) return CLR_ERROR;
+	if (!r->arr){
+		*length = 1;
+		if (size > 0){
+			values[0] = r->num.real();
+			values[1] = r->num.imag();
+		}
+		return CLR_OK;
+	}
+	*length = r->arr->length;
+	for (size_t k = 0 ; k < r->arr->length && k < size ; k++){
+		values[2*k] = r->arr->data[k].real();
+		values[2*k+1] = r->arr->data[k].imag();
+	}
+	return CLR_OK;
+}
+
+int clr_set_register_array(clr_handle* h, char reg, const double* values, size_t length){
+	clr_value* r = find_register(h, reg);
+	if (r == NULL) return CLR_ERROR;
+	try{
+		shared_ptr<clr_array> arr = new_array(length);
+		for (size_t k = 0 ; k < length ; k++) arr->data[k] = comp(values[2*k], values[2*k+1]);
+		*r = clr_value(shared_ptr<const clr_array>(arr));
+	}catch (...){
+		return CLR_ERROR;
+	}
+	return CLR_OK;
+}
+
+int clr_load_functions(clr_handle* h, const char* list, const char* default_dir){
+	bool loaded;
+	try{
+		loaded = load_functions(list, default_dir, &h->state);
+	}catch (...){
+		loaded = false;
+	}
+	h->printed.str(""); //Nothing to return the messages to
+	return loaded ? CLR_OK : CLR_ERROR;
+}
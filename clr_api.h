@@ -0,0 +1,95 @@
+/*
+This file declares the C interface to the CLR interpreter, built into libclr.a
+and libclr.so (see clr_makefile), so programs can evaluate CLR commands in
+process instead of running the 'clr' binary. Each handle is an independent
+instance of CLR with its own registers, variables and functions. Nothing is
+printed to stdout - whatever a command would print is returned by clr_eval or
+passed to a callback (see clr_set_output).
+
+A handle may only be used by one thread at a time. Separate handles may be used
+on separate threads.
+
+EXAMPLE:
+
+	clr_handle* h = clr_create();
+	clr_load_functions(h, "/usr/local/share/clr/interpreted_functions.list", "/usr/local/share/clr/functions");
+
+	char out[1024];
+	size_t len;
+	if (clr_eval(h, "3 4 +", 5, out, sizeof(out), &len) != CLR_OK) printf("%s", out);
+
+	double re, im;
+	clr_get_register(h, 'x', &re, &im); //re = 7
+
+	clr_destroy(h);
+
+Created by Grant Giesbrecht on 19.10.2026
+
+*/
+
+#include <stddef.h>
+
+#ifndef CLR_API_H
+#define CLR_API_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define CLR_OK 0 //Call succeeded
+#define CLR_ERROR 1 //Call failed. For clr_eval, the output buffer holds the error message.
+
+typedef struct clr_handle clr_handle; //An instance of CLR
+
+//Creates an instance of CLR with no interpreted functions loaded. Returns NULL if out of memory.
+clr_handle* clr_create(void);
+
+//Destroys an instance created by clr_create
+void clr_destroy(clr_handle* h);
+
+/*
+Evaluates 'len' bytes of CLR input starting at 'line' (need not be NUL
+terminated). Lines separated by '\n' are evaluated in order, stopping at the
+first which fails. Everything printed, including error messages, is written to
+'out' (up to 'out_size' bytes, always NUL terminated unless 'out_size' is 0) and
+the full length of the output is written to 'out_len' (if not NULL), so output
+longer than the buffer can be detected. If an output callback is set (see
+clr_set_output), output goes there instead and 'out' is left empty.
+*/
+int clr_eval(clr_handle* h, const char* line, size_t len, char* out, size_t out_size, size_t* out_len);
+
+//Receives 'len' bytes of output (not NUL terminated) and the pointer given to clr_set_output
+typedef void (*clr_output_fn) (const char* text, size_t len, void* user);
+
+/*
+Sends everything printed by later calls of clr_eval to 'fn' (with 'user') as it
+is printed, instead of returning it in clr_eval's output buffer. Output is passed
+on in pieces (at the latest when clr_eval returns) and always by the thread
+calling clr_eval. Pass NULL to return output from clr_eval again.
+*/
+int clr_set_output(clr_handle* h, clr_output_fn fn, void* user);
+
+//Reads register 'reg' ('x', 'y', 'z' or 't'). Fails if it holds an array.
+int clr_get_register(clr_handle* h, char reg, double* re, double* im);
+
+//Sets register 'reg' ('x', 'y', 'z' or 't') to a number
+int clr_set_register(clr_handle* h, char reg, double re, double im);
+
+/*
+Reads the array in register 'reg' (or a number as an array of length 1). Up to
+'size' values are written to 'values' as interleaved real and imaginary parts (so
+'values' needs 2*size doubles) and the array's length to 'length'.
+*/
+int clr_get_register_array(clr_handle* h, char reg, double* values, size_t size, size_t* length);
+
+//Sets register 'reg' to an array of 'length' values, given as interleaved real and imaginary parts
+int clr_set_register_array(clr_handle* h, char reg, const double* values, size_t length);
+
+//Loads the interpreted functions named in the list file at 'list' ($(DEFAULT_DIR) in the list stands for 'default_dir')
+int clr_load_functions(clr_handle* h, const char* list, const char* default_dir);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,293 @@
+#include "clr_arrays.hpp"
+#include "clr_interpret.hpp"
+#include <IEGA/string_manip.hpp>
+#include <sstream>
+
+using namespace std;
+
+/*
+Creates an array of 'length' values, all 0. The values are owned by a
+std::vector held in the array's 'owner'.
+*/
+std::shared_ptr<clr_array> new_array(size_t length){
+	std::shared_ptr<vector<comp> > vals(new vector<comp>(length));
+	std::shared_ptr<clr_array> arr(new clr_array());
+	arr->data = (length > 0) ? &(*vals)[0] : NULL;
+	arr->length = length;
+	arr->owner = vals;
+	return arr;
+}
+
+/*
+Computes 'a' op 'b' for two numbers.
+*/
+static inline comp scalar_binary(char op, comp a, comp b){
+	switch(op){
+		case '+': return a + b;
+		case '-': return a - b;
+		case '*': return a * b;
+		case '/': return a / b;
+		default: return pow(a, b);
+	}
+}
+
+/*
+Computes out[k] = a[k] op b[k] for 'n' values. If 'a_step' or 'b_step' is 0 the
+same value is used for every k (ie. that operand is a number). 'out' may alias
+either operand.
+*/
+static void binary_loop(char op, const comp* a, size_t a_step, const comp* b, size_t b_step, comp* out, size_t n){
+	switch(op){
+		case '+': for (size_t k = 0 ; k < n ; k++) out[k] = a[k*a_step] + b[k*b_step]; break;
+		case '-': for (size_t k = 0 ; k < n ; k++) out[k] = a[k*a_step] - b[k*b_step]; break;
+		case '*': for (size_t k = 0 ; k < n ; k++) out[k] = a[k*a_step] * b[k*b_step]; break;
+		case '/': for (size_t k = 0 ; k < n ; k++) out[k] = a[k*a_step] / b[k*b_step]; break;
+		default: for (size_t k = 0 ; k < n ; k++) out[k] = pow(a[k*a_step], b[k*b_step]); break;
+	}
+}
+
+/*
+Checks that all arrays among the 'count' values in 'vals' have the same length
+and writes it to 'n'. Returns false (and describes the mismatch in 'err') if not,
+or true with n = 0 if none of them are arrays. If any are matrices they must
+have the same shape, and their number of columns is written to 'cols' (0 if
+none are matrices) so the result can have the same shape.
+*/
+static bool common_length(const clr_value* const* vals, size_t count, size_t& n, size_t& cols, string& err){
+	n = 0;
+	cols = 0;
+	bool found = false;
+	for (size_t v = 0 ; v < count ; v++){
+		if (!vals[v]->arr) continue;
+		if (found && vals[v]->arr->length != n){
+			err = "Array lengths do not match (" + to_string(n) + " and " + to_string(vals[v]->arr->length) + ").";
+			return false;
+		}
+		if (vals[v]->arr->cols != 0){
+			if (cols != 0 && vals[v]->arr->cols != cols){
+				err = "Matrix shapes do not match (" + to_string(cols) + " and " + to_string(vals[v]->arr->cols) + " columns).";
+				return false;
+			}
+			cols = vals[v]->arr->cols;
+		}
+		n = vals[v]->arr->length;
+		found = true;
+	}
+	return true;
+}
+
+/*
+Computes {y} op {x} and writes it to 'out'. If either is an array the operation is
+applied element-wise, with a number paired with every element of an array.
+*/
+bool value_binary(char op, const clr_value& y, const clr_value& x, clr_value& out, std::string& err){
+
+	if (!y.arr && !x.arr){
+		out = clr_value(scalar_binary(op, y.num, x.num));
+		return true;
+	}
+
+	const clr_value* vals[2] = {&y, &x};
+	size_t n, cols;
+	if (!common_length(vals, 2, n, cols, err)) return false;
+
+	std::shared_ptr<clr_array> result = new_array(n);
+	result->cols = cols;
+	const comp* a = y.arr ? y.arr->data : &y.num;
+	const comp* b = x.arr ? x.arr->data : &x.num;
+	binary_loop(op, a, y.arr ? 1 : 0, b, x.arr ? 1 : 0, result->data, n);
+
+	out = clr_value(std::shared_ptr<const clr_array>(result));
+	return true;
+}
+
+/*
+Returns true if 'y' should be passed to a base function element by element when
+it's applied to 'n' values: ie. 'y' is an array of the same length. Otherwise
+the number in 'y' is passed with every value. Most base functions ignore 'y', so
+an unrelated array left in {y} must not change the result.
+*/
+static inline bool pair_y(const clr_value& y, size_t n){
+	return (y.arr && y.arr->length == n);
+}
+
+/*
+Evaluates a native function ('fnptr', or 'batchptr' if it's not NULL) for 'x'
+and 'y' and writes the result to 'out'. If {x} is an array the function is
+applied element-wise ({y} is paired with {x} as described in pair_y).
+*/
+bool value_function(comp (*fnptr) (comp, comp), clr_batch_fnptr batchptr, const clr_value& x, const clr_value& y, clr_value& out, std::string& err){
+
+	if (!x.arr){
+		out = clr_value(fnptr(x.num, y.num));
+		return true;
+	}
+
+	size_t n = x.arr->length;
+	bool paired = pair_y(y, n);
+
+	std::shared_ptr<clr_array> result = new_array(n);
+	result->cols = x.arr->cols;
+	comp yb[CLR_FUSE_BLOCK];
+	for (size_t b = 0 ; b < n ; b += CLR_FUSE_BLOCK){
+		size_t m = (n - b < CLR_FUSE_BLOCK) ? n - b : CLR_FUSE_BLOCK;
+		const comp* xp = x.arr->data + b;
+		const comp* yp = paired ? y.arr->data + b : yb;
+		if (!paired) for (size_t k = 0 ; k < m ; k++) yb[k] = y.num;
+
+		if (batchptr != NULL){
+			batchptr(xp, yp, result->data + b, m);
+		}else{
+			for (size_t k = 0 ; k < m ; k++) result->data[b+k] = fnptr(xp[k], yp[k]);
+		}
+	}
+
+	out = clr_value(std::shared_ptr<const clr_array>(result));
+	return true;
+}
+
+/*
+One step of a fused chain.
+
+op = Key symbol (+ - * / ^) to apply with 'operand', or 'f' to apply 'fnptr'
+	(or 'batchptr' if it's not NULL)
+*/
+typedef struct{
+	char op;
+	clr_value operand;
+	comp (*fnptr) (comp, comp);
+	clr_batch_fnptr batchptr;
+}fused_step;
+
+/*
+Looks for a run of element-wise operations starting at trees[start] and, if one
+involves arrays, evaluates the whole run in a single pass without creating
+intermediate arrays.
+
+A run is made of trees of the form "<num or var> <+ - * / ^>", which compute
+{x} = {x} op value and leave {y} and {z} in place, and base functions with no
+argument, which compute {x} = f({x}, {y}). For example "a;b*c+sin" pushes 'a',
+then fuses "b*", "c+" and "sin" into one loop that reads 'a', 'b' and 'c' once
+and writes one result array. The data is processed in blocks of CLR_FUSE_BLOCK
+values so intermediates stay in cache.
+
+'fused' is set to the number of trees evaluated, or 0 if the trees at 'start'
+should be evaluated normally (eg. no arrays are involved or the run is shorter
+than two trees). Returns false if the run can't be evaluated (eg. mismatched
+array lengths), in which case the state is unchanged.
+*/
+bool fuse_elementwise(const std::vector<ast>& trees, size_t start, clr_state* state, size_t& fused, std::string& err){
+
+	fused = 0;
+
+	//Collect steps. A fixed array so lines without arrays don't allocate
+	fused_step steps[CLR_FUSE_MAX_STEPS];
+	size_t nsteps = 0;
+	bool pops = false; //Does any step pop the stack (which zeros {t})?
+	for (size_t t = start ; t < trees.size() && nsteps < CLR_FUSE_MAX_STEPS ; t++){
+		fused_step& step = steps[nsteps];
+		const ast& tree = trees[t];
+		const string& sym = tree.tk.valstr;
+
+		if (tree.tk.type == "ksym" && (sym == "+" || sym == "-" || sym == "*" || sym == "/" || sym == "^") && tree.next.size() == 1){
+			string operand_err;
+			if (!operand_value(tree.next[0].tk, state, step.operand, operand_err)) break; //Leave error to ast_eval
+			step.op = sym[0];
+			step.fnptr = NULL;
+			step.batchptr = NULL;
+			pops = true;
+		}else if (tree.tk.type == "func" && tree.next.size() == 0){
+			const clr_native_function* bf = find_base_function(tree.tk.valstr);
+			const clr_function* fn = (bf == NULL) ? find_function(state, tree.tk.valstr) : NULL;
+			if (bf != NULL){
+				step.fnptr = bf->fnptr;
+				step.batchptr = bf->batchptr;
+			}else if (fn != NULL && !fn->interpreted){
+				step.fnptr = fn->fnptr;
+				step.batchptr = fn->batchptr;
+			}else{
+				break;
+			}
+			step.op = 'f';
+			step.operand = clr_value();
+		}else{
+			break;
+		}
+		nsteps++;
+	}
+	if (nsteps < 2) return true;
+
+	//Find array length. Only fuse if arrays are involved ({y} doesn't count - see pair_y)
+	const clr_value* vals[CLR_FUSE_MAX_STEPS+1];
+	vals[0] = &state->x;
+	for (size_t s = 0 ; s < nsteps ; s++){
+		vals[s+1] = &steps[s].operand; //Number 0 for functions
+	}
+	size_t n, cols;
+	if (!common_length(vals, nsteps+1, n, cols, err)) return false;
+	bool any_array = false;
+	for (size_t v = 0 ; v < nsteps+1 ; v++){
+		if (vals[v]->arr) any_array = true;
+	}
+	if (!any_array) return true;
+	bool paired = pair_y(state->y, n);
+
+	//Evaluate block by block
+	std::shared_ptr<clr_array> result = new_array(n);
+	result->cols = cols;
+	const clr_value& x = state->x;
+	const clr_value& y = state->y;
+	comp yb[CLR_FUSE_BLOCK];
+	for (size_t b = 0 ; b < n ; b += CLR_FUSE_BLOCK){
+		size_t m = (n - b < CLR_FUSE_BLOCK) ? n - b : CLR_FUSE_BLOCK;
+		comp* buf = result->data + b; //Work in the output block - it's written once and stays in cache
+
+		if (x.arr){
+			for (size_t k = 0 ; k < m ; k++) buf[k] = x.arr->data[b+k];
+		}else{
+			for (size_t k = 0 ; k < m ; k++) buf[k] = x.num;
+		}
+
+		for (size_t s = 0 ; s < nsteps ; s++){
+			if (steps[s].op == 'f'){
+				const comp* yp = paired ? y.arr->data + b : yb;
+				if (!paired) for (size_t k = 0 ; k < m ; k++) yb[k] = y.num;
+				if (steps[s].batchptr != NULL){
+					steps[s].batchptr(buf, yp, buf, m);
+				}else{
+					for (size_t k = 0 ; k < m ; k++) buf[k] = steps[s].fnptr(buf[k], yp[k]);
+				}
+			}else{
+				const clr_value& o = steps[s].operand;
+				binary_loop(steps[s].op, buf, 1, o.arr ? o.arr->data + b : &o.num, o.arr ? 1 : 0, buf, m);
+			}
+		}
+	}
+
+	state->x = clr_value(std::shared_ptr<const clr_array>(result));
+	if (pops) state->t = cart(0, 0);
+	fused = nsteps;
+	return true;
+}
+
+/*
+Returns true if 'a' and 'b' hold the same number, or the same array.
+*/
+bool same_value(const clr_value& a, const clr_value& b){
+	return (a.arr == b.arr && a.num == b.num);
+}
+
+/*
+Creates a printable string from 'v'. Numbers print as "(real,imag)", arrays as
+their length and matrices as their shape.
+*/
+std::string valuestr(const clr_value& v){
+	if (v.arr && v.arr->cols != 0){
+		return "[" + to_string(v.arr->length/v.arr->cols) + "x" + to_string(v.arr->cols) + " matrix]";
+	}else if (v.arr){
+		return "[" + to_string(v.arr->length) + " values]";
+	}
+	ostringstream ss;
+	ss << v.num;
+	return ss.str();
+}
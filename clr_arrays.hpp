@@ -0,0 +1,37 @@
+/*
+This file declares element-wise operations on register values (numbers and
+arrays), including the fused evaluation of chains of operations.
+
+Created by Grant Giesbrecht on 19.10.2026
+
+*/
+
+#include <string>
+#include <vector>
+#include "clr_types.hpp"
+
+#ifndef CLR_ARRAYS_HPP
+#define CLR_ARRAYS_HPP
+
+#define CLR_FUSE_BLOCK 1024 //Values per block in fused evaluation (16 KiB, fits in L1/L2 cache)
+#define CLR_FUSE_MAX_STEPS 32 //Max trees fused into one pass. Longer runs are split
+
+//Creates an array of 'length' values, initialized to 0
+std::shared_ptr<clr_array> new_array(size_t length);
+
+//Computes {y} op {x} element-wise. 'op' is one of + - * / ^
+bool value_binary(char op, const clr_value& y, const clr_value& x, clr_value& out, std::string& err);
+
+//Evaluates a native (base or plugin) function element-wise
+bool value_function(comp (*fnptr) (comp, comp), clr_batch_fnptr batchptr, const clr_value& x, const clr_value& y, clr_value& out, std::string& err);
+
+//Evaluates a run of element-wise trees in a single pass, if possible
+bool fuse_elementwise(const std::vector<ast>& trees, size_t start, clr_state* state, size_t& fused, std::string& err);
+
+//Returns true if two values are identical (arrays must be the same array)
+bool same_value(const clr_value& a, const clr_value& b);
+
+//Creates a printable string from a value
+std::string valuestr(const clr_value& v);
+
+#endif
@@ -35,6 +35,29 @@ comp clrbf_log(comp x, comp y);
 comp clrbf_ln(comp x, comp y);
 comp clrbf_abs(comp x, comp y);
 
-void load_clr_base_functions(clr_state* state); //This isn't a base function - instead it loads them into a 'clr_state' struct. It also defines their help screens.
+// Batched versions (see clr_batch_fnptr in clr_types.hpp). These must give the same results as the functions above, to within their documented error.
+
+void clrbf_sin_batch(const comp* x, const comp* y, comp* out, size_t n);
+void clrbf_cos_batch(const comp* x, const comp* y, comp* out, size_t n);
+void clrbf_tan_batch(const comp* x, const comp* y, comp* out, size_t n);
+void clrbf_asin_batch(const comp* x, const comp* y, comp* out, size_t n);
+void clrbf_acos_batch(const comp* x, const comp* y, comp* out, size_t n);
+void clrbf_atan_batch(const comp* x, const comp* y, comp* out, size_t n);
+void clrbf_sinh_batch(const comp* x, const comp* y, comp* out, size_t n);
+void clrbf_cosh_batch(const comp* x, const comp* y, comp* out, size_t n);
+void clrbf_tanh_batch(const comp* x, const comp* y, comp* out, size_t n);
+void clrbf_asinh_batch(const comp* x, const comp* y, comp* out, size_t n);
+void clrbf_acosh_batch(const comp* x, const comp* y, comp* out, size_t n);
+void clrbf_atanh_batch(const comp* x, const comp* y, comp* out, size_t n);
+void clrbf_log_batch(const comp* x, const comp* y, comp* out, size_t n);
+void clrbf_ln_batch(const comp* x, const comp* y, comp* out, size_t n);
+void clrbf_abs_batch(const comp* x, const comp* y, comp* out, size_t n);
+
+//Every base function, with its help page (built at compile time)
+extern const clr_native_function clr_base_functions[];
+extern const size_t clr_base_function_count;
+
+//Returns the base function named 'name' (case insensitive), or NULL if there is none
+const clr_native_function* find_base_function(const std::string& name);
 
 #endif
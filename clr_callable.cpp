@@ -0,0 +1,124 @@
+#include "clr_callable.hpp"
+#include "clr_interpret.hpp"
+#include "clr_base_functions.hpp"
+#include "clr_compile.hpp"
+#include <IEGA/string_manip.hpp>
+
+using namespace std;
+
+/*
+Looks up the function 'name' in 'state' (base functions first, like the
+interpreter) and writes a callable for it to 'out'. The callable keeps 'state's
+current {y}, {z} and {t}, so extra parameters can be passed to the function on
+the stack. Returns false and describes the problem in 'err' if there is no such
+function.
+*/
+bool make_callable(const clr_state* state, const std::string& name, clr_callable& out, std::string& err){
+
+	out.name = to_uppercase(name);
+	out.fnptr = NULL;
+	out.batchptr = NULL;
+	out.fn = NULL;
+	out.library = state->library;
+	out.y = state->y;
+	out.z = state->z;
+	out.t = state->t;
+
+	const clr_native_function* bf = find_base_function(name);
+	if (bf != NULL){
+		out.fnptr = bf->fnptr;
+		out.batchptr = bf->batchptr;
+		return true;
+	}
+
+	const clr_function* lf = find_function(state, name);
+	if (lf == NULL){
+		err = "Function '" + name + "' does not exist.";
+		return false;
+	}
+	if (lf->interpreted){
+		out.fn = lf;
+	}else{
+		out.fnptr = lf->fnptr;
+		out.batchptr = lf->batchptr;
+	}
+
+	return true;
+}
+
+/*
+Calls 'f' on 'x' and writes the resulting {x} to 'out'. The call runs in 'state',
+whose registers are set to 'x' and the callable's stack first, and whose
+variables keep any changes the function makes. Pass a fork (see fork_state) so
+the caller's registers and variables are left alone, and reuse it between calls
+so the variable table is only copied once.
+
+Interpreted functions run their compiled trees. Functions which failed to
+compile are interpreted line by line, as in ast_eval. Returns false and
+describes the problem in 'err' if the function fails or leaves an array in {x}.
+*/
+bool call_callable(const clr_callable& f, clr_state* state, comp x, comp& out, std::string& err){
+
+	if (f.fnptr != NULL){
+		out = f.fnptr(x, f.y.arr ? comp(0, 0) : f.y.num);
+		return true;
+	}
+
+	if (state->call_depth >= CLR_MAX_CALL_DEPTH){
+		err = "Exceeded the maximum of " + dtos(CLR_MAX_CALL_DEPTH, 0, 3) + " nested function calls in '" + f.name + "'. Does it call itself?";
+		return false;
+	}
+
+	state->x = x;
+	state->y = f.y;
+	state->z = f.z;
+	state->t = f.t;
+
+	state->call_depth++;
+	string print_out;
+	size_t line = 0;
+	bool ran = true;
+	if (f.fn->compiled){
+		size_t failed;
+		ran = eval_trees(f.fn->program, state, print_out, failed);
+		if (!ran) line = f.fn->program_lines[failed];
+	}else{
+		for (line = 0 ; line < f.fn->commands.size() && ran ; line++){
+			ran = interpret_clr(f.fn->commands[line], state, print_out);
+		}
+		line--;
+	}
+	state->call_depth--;
+
+	if (!ran){
+		err = "Failed to execute interpreted function '" + f.name + "' on line " + dtos(line, 0, 3) + ".\n" + print_out;
+		return false;
+	}
+	if (state->x.arr){
+		err = "Function '" + f.name + "' returned an array, but a number was expected.";
+		return false;
+	}
+
+	out = state->x.num;
+	return true;
+}
+
+/*
+Calls 'f' on each of the 'n' values in 'x' and writes the results to 'out'. Native
+functions with a batched version are called once for all the values, with the
+callable's {y} repeated as their second argument. Other functions are called one
+value at a time, as by call_callable.
+*/
+bool call_callable_batch(const clr_callable& f, clr_state* state, const comp* x, comp* out, size_t n, std::string& err){
+
+	if (f.batchptr != NULL){
+		vector<comp> y(n, f.y.arr ? comp(0, 0) : f.y.num);
+		f.batchptr(x, y.data(), out, n);
+		return true;
+	}
+
+	for (size_t k = 0 ; k < n ; k++){
+		if (!call_callable(f, state, x[k], out[k], err)) return false;
+	}
+	return true;
+}
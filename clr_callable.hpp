@@ -0,0 +1,50 @@
+/*
+This file declares callables: functions looked up once and then called from C++
+on one number at a time, for keywords which evaluate a function many times (eg.
+ROOT). Calling a callable does not lex or parse anything - native functions are
+called through their pointer and interpreted functions run their compiled trees.
+
+Created by Grant Giesbrecht on 19.10.2026
+
+*/
+
+#include <string>
+#include <vector>
+#include <memory>
+#include "clr_types.hpp"
+
+#ifndef CLR_CALLABLE_HPP
+#define CLR_CALLABLE_HPP
+
+/*
+A function ready to be called.
+
+name = Function name
+fnptr = Native (base or plugin) function, or NULL if the function is interpreted
+batchptr = Batched version of 'fnptr', or NULL if it has none
+fn = Interpreted function, or NULL if the function is native
+library = Keeps 'fn' alive
+y, z, t = Registers the function sees above {x} on every call (the stack when the
+	callable was made)
+*/
+typedef struct{
+	std::string name;
+	comp (*fnptr) (comp, comp);
+	clr_batch_fnptr batchptr;
+	const clr_function* fn;
+	std::shared_ptr<const clr_library> library;
+	clr_value y;
+	clr_value z;
+	clr_value t;
+}clr_callable;
+
+//Looks up the function 'name' in 'state' and prepares it to be called
+bool make_callable(const clr_state* state, const std::string& name, clr_callable& out, std::string& err);
+
+//Calls 'f' with {x} = 'x', running in 'state' (a fork, as its registers are overwritten)
+bool call_callable(const clr_callable& f, clr_state* state, comp x, comp& out, std::string& err);
+
+//Calls 'f' on each of the 'n' values in 'x', using its batched version if it has one
+bool call_callable_batch(const clr_callable& f, clr_state* state, const comp* x, comp* out, size_t n, std::string& err);
+
+#endif
@@ -0,0 +1,147 @@
+#include "clr_compile.hpp"
+#include "clr_interpret.hpp"
+#include <IEGA/string_manip.hpp>
+
+using namespace std;
+
+/*
+Compilation progress of one function.
+
+status = 0 if not started, 1 while its calls are being inlined, 2 when done
+ok = False if the function is not interpreted or its commands failed to parse
+trees = Parsed commands (inlined once status is 2)
+lines = Index in the function's commands each tree came from
+*/
+typedef struct{
+	int status;
+	bool ok;
+	vector<ast> trees;
+	vector<size_t> lines;
+}compile_job;
+
+/*
+Lexes and parses each of 'f's commands into 'job'. Returns false if any command
+fails. Those errors are left to be reported when the function runs.
+*/
+static bool parse_commands(const clr_function& f, clr_state* state, compile_job& job){
+
+	bool success;
+	for (size_t l = 0 ; l < f.commands.size() ; l++){
+		vector<token> tks = clr_lex(f.commands[l], state, success);
+		if (!success) return false;
+		vector<ast> trees = clr_parse(tks, state, success);
+		if (!success) return false;
+		for (size_t t = 0 ; t < trees.size() ; t++){
+			job.trees.push_back(trees[t]);
+			job.lines.push_back(l);
+		}
+	}
+
+	return true;
+}
+
+/*
+Returns the index of the function named 'name' in 'lib', or -1 if there is none
+(or a base function of that name hides it).
+*/
+static long function_index(const clr_library* lib, const string& name){
+	if (find_base_function(name) != NULL) return -1;
+	string uname = to_uppercase(name);
+	for (size_t f = 0 ; f < lib->functions.size() ; f++){
+		if (lib->functions[f].name == uname) return f;
+	}
+	return -1;
+}
+
+/*
+Replaces calls to interpreted functions in jobs[f] with the trees of the called
+function (inlining those first). An argument given to the call becomes a push
+(ie. "2 SQR" becomes "2;" followed by SQR's trees).
+
+A call is left in place if the called function:
+	- is already being inlined (ie. the call is recursive),
+	- failed to parse, or
+	- would make the result longer than CLR_INLINE_BUDGET trees.
+Calls left in place still run the called function's compiled trees, and
+recursion is stopped at run time by CLR_MAX_CALL_DEPTH.
+*/
+static void inline_calls(size_t f, const clr_library* lib, vector<compile_job>& jobs){
+
+	compile_job& job = jobs[f];
+	job.status = 1;
+
+	vector<ast> trees;
+	vector<size_t> lines;
+	for (size_t t = 0 ; t < job.trees.size() ; t++){
+		const ast& tree = job.trees[t];
+
+		long g = -1;
+		if (tree.tk.type == "func" && tree.next.size() <= 1) g = function_index(lib, tree.tk.valstr);
+
+		if (g != -1 && lib->functions[g].interpreted && jobs[g].status != 1){
+			if (jobs[g].status == 0) inline_calls(g, lib, jobs);
+			if (jobs[g].ok && trees.size() + jobs[g].trees.size() + 1 <= CLR_INLINE_BUDGET){
+
+				//Push argument
+				if (tree.next.size() == 1){
+					ast push;
+					push.tk.type = "ksym";
+					push.tk.valstr = ";";
+					push.next.push_back(tree.next[0]);
+					trees.push_back(push);
+					lines.push_back(job.lines[t]);
+				}
+
+				//Add called function's trees. Errors in them report the line of the call
+				trees.insert(trees.end(), jobs[g].trees.begin(), jobs[g].trees.end());
+				lines.insert(lines.end(), jobs[g].trees.size(), job.lines[t]);
+				continue;
+			}
+		}
+
+		trees.push_back(tree);
+		lines.push_back(job.lines[t]);
+	}
+
+	job.trees.swap(trees);
+	job.lines.swap(lines);
+	job.status = 2;
+}
+
+/*
+Compiles every interpreted function in 'state's library: each function's
+commands are parsed once and calls to other interpreted functions are inlined,
+so running the function needs no lexing or parsing and no nested calls.
+
+Compiled trees depend on which names are functions and keywords, so this must be
+run again whenever functions are added to the library. Functions whose commands
+fail to parse are left uncompiled and are interpreted line by line.
+*/
+void compile_functions(clr_state* state){
+
+	clr_library* lib = writable_library(state);
+
+	//Parse every function
+	vector<compile_job> jobs(lib->functions.size());
+	for (size_t f = 0 ; f < lib->functions.size() ; f++){
+		jobs[f].ok = lib->functions[f].interpreted && parse_commands(lib->functions[f], state, jobs[f]);
+		jobs[f].status = jobs[f].ok ? 0 : 2;
+	}
+
+	//Inline calls
+	for (size_t f = 0 ; f < jobs.size() ; f++){
+		if (jobs[f].status == 0) inline_calls(f, lib, jobs);
+	}
+
+	//Save programs
+	for (size_t f = 0 ; f < lib->functions.size() ; f++){
+		clr_function& fn = lib->functions[f];
+		fn.compiled = jobs[f].ok;
+		fn.program.swap(jobs[f].trees);
+		fn.program_lines.swap(jobs[f].lines);
+		if (!fn.compiled){
+			fn.program.clear();
+			fn.program_lines.clear();
+		}
+	}
+}
@@ -0,0 +1,23 @@
+/*
+This file declares the compiler for interpreted functions. Compiling parses each
+function's commands once, when the function is loaded, and inlines calls to other
+interpreted functions so layered functions run as one flat list of trees.
+
+Created by Grant Giesbrecht on 19.10.2026
+
+*/
+
+#include <string>
+#include <vector>
+#include "clr_types.hpp"
+
+#ifndef CLR_COMPILE_HPP
+#define CLR_COMPILE_HPP
+
+#define CLR_INLINE_BUDGET 512 //Max trees in a compiled function. Calls that would exceed it are not inlined
+#define CLR_MAX_CALL_DEPTH 64 //Max nesting of interpreted function calls at run time
+
+//Compiles every interpreted function in 'state's library
+void compile_functions(clr_state* state);
+
+#endif
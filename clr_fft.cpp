@@ -0,0 +1,495 @@
+#include "clr_fft.hpp"
+#include "clr_arrays.hpp"
+#include "clr_parallel.hpp"
+#include <vector>
+#include <map>
+#include <mutex>
+#include <cmath>
+
+using namespace std;
+
+/*
+Transforms are computed by recursive decimation in time. A length n = p*m is split
+into p interleaved sub-transforms of length m (inputs q, q+p, q+2p...), which are
+computed first and then combined by radix-p butterflies. The butterflies work on
+'comp' as interleaved doubles with complex products written out in real arithmetic
+(std::complex's operator* checks for infinities and NaNs with a library call) and
+read their twiddle factors from a table laid out in the same order as the values,
+so the loops over a stage vectorize. Only forward transforms are computed
+directly: the inverse is conj(fft(conj(x)))/n.
+*/
+
+/*
+One level of the recursion.
+
+p = Radix
+m = Length of each sub-transform
+stride = Distance between the inputs of one sub-transform, at this level
+tw = exp(-2 pi i u q stride/n) for q = 1 to p-1, u = 0 to m-1, at index
+	(q-1)*m + u, interleaved
+rot = exp(-2 pi i j/p) for j = 0 to p-1, interleaved (generic radices only)
+*/
+typedef struct{
+	size_t p;
+	size_t m;
+	size_t stride;
+	std::vector<double> tw;
+	std::vector<double> rot;
+}fft_stage;
+
+/*
+A plan for transforms of one length.
+
+n = Length
+stages = Levels of the recursion, outermost first (empty if n is 1 or Bluestein's
+	algorithm is used)
+m = Length of the convolution if Bluestein's algorithm is used, otherwise 0
+chirp = exp(-pi i k^2/n) for k = 0 to n-1, interleaved (Bluestein only)
+filter = Transform of the conjugate chirp, wrapped to length m and scaled by 1/m
+	(Bluestein only)
+sub = Plan for the length m transforms (Bluestein only)
+*/
+struct clr_fft_plan{
+	size_t n;
+	std::vector<fft_stage> stages;
+	size_t m;
+	std::vector<double> chirp;
+	std::vector<double> filter;
+	std::shared_ptr<const clr_fft_plan> sub;
+};
+
+/*
+exp(-2 pi i k/n), written to 'w[0]' and 'w[1]'.
+*/
+static void root(size_t k, size_t n, double* w){
+	double a = -2*M_PI*(double)(k % n)/(double)n;
+	w[0] = cos(a);
+	w[1] = sin(a);
+}
+
+//****************************************************************************
+// BUTTERFLIES
+
+/*
+Each butterfly combines the p sub-transforms held one after another in 'out' (each
+of length st.m) into one transform of length p*m, for u in [u0, u1).
+*/
+
+static void butterfly_2(const fft_stage& st, double* out, size_t u0, size_t u1){
+
+	double* a = out;
+	double* b = out + 2*st.m;
+	const double* w = st.tw.data();
+	for (size_t u = 2*u0 ; u < 2*u1 ; u += 2){
+		double br = b[u]*w[u] - b[u+1]*w[u+1];
+		double bi = b[u]*w[u+1] + b[u+1]*w[u];
+		double ar = a[u], ai = a[u+1];
+		a[u] = ar + br;
+		a[u+1] = ai + bi;
+		b[u] = ar - br;
+		b[u+1] = ai - bi;
+	}
+}
+
+static void butterfly_3(const fft_stage& st, double* out, size_t u0, size_t u1){
+
+	const double h = sqrt(3.0)/2;
+	size_t m2 = 2*st.m;
+	double* x0 = out;
+	double* x1 = out + m2;
+	double* x2 = out + 2*m2;
+	const double* w1 = st.tw.data();
+	const double* w2 = w1 + m2;
+	for (size_t u = 2*u0 ; u < 2*u1 ; u += 2){
+		double ar = x1[u]*w1[u] - x1[u+1]*w1[u+1];
+		double ai = x1[u]*w1[u+1] + x1[u+1]*w1[u];
+		double br = x2[u]*w2[u] - x2[u+1]*w2[u+1];
+		double bi = x2[u]*w2[u+1] + x2[u+1]*w2[u];
+		double sr = ar + br, si = ai + bi;
+		double dr = ar - br, di = ai - bi;
+		double cr = x0[u] - sr/2, ci = x0[u+1] - si/2;
+		x0[u] += sr;
+		x0[u+1] += si;
+		x1[u] = cr + h*di;
+		x1[u+1] = ci - h*dr;
+		x2[u] = cr - h*di;
+		x2[u+1] = ci + h*dr;
+	}
+}
+
+static void butterfly_4(const fft_stage& st, double* out, size_t u0, size_t u1){
+
+	size_t m2 = 2*st.m;
+	double* x0 = out;
+	double* x1 = out + m2;
+	double* x2 = out + 2*m2;
+	double* x3 = out + 3*m2;
+	const double* w1 = st.tw.data();
+	const double* w2 = w1 + m2;
+	const double* w3 = w2 + m2;
+	for (size_t u = 2*u0 ; u < 2*u1 ; u += 2){
+		double ar = x1[u]*w1[u] - x1[u+1]*w1[u+1];
+		double ai = x1[u]*w1[u+1] + x1[u+1]*w1[u];
+		double br = x2[u]*w2[u] - x2[u+1]*w2[u+1];
+		double bi = x2[u]*w2[u+1] + x2[u+1]*w2[u];
+		double cr = x3[u]*w3[u] - x3[u+1]*w3[u+1];
+		double ci = x3[u]*w3[u+1] + x3[u+1]*w3[u];
+		double y0r = x0[u] + br, y0i = x0[u+1] + bi;
+		double y1r = x0[u] - br, y1i = x0[u+1] - bi;
+		double y2r = ar + cr, y2i = ai + ci;
+		double y3r = ar - cr, y3i = ai - ci;
+		x0[u] = y0r + y2r;
+		x0[u+1] = y0i + y2i;
+		x2[u] = y0r - y2r;
+		x2[u+1] = y0i - y2i;
+		x1[u] = y1r + y3i;
+		x1[u+1] = y1i - y3r;
+		x3[u] = y1r - y3i;
+		x3[u+1] = y1i + y3r;
+	}
+}
+
+static void butterfly_5(const fft_stage& st, double* out, size_t u0, size_t u1){
+
+	const double c1 = cos(2*M_PI/5), c2 = cos(4*M_PI/5);
+	const double s1 = sin(2*M_PI/5), s2 = sin(4*M_PI/5);
+	size_t m2 = 2*st.m;
+	double* x0 = out;
+	double* x1 = out + m2;
+	double* x2 = out + 2*m2;
+	double* x3 = out + 3*m2;
+	double* x4 = out + 4*m2;
+	const double* w1 = st.tw.data();
+	const double* w2 = w1 + m2;
+	const double* w3 = w2 + m2;
+	const double* w4 = w3 + m2;
+	for (size_t u = 2*u0 ; u < 2*u1 ; u += 2){
+		double ar = x1[u]*w1[u] - x1[u+1]*w1[u+1];
+		double ai = x1[u]*w1[u+1] + x1[u+1]*w1[u];
+		double br = x2[u]*w2[u] - x2[u+1]*w2[u+1];
+		double bi = x2[u]*w2[u+1] + x2[u+1]*w2[u];
+		double cr = x3[u]*w3[u] - x3[u+1]*w3[u+1];
+		double ci = x3[u]*w3[u+1] + x3[u+1]*w3[u];
+		double dr = x4[u]*w4[u] - x4[u+1]*w4[u+1];
+		double di = x4[u]*w4[u+1] + x4[u+1]*w4[u];
+		double t1r = ar + dr, t1i = ai + di;
+		double t2r = br + cr, t2i = bi + ci;
+		double t3r = ar - dr, t3i = ai - di;
+		double t4r = br - cr, t4i = bi - ci;
+		double pr = x0[u] + c1*t1r + c2*t2r, pi = x0[u+1] + c1*t1i + c2*t2i;
+		double qr = x0[u] + c2*t1r + c1*t2r, qi = x0[u+1] + c2*t1i + c1*t2i;
+		double vr = s1*t3r + s2*t4r, vi = s1*t3i + s2*t4i;
+		double zr = s2*t3r - s1*t4r, zi = s2*t3i - s1*t4i;
+		x0[u] += t1r + t2r;
+		x0[u+1] += t1i + t2i;
+		x1[u] = pr + vi;
+		x1[u+1] = pi - vr;
+		x4[u] = pr - vi;
+		x4[u+1] = pi + vr;
+		x2[u] = qr + zi;
+		x2[u+1] = qi - zr;
+		x3[u] = qr - zi;
+		x3[u+1] = qi + zr;
+	}
+}
+
+/*
+Any radix, as a direct DFT of the p twiddled values (O(p^2) per group).
+*/
+static void butterfly_generic(const fft_stage& st, double* out, size_t u0, size_t u1){
+
+	size_t p = st.p, m = st.m;
+	double s[2*CLR_FFT_MAX_RADIX];
+	for (size_t u = u0 ; u < u1 ; u++){
+		s[0] = out[2*u];
+		s[1] = out[2*u+1];
+		for (size_t q = 1 ; q < p ; q++){
+			const double* x = out + 2*(q*m + u);
+			const double* w = st.tw.data() + 2*((q-1)*m + u);
+			s[2*q] = x[0]*w[0] - x[1]*w[1];
+			s[2*q+1] = x[0]*w[1] + x[1]*w[0];
+		}
+		for (size_t q1 = 0 ; q1 < p ; q1++){
+			double r = s[0], i = s[1];
+			size_t j = 0;
+			for (size_t q = 1 ; q < p ; q++){
+				j += q1;
+				if (j >= p) j -= p;
+				const double* w = st.rot.data() + 2*j;
+				r += s[2*q]*w[0] - s[2*q+1]*w[1];
+				i += s[2*q]*w[1] + s[2*q+1]*w[0];
+			}
+			out[2*(q1*m + u)] = r;
+			out[2*(q1*m + u) + 1] = i;
+		}
+	}
+}
+
+static void butterfly(const fft_stage& st, double* out, size_t u0, size_t u1){
+	switch (st.p){
+		case 2: butterfly_2(st, out, u0, u1); break;
+		case 3: butterfly_3(st, out, u0, u1); break;
+		case 4: butterfly_4(st, out, u0, u1); break;
+		case 5: butterfly_5(st, out, u0, u1); break;
+		default: butterfly_generic(st, out, u0, u1); break;
+	}
+}
+
+//****************************************************************************
+// TRANSFORMS
+
+/*
+Computes the transform for stage 'level' of 'plan' of the values at 'in' (spaced
+by the stage's stride) into 'out'.
+*/
+static void fft_work(const clr_fft_plan* plan, size_t level, const double* in, double* out){
+
+	const fft_stage& st = plan->stages[level];
+	if (st.m == 1){
+		for (size_t q = 0 ; q < st.p ; q++){
+			out[2*q] = in[2*q*st.stride];
+			out[2*q+1] = in[2*q*st.stride + 1];
+		}
+	}else{
+		for (size_t q = 0 ; q < st.p ; q++){
+			fft_work(plan, level+1, in + 2*q*st.stride, out + 2*q*st.m);
+		}
+	}
+	butterfly(st, out, 0, st.m);
+}
+
+/*
+Forward transform of 'in' into 'out' by the mixed radix stages. Long transforms
+split the outermost sub-transforms and the outermost butterflies across threads.
+*/
+static void fft_mixed(const clr_fft_plan* plan, const double* in, double* out){
+
+	if (plan->n < CLR_FFT_GRAIN || plan->stages.size() < 2){
+		fft_work(plan, 0, in, out);
+		return;
+	}
+
+	const fft_stage& st = plan->stages[0];
+	parallel_for(st.p, 1, [&](size_t q0, size_t q1, size_t thread){
+		for (size_t q = q0 ; q < q1 ; q++){
+			fft_work(plan, 1, in + 2*q*st.stride, out + 2*q*st.m);
+		}
+	});
+	parallel_for(st.m, CLR_FFT_GRAIN/st.p, [&](size_t u0, size_t u1, size_t thread){
+		butterfly(st, out, u0, u1);
+	});
+}
+
+/*
+Forward transform of 'in' into 'out' by Bluestein's algorithm: the transform is
+rewritten as the convolution of x[k]*chirp[k] with the conjugate chirp, which is
+computed with transforms of length m (a power of two at least 2n-1).
+*/
+static void fft_bluestein(const clr_fft_plan* plan, const double* in, double* out){
+
+	size_t n = plan->n, m = plan->m;
+	vector<double> a(2*m, 0), b(2*m);
+	const double* w = plan->chirp.data();
+	for (size_t k = 0 ; k < 2*n ; k += 2){
+		a[k] = in[k]*w[k] - in[k+1]*w[k+1];
+		a[k+1] = in[k]*w[k+1] + in[k+1]*w[k];
+	}
+
+	//Convolve: b = conj(fft(a) * filter), then a = conj(fft(b)) is the (scaled) inverse
+	fft_mixed(plan->sub.get(), a.data(), b.data());
+	const double* f = plan->filter.data();
+	for (size_t k = 0 ; k < 2*m ; k += 2){
+		double r = b[k]*f[k] - b[k+1]*f[k+1];
+		double i = b[k]*f[k+1] + b[k+1]*f[k];
+		b[k] = r;
+		b[k+1] = -i;
+	}
+	fft_mixed(plan->sub.get(), b.data(), a.data());
+
+	for (size_t k = 0 ; k < 2*n ; k += 2){
+		out[k] = a[k]*w[k] + a[k+1]*w[k+1];
+		out[k+1] = a[k]*w[k+1] - a[k+1]*w[k];
+	}
+}
+
+static void fft_forward(const clr_fft_plan* plan, const double* in, double* out){
+	if (plan->n <= 1){
+		if (plan->n == 1){
+			out[0] = in[0];
+			out[1] = in[1];
+		}
+	}else if (plan->m > 0){
+		fft_bluestein(plan, in, out);
+	}else{
+		fft_mixed(plan, in, out);
+	}
+}
+
+/*
+Computes the transform of the plan's n values in 'in' into 'out'. The inverse
+transform is scaled by 1/n, so IFFT(FFT(x)) is x.
+*/
+void fft_execute(const clr_fft_plan* plan, const comp* in, comp* out, bool inverse){
+
+	const double* x = reinterpret_cast<const double*>(in);
+	double* y = reinterpret_cast<double*>(out);
+	if (!inverse){
+		fft_forward(plan, x, y);
+		return;
+	}
+
+	size_t n = plan->n;
+	vector<double> c(2*n);
+	for (size_t k = 0 ; k < 2*n ; k += 2){
+		c[k] = x[k];
+		c[k+1] = -x[k+1];
+	}
+	fft_forward(plan, c.data(), y);
+	double s = 1.0/n;
+	for (size_t k = 0 ; k < 2*n ; k += 2){
+		y[k] *= s;
+		y[k+1] *= -s;
+	}
+}
+
+//****************************************************************************
+// PLANS
+
+/*
+Splits 'n' into radices, 4s first then 2 then odd primes in increasing order.
+Returns false if 'n' has a prime factor larger than CLR_FFT_MAX_RADIX.
+*/
+static bool factor(size_t n, vector<size_t>& radices){
+	while (n % 4 == 0){
+		radices.push_back(4);
+		n /= 4;
+	}
+	for (size_t p = 2 ; p <= CLR_FFT_MAX_RADIX && n > 1 ; p++){
+		while (n % p == 0){
+			radices.push_back(p);
+			n /= p;
+		}
+	}
+	return n == 1;
+}
+
+static std::shared_ptr<const clr_fft_plan> make_plan(size_t n){
+
+	clr_fft_plan* plan = new clr_fft_plan();
+	std::shared_ptr<const clr_fft_plan> out(plan);
+	plan->n = n;
+	plan->m = 0;
+	if (n <= 1) return out;
+
+	vector<size_t> radices;
+	if (factor(n, radices)){
+		size_t stride = 1, len = n;
+		for (size_t r = 0 ; r < radices.size() ; r++){
+			fft_stage st;
+			st.p = radices[r];
+			len /= st.p;
+			st.m = len;
+			st.stride = stride;
+			st.tw.resize(2*(st.p-1)*st.m);
+			for (size_t q = 1 ; q < st.p ; q++){
+				for (size_t u = 0 ; u < st.m ; u++){
+					root(u*q*stride, n, &st.tw[2*((q-1)*st.m + u)]);
+				}
+			}
+			if (st.p > 5){
+				st.rot.resize(2*st.p);
+				for (size_t j = 0 ; j < st.p ; j++) root(j, st.p, &st.rot[2*j]);
+			}
+			plan->stages.push_back(st);
+			stride *= st.p;
+		}
+		return out;
+	}
+
+	//Bluestein
+	size_t m = 1;
+	while (m < 2*n-1) m *= 2;
+	plan->m = m;
+	plan->sub = fft_plan(m);
+	plan->chirp.resize(2*n);
+	vector<double> b(2*m, 0);
+	size_t sq = 0; //k^2 mod 2n
+	for (size_t k = 0 ; k < n ; k++){
+		root(sq, 2*n, &plan->chirp[2*k]);
+		b[2*k] = plan->chirp[2*k];
+		b[2*k+1] = -plan->chirp[2*k+1];
+		if (k > 0){
+			b[2*(m-k)] = b[2*k];
+			b[2*(m-k)+1] = b[2*k+1];
+		}
+		sq = (sq + 2*k + 1) % (2*n);
+	}
+	plan->filter.resize(2*m);
+	fft_mixed(plan->sub.get(), b.data(), plan->filter.data());
+	for (size_t k = 0 ; k < 2*m ; k++) plan->filter[k] /= m;
+
+	return out;
+}
+
+static std::mutex plans_lock;
+static std::map<size_t, std::shared_ptr<const clr_fft_plan> > plans;
+static thread_local std::map<size_t, std::shared_ptr<const clr_fft_plan> > thread_plans; //Plans this thread has used, so repeat lookups don't take the lock
+
+/*
+Returns the plan for length 'n'. Plans are immutable, so one plan can be used by
+any number of threads at once. Each thread first looks in its own cache, so
+sessions on different threads only contend for the shared cache the first time
+they use a length.
+*/
+std::shared_ptr<const clr_fft_plan> fft_plan(size_t n){
+
+	std::map<size_t, std::shared_ptr<const clr_fft_plan> >::iterator mine = thread_plans.find(n);
+	if (mine != thread_plans.end()) return mine->second;
+	if (thread_plans.size() >= CLR_FFT_PLAN_CACHE) thread_plans.clear();
+
+	std::shared_ptr<const clr_fft_plan> plan;
+	{
+		std::lock_guard<std::mutex> lock(plans_lock);
+		std::map<size_t, std::shared_ptr<const clr_fft_plan> >::iterator it = plans.find(n);
+		if (it != plans.end()) plan = it->second;
+	}
+
+	if (!plan){
+		plan = make_plan(n); //Not locked: Bluestein plans ask for another plan
+		std::lock_guard<std::mutex> lock(plans_lock);
+		if (plans.size() >= CLR_FFT_PLAN_CACHE) plans.clear();
+		plans[n] = plan;
+	}
+
+	thread_plans[n] = plan;
+	return plan;
+}
+
+/*
+Computes the transform of 'x' into 'out'. A matrix is transformed row by row (in
+parallel) and keeps its shape. A number is its own transform.
+*/
+bool fft_value(const clr_value& x, bool inverse, clr_value& out, std::string& err){
+
+	if (!x.arr){
+		out = x;
+		return true;
+	}
+
+	size_t len = (x.arr->cols > 0) ? x.arr->cols : x.arr->length;
+	size_t rows = (len > 0) ? x.arr->length/len : 0;
+	std::shared_ptr<clr_array> arr = new_array(x.arr->length);
+	arr->cols = x.arr->cols;
+	std::shared_ptr<const clr_fft_plan> plan = fft_plan(len);
+
+	const comp* in = x.arr->data;
+	comp* data = arr->data;
+	parallel_for(rows, (CLR_FFT_GRAIN + len - 1)/max(len, (size_t)1), [&](size_t r0, size_t r1, size_t thread){
+		for (size_t r = r0 ; r < r1 ; r++){
+			fft_execute(plan.get(), in + r*len, data + r*len, inverse);
+		}
+	});
+
+	out = clr_value(std::shared_ptr<const clr_array>(arr));
+	return true;
+}
@@ -0,0 +1,34 @@
+/*
+This file declares the fast Fourier transform. Any length can be transformed:
+lengths whose prime factors are all small use a mixed radix transform, and other
+lengths use Bluestein's algorithm (a convolution computed with a power of two
+transform). The twiddle factors for each length are computed once and cached as
+a plan.
+
+Created by Grant Giesbrecht on 19.10.2026
+
+*/
+
+#include <string>
+#include <memory>
+#include "clr_types.hpp"
+
+#ifndef CLR_FFT_HPP
+#define CLR_FFT_HPP
+
+#define CLR_FFT_MAX_RADIX 32 //Largest prime factor handled directly. Lengths with larger prime factors use Bluestein's algorithm
+#define CLR_FFT_PLAN_CACHE 64 //Max number of plans kept. The cache is emptied when it's full
+#define CLR_FFT_GRAIN (1 << 15) //Min transform length split across threads
+
+struct clr_fft_plan;
+
+//Returns the plan for transforms of length 'n', creating it if it isn't cached
+std::shared_ptr<const clr_fft_plan> fft_plan(size_t n);
+
+//Computes the transform of the 'n' values in 'in' into 'out' (which must not overlap 'in')
+void fft_execute(const clr_fft_plan* plan, const comp* in, comp* out, bool inverse);
+
+//Computes the transform of 'x', or of each row if 'x' is a matrix. The inverse is scaled by 1/n
+bool fft_value(const clr_value& x, bool inverse, clr_value& out, std::string& err);
+
+#endif
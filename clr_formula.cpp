@@ -0,0 +1,203 @@
+#include "clr_formula.hpp"
+#include "clr_interpret.hpp"
+#include "clr_compile.hpp"
+#include <sstream>
+
+using namespace std;
+
+/*
+Returns the index of the variable named 'name' in 'state', or -1 if there is none.
+*/
+static size_t find_variable(const clr_state* state, const string& name){
+	for (size_t v = 0 ; v < state->variables->size() ; v++){
+		if ((*state->variables)[v].name == name) return v;
+	}
+	return -1;
+}
+
+/*
+Returns true if the formula variable 'from' reads 'target', directly or through
+other formulas.
+*/
+static bool depends_on(const clr_state* state, const string& from, const string& target, size_t depth){
+
+	size_t vidx = find_variable(state, from);
+	if (vidx == (size_t)-1 || (*state->variables)[vidx].type != "fml" || depth > state->variables->size()) return false;
+
+	const vector<string>& inputs = (*state->variables)[vidx].formula->inputs;
+	for (size_t i = 0 ; i < inputs.size() ; i++){
+		if (inputs[i] == target || depends_on(state, inputs[i], target, depth+1)) return true;
+	}
+	return false;
+}
+
+/*
+Binds the variable 'name' to the formula made of the tokens 'tks', replacing any
+previous value. The formula is an RPN command line (eg. the tokens of "r;r*pi*")
+whose result is left in {x}. It is evaluated on a clean stack, so it should only
+depend on variables and numbers.
+
+The formula isn't evaluated until it's read, so its inputs need not exist yet.
+Returns false (and describes the problem in 'err') if the formula doesn't parse,
+contains keywords, or depends on 'name' itself.
+*/
+bool define_formula(clr_state* state, std::string name, const std::vector<token>& tks, std::string& err){
+
+	if (!is_valid_name(name)){
+		err = "'" + name + "' is not a valid variable name.";
+		return false;
+	}
+	if (tks.size() < 1){
+		err = "No formula was given for '" + name + "'.";
+		return false;
+	}
+
+	//Check tokens and collect inputs
+	clr_formula* f = new clr_formula();
+	std::shared_ptr<const clr_formula> formula(f);
+	for (size_t t = 0 ; t < tks.size() ; t++){
+		if (tks[t].type != "num" && tks[t].type != "var" && tks[t].type != "ksym" && tks[t].type != "func"){
+			err = "Formulas can only contain numbers, variables, functions and key symbols. Found '" + tks[t].valstr + "'.";
+			return false;
+		}
+
+		if (t > 0) f->text = f->text + " ";
+		if (tks[t].type == "num"){
+			ostringstream ss;
+			ss << tks[t].valnum.real();
+			if (tks[t].valnum.imag() != 0) ss << "+" << tks[t].valnum.imag() << "i";
+			f->text = f->text + ss.str();
+		}else{
+			f->text = f->text + tks[t].valstr;
+		}
+
+		if (tks[t].type == "var"){
+			if (tks[t].valstr == name){
+				err = "The formula for '" + name + "' can not use '" + name + "'.";
+				return false;
+			}
+			bool listed = false;
+			for (size_t i = 0 ; i < f->inputs.size() ; i++){
+				if (f->inputs[i] == tks[t].valstr) listed = true;
+			}
+			if (!listed) f->inputs.push_back(tks[t].valstr);
+		}
+	}
+
+	//Inputs can't depend on this variable (ie. no cycles)
+	for (size_t i = 0 ; i < f->inputs.size() ; i++){
+		if (depends_on(state, f->inputs[i], name, 0)){
+			err = "The formula for '" + name + "' depends on itself through '" + f->inputs[i] + "'.";
+			return false;
+		}
+	}
+
+	bool success;
+	f->program = clr_parse(tks, state, success);
+	if (!success){
+		err = "Failed to parse formula. " + f->program[0].tk.valstr;
+		return false;
+	}
+
+	//Store variable
+	variable v;
+	v.name = name;
+	v.type = "fml";
+	v.valnum = cart(0, 0);
+	v.formula = formula;
+	v.dirty = true;
+
+	mark_dependents_dirty(state, name);
+
+	std::vector<variable>* vars = writable_variables(state);
+	size_t vidx = find_variable(state, name);
+	if (vidx != (size_t)-1){
+		(*vars)[vidx] = v;
+	}else{
+		vars->push_back(v);
+	}
+
+	return true;
+}
+
+/*
+Marks every formula variable which reads 'name', and every formula which reads
+those, as dirty. Call whenever 'name' is given a new value. Formulas which are
+already dirty are skipped, as their dependents were marked when they were.
+*/
+void mark_dependents_dirty(clr_state* state, const std::string& name){
+
+	for (size_t v = 0 ; v < state->variables->size() ; v++){
+		const variable& var = (*state->variables)[v];
+		if (var.type != "fml" || var.dirty) continue;
+
+		const vector<string>& inputs = var.formula->inputs;
+		for (size_t i = 0 ; i < inputs.size() ; i++){
+			if (inputs[i] != name) continue;
+			(*writable_variables(state))[v].dirty = true;
+			mark_dependents_dirty(state, (*state->variables)[v].name);
+			break;
+		}
+	}
+}
+
+/*
+Gets the value of the formula variable (*state->variables)[vidx]. If it's dirty,
+dirty inputs are brought up to date first, then the formula is evaluated on a
+fork of 'state' with clear registers and the result is cached in the variable.
+Returns false (and describes the problem in 'err') if the formula fails.
+*/
+bool formula_value(clr_state* state, size_t vidx, clr_value& out, std::string& err){
+
+	const variable& var = (*state->variables)[vidx];
+	if (!var.dirty){
+		out = var.valarr ? clr_value(var.valarr) : clr_value(var.valnum);
+		return true;
+	}
+
+	std::shared_ptr<const clr_formula> f = var.formula;
+	string name = var.name;
+
+	if (state->call_depth >= CLR_MAX_CALL_DEPTH){
+		err = "Formula '" + name + "' is nested too deeply.";
+		return false;
+	}
+
+	//Update inputs so their values are cached in 'state', not just the fork
+	for (size_t i = 0 ; i < f->inputs.size() ; i++){
+		size_t iidx = find_variable(state, f->inputs[i]);
+		if (iidx == (size_t)-1 || (*state->variables)[iidx].type != "fml" || !(*state->variables)[iidx].dirty) continue;
+
+		clr_value unused;
+		state->call_depth++;
+		bool ok = formula_value(state, iidx, unused, err);
+		state->call_depth--;
+		if (!ok) return false;
+	}
+
+	//Evaluate
+	{
+		clr_state fork = fork_state(state);
+		fork.x = cart(0, 0);
+		fork.y = cart(0, 0);
+		fork.z = cart(0, 0);
+		fork.t = cart(0, 0);
+		fork.call_depth++;
+
+		string print_out;
+		size_t failed;
+		if (!eval_trees(f->program, &fork, print_out, failed)){
+			err = "Failed to compute formula '" + name + "'.\n" + print_out;
+			return false;
+		}
+		out = fork.x;
+	} //Release the fork so caching the result doesn't copy the variable table
+
+	//Cache result
+	variable& v = (*writable_variables(state))[vidx];
+	v.valnum = out.num;
+	v.valarr = out.arr;
+	v.dirty = false;
+
+	return true;
+}
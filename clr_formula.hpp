@@ -0,0 +1,26 @@
+/*
+This file declares formula variables. DEF binds a variable to an RPN formula over
+other variables (eg. "DEF area r;r*pi*"). The formula's value is cached and only
+recomputed, when it is next read, if one of its inputs has been stored to since.
+
+Created by Grant Giesbrecht on 19.10.2026
+
+*/
+
+#include <string>
+#include <vector>
+#include "clr_types.hpp"
+
+#ifndef CLR_FORMULA_HPP
+#define CLR_FORMULA_HPP
+
+//Binds the variable 'name' to the formula in 'tks'
+bool define_formula(clr_state* state, std::string name, const std::vector<token>& tks, std::string& err);
+
+//Marks every formula which depends (directly or not) on 'name' as out of date
+void mark_dependents_dirty(clr_state* state, const std::string& name);
+
+//Gets the value of the formula variable at index 'vidx', recomputing it if needed
+bool formula_value(clr_state* state, size_t vidx, clr_value& out, std::string& err);
+
+#endif
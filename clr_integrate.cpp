@@ -0,0 +1,232 @@
+#include "clr_integrate.hpp"
+#include "clr_interpret.hpp"
+#include "clr_arrays.hpp"
+#include "clr_parallel.hpp"
+#include <IEGA/string_manip.hpp>
+#include <vector>
+#include <sstream>
+#include <algorithm>
+#include <cmath>
+#include <cfloat>
+
+using namespace std;
+
+/*
+The 15 point Kronrod rule and the 7 point Gauss rule it extends (as in QUADPACK's
+QK15). xgk are the Kronrod nodes on [0, 1] (largest first, the Gauss nodes are
+xgk[1], xgk[3] and xgk[5]) and wgk their weights. wg are the Gauss weights, the
+last one for the center.
+*/
+static const double xgk[8] = {
+	0.991455371120812639206854697526329, 0.949107912342758524526189684047851,
+	0.864864423359769072789712788640926, 0.741531185599394439863864773280788,
+	0.586087235467691130294144845693013, 0.405845151377397166906606412076961,
+	0.207784955007898467600689403773245, 0.0};
+static const double wgk[8] = {
+	0.022935322010529224963732008058970, 0.063092092629978553290700663189204,
+	0.104790010322250183839876322541518, 0.140653259715525918745189590510238,
+	0.169004726639267902826583426598550, 0.190350578064785409913256402421014,
+	0.204432940075298892414161999234649, 0.209482141084727828012999174891714};
+static const double wg[4] = {
+	0.129484966168869693270611432679082, 0.279705391489276667901467771423780,
+	0.381830050505118944950369775488975, 0.417959183673469387755102040816327};
+
+#define CLR_INTEG_POINTS 15 //Points per subinterval
+
+/*
+A subinterval and its estimates.
+
+a, b = Ends
+value = Kronrod estimate of the integral
+err = Estimated error of 'value'
+absval = Estimate of the integral of |f|
+*/
+typedef struct{
+	comp a;
+	comp b;
+	comp value;
+	double err;
+	double absval;
+}integ_interval;
+
+/*
+Writes the points at which the rule evaluates f on [a, b] to 'x': the center,
+then each pair of nodes on either side of it.
+*/
+static void rule_points(comp a, comp b, comp* x){
+	comp c = (a + b)/2.0, h = (b - a)/2.0;
+	x[0] = c;
+	for (size_t k = 0 ; k < 7 ; k++){
+		x[1+2*k] = c - h*xgk[k];
+		x[2+2*k] = c + h*xgk[k];
+	}
+}
+
+/*
+Fills in the estimates of 'iv' from the function's values at its rule points.
+The error estimate is QUADPACK's: the difference between the Kronrod and Gauss
+results, scaled to account for the Kronrod result being far more accurate, and
+no smaller than the rounding error of the sum.
+*/
+static void apply_rule(integ_interval& iv, const comp* fv){
+
+	comp h = (iv.b - iv.a)/2.0;
+	double dh = abs(h);
+
+	comp resg = fv[0]*wg[3], resk = fv[0]*wgk[7];
+	double resabs = abs(resk);
+	for (size_t k = 0 ; k < 7 ; k++){
+		comp fsum = fv[1+2*k] + fv[2+2*k];
+		resk += wgk[k]*fsum;
+		resabs += wgk[k]*(abs(fv[1+2*k]) + abs(fv[2+2*k]));
+		if (k % 2 == 1) resg += wg[k/2]*fsum;
+	}
+
+	comp mean = resk*0.5;
+	double resasc = wgk[7]*abs(fv[0] - mean);
+	for (size_t k = 0 ; k < 7 ; k++){
+		resasc += wgk[k]*(abs(fv[1+2*k] - mean) + abs(fv[2+2*k] - mean));
+	}
+
+	iv.value = resk*h;
+	iv.absval = resabs*dh;
+	resasc *= dh;
+	iv.err = abs((resk - resg)*h);
+	if (resasc != 0 && iv.err != 0) iv.err = resasc*min(1.0, pow(200*iv.err/resasc, 1.5));
+	if (iv.absval > DBL_MIN/(50*DBL_EPSILON)) iv.err = max(50*DBL_EPSILON*iv.absval, iv.err);
+}
+
+/*
+Evaluates the rule on each subinterval in 'ivs' listed in 'which'. The points of
+every subinterval are evaluated together, split across threads. Interpreted
+functions run in their thread's state from 'works', which is reset to 'start'
+before every point, so variables the function stores at one point aren't seen at
+any other (and which points share a thread doesn't matter). What they print goes
+to a buffer per thread, written to 'start's output in order once all the points
+are done. Returns false and describes the problem in 'err' if the function fails
+or returns infinity or NaN.
+*/
+static bool evaluate(const clr_callable& f, const clr_state& start, vector<clr_state>& works, vector<integ_interval>& ivs, const vector<size_t>& which, std::string& err){
+
+	size_t n = CLR_INTEG_POINTS*which.size();
+	vector<comp> x(n), fx(n);
+	for (size_t i = 0 ; i < which.size() ; i++){
+		rule_points(ivs[which[i]].a, ivs[which[i]].b, &x[CLR_INTEG_POINTS*i]);
+	}
+
+	vector<string> errs(works.size());
+	vector<char> failed(works.size(), 0);
+	vector<ostringstream> outs(works.size());
+	size_t grain = (f.fn != NULL) ? CLR_INTEG_POINTS : CLR_INTEG_GRAIN;
+	parallel_for(n, grain, [&](size_t begin, size_t end, size_t thread){
+		if (f.fn == NULL){
+			if (!call_callable_batch(f, &works[thread], &x[begin], &fx[begin], end - begin, errs[thread])) failed[thread] = 1;
+			return;
+		}
+		for (size_t k = begin ; k < end ; k++){
+			works[thread] = start;
+			works[thread].out = &outs[thread];
+			if (!call_callable(f, &works[thread], x[k], fx[k], errs[thread])){
+				failed[thread] = 1;
+				return;
+			}
+		}
+	});
+	for (size_t t = 0 ; t < works.size() ; t++) *start.out << outs[t].str();
+	for (size_t t = 0 ; t < works.size() ; t++){
+		if (failed[t]){
+			err = errs[t];
+			return false;
+		}
+	}
+
+	for (size_t k = 0 ; k < n ; k++){
+		if (!std::isfinite(fx[k].real()) || !std::isfinite(fx[k].imag())){
+			err = "Function '" + f.name + "' is not finite at " + valuestr(clr_value(x[k])) + ".";
+			return false;
+		}
+	}
+	for (size_t i = 0 ; i < which.size() ; i++){
+		apply_rule(ivs[which[i]], &fx[CLR_INTEG_POINTS*i]);
+	}
+
+	return true;
+}
+
+/*
+Integrates 'f' along the straight line from 'a' to 'b' (so complex limits
+integrate along a path in the complex plane) and writes the result to 'out'.
+
+Each round, the subintervals with the largest error estimates, together holding
+at least half the total error (and at most CLR_INTEG_ROUND of them), are halved
+and the halves evaluated in parallel. This stops when the total estimated error
+is below 'tol' times the integral of |f|, and fails if that would take more than
+'max_intervals' subintervals or a subinterval becomes too narrow to split (eg.
+at a singularity).
+
+Every point starts from the same fork of 'state' (see evaluate), so 'state' is
+unchanged and the result doesn't depend on the number of threads.
+*/
+bool integrate(const clr_callable& f, const clr_state* state, comp a, comp b, double tol, size_t max_intervals, comp& out, std::string& err){
+
+	if (a == b){
+		out = comp(0, 0);
+		return true;
+	}
+	tol = max(tol, 100*DBL_EPSILON); //Each subinterval's error estimate is at least 50 eps times its integral of |f|
+
+	const clr_state start = fork_state(state);
+	vector<clr_state> works(parallel_threads(), start);
+	vector<integ_interval> ivs(1);
+	ivs[0].a = a;
+	ivs[0].b = b;
+	vector<size_t> which(1, 0);
+	if (!evaluate(f, start, works, ivs, which, err)) return false;
+
+	vector<pair<double, size_t> > order;
+	while (true){
+
+		comp total(0, 0);
+		double err_total = 0, abs_total = 0;
+		for (size_t i = 0 ; i < ivs.size() ; i++){
+			total += ivs[i].value;
+			err_total += ivs[i].err;
+			abs_total += ivs[i].absval;
+		}
+		if (err_total <= tol*abs_total){
+			out = total;
+			return true;
+		}
+
+		//Choose the subintervals to split, largest error first
+		order.clear();
+		for (size_t i = 0 ; i < ivs.size() ; i++) order.push_back(make_pair(-ivs[i].err, i));
+		sort(order.begin(), order.end());
+		which.clear();
+		double chosen = 0;
+		for (size_t o = 0 ; o < order.size() && chosen < err_total/2 && which.size() < CLR_INTEG_ROUND ; o++){
+			const integ_interval& iv = ivs[order[o].second];
+			if (abs(iv.b - iv.a) <= 100*DBL_EPSILON*max(abs(iv.a), abs(iv.b))) continue; //Too narrow to split
+			which.push_back(order[o].second);
+			chosen += iv.err;
+		}
+
+		if (which.size() == 0 || ivs.size() + which.size() > max_intervals){
+			err = "INTEG could not reach the requested accuracy with " + to_string(ivs.size()) + " subintervals ";
+			err = err + "(integral " + valuestr(clr_value(total)) + ", estimated error " + dtos(err_total, 6, 3) + ").";
+			if (which.size() == 0) err = err + " The function may have a singularity.";
+			return false;
+		}
+
+		//Halve them
+		size_t count = which.size();
+		for (size_t w = 0 ; w < count ; w++){
+			integ_interval half = ivs[which[w]];
+			half.a = (half.a + half.b)/2.0;
+			ivs[which[w]].b = half.a;
+			ivs.push_back(half);
+			which.push_back(ivs.size()-1);
+		}
+		if (!evaluate(f, start, works, ivs, which, err)) return false;
+	}
+}
@@ -0,0 +1,26 @@
+/*
+This file declares the numerical integrator used by INTEG. It uses adaptive
+Gauss-Kronrod quadrature: the interval is split where the error estimate is
+largest until the estimated error is small enough. The subintervals of each round
+are evaluated in parallel.
+
+Created by Grant Giesbrecht on 19.10.2026
+
+*/
+
+#include <string>
+#include "clr_types.hpp"
+#include "clr_callable.hpp"
+
+#ifndef CLR_INTEGRATE_HPP
+#define CLR_INTEGRATE_HPP
+
+#define CLR_INTEG_DIGITS 10 //Default number of correct digits (tolerance 10^-digits, relative to the integral of |f|)
+#define CLR_INTEG_MAX_INTERVALS 2000 //Default max number of subintervals
+#define CLR_INTEG_ROUND 64 //Max subintervals split per round
+#define CLR_INTEG_GRAIN 1024 //Min points per thread for native functions (interpreted functions use one subinterval)
+
+//Integrates 'f' along the line from 'a' to 'b', evaluating it in forks of 'state'
+bool integrate(const clr_callable& f, const clr_state* state, comp a, comp b, double tol, size_t max_intervals, comp& out, std::string& err);
+
+#endif
@@ -1,159 +1,270 @@
 #include "clr_interpret.hpp"
+#include "clr_arrays.hpp"
+#include "clr_compile.hpp"
+#include "clr_keywords.hpp"
+#include "clr_formula.hpp"
+#include "clr_profile.hpp"
+#include "clr_sched.hpp"
+#include "clr_session.hpp"
 #include <IEGA/string_manip.hpp>
 #include <IEGA/stdutil.hpp>
-#include <cstdlib>
 #include <fstream>
 
 using namespace std;
 
+/*
+Buffers reused by interpret_clr so that, once they have grown to fit, lexing and
+parsing a line does not allocate. Calls of interpret_clr nest (eg. when an
+uncompiled interpreted function runs), so each active call takes its own set
+from a per-thread pool (see line_buffers_lease).
+*/
+typedef struct{
+	std::vector<token> tks;
+	std::vector<ast> trees;
+	std::vector<ast> spare_trees;
+}line_buffers;
+
+static thread_local std::vector<std::unique_ptr<line_buffers> > free_line_buffers;
+
+/*
+Takes a set of line buffers from the pool for the life of the object.
+*/
+struct line_buffers_lease{
+	std::unique_ptr<line_buffers> buf;
+
+	line_buffers_lease(){
+		if (free_line_buffers.empty()){
+			buf.reset(new line_buffers());
+		}else{
+			buf = std::move(free_line_buffers.back());
+			free_line_buffers.pop_back();
+		}
+	}
+	~line_buffers_lease(){
+		free_line_buffers.push_back(std::move(buf));
+	}
+};
+
 /*
 Accepts a CLC command as a string ('input'),
 */
-bool interpret_clr(std::string input, clr_state* state, std::string& print_out){
+bool interpret_clr(const std::string& input, clr_state* state, std::string& print_out){
 
 	print_out = "";
+	line_buffers_lease lease;
+	line_buffers& buf = *lease.buf;
 
 	//Lex input, get tokens
 	bool success;
-	vector<token> tks = clr_lex(input, state, success);
+	clr_lex(input, state, success, buf.tks);
 	if (!success){
-	    print_out = "LEX ERROR: " + tks[0].valstr + "\n";
+	    print_out = "LEX ERROR: " + buf.tks[0].valstr + "\n";
 		return false;
 	}
 
 	//Print tokens (in developer mode)
 	if (state->developer_mode){
 		print_out = print_out + "Tokens:\n";
-	    for (size_t t = 0 ; t < tks.size() ; t++){
-	        print_out = print_out + "\t(" + dtos(t, 0, 3) + ") " + tokenstr(tks[t]) + "\n";
+	    for (size_t t = 0 ; t < buf.tks.size() ; t++){
+	        print_out = print_out + "\t(" + dtos(t, 0, 3) + ") " + tokenstr(buf.tks[t]) + "\n";
 	    }
 		print_out = print_out + "\n";
 	}
 
 
 	//Parse tokens, create an abstract syntax tree
-	vector<ast> trees = clr_parse(tks, state, success);
+	clr_parse(buf.tks, state, success, buf.trees, buf.spare_trees);
 	if (!success){
-		print_out = "PARSE ERROR: " + trees[0].tk.valstr + "\n";
+		print_out = "PARSE ERROR: " + buf.trees[0].tk.valstr + "\n";
 		return false;
 	}
 
 	//Print ASTs (for debugging!)
 	if (state->developer_mode){
 		print_out = print_out + "Trees:\n";
-		for (size_t t = 0 ; t < trees.size() ; t++){
-			print_out = print_out + "\t("+dtos(t, 0, 3)+")" + aststr(trees[t]) + "\n";
+		for (size_t t = 0 ; t < buf.trees.size() ; t++){
+			print_out = print_out + "\t("+dtos(t, 0, 3)+")" + aststr(buf.trees[t]) + "\n";
 		}
 	}
 
-	//Evaluates an AST (or a subsection of an AST)
+	//Evaluates each AST
+	size_t failed;
+	return eval_trees(buf.trees, state, print_out, failed);
+}
+
+/*
+Evaluates 'trees' in order. Stops at the first tree which fails, writing its
+index to 'failed' and the error to 'print_out'.
+*/
+bool eval_trees(const std::vector<ast>& trees, clr_state* state, std::string& print_out, size_t& failed){
+
+	bool success;
 	token out;
 	for (size_t t = 0 ; t < trees.size() ; t++){
+
+		//Let other sessions run if this one is scheduled (see clr_sched.cpp)
+		string err;
+		if (state->job != NULL && !sched_checkpoint(state, err)){
+			failed = t;
+			print_out = "EVAL ERROR: Stopped before tree:\n\t" + aststr(trees[t]) + "\n";
+			print_out = print_out + err + "\n";
+			return false;
+		}
+
+		//Evaluate runs of element-wise array operations in one pass
+		size_t fused;
+		if (!fuse_elementwise(trees, t, state, fused, err)){
+			failed = t;
+			print_out = "EVAL ERROR: Failed to evaluate tree:\n\t" + aststr(trees[t]) + "\n";
+			print_out = print_out + err + "\n";
+			return false;
+		}
+		if (fused > 0){
+			if (state->developer_mode) print_out = print_out + "Fused trees " + dtos(t, 0, 3) + " to " + dtos(t+fused-1, 0, 3) + ".\n";
+			t += fused-1;
+			continue;
+		}
+
+		success = true;
 		out = ast_eval(trees[t], state, success);
 		if (!success){
+			failed = t;
 			print_out = "EVAL ERROR: Failed to evaluate tree:\n\t" + aststr(trees[t]) + "\n";
 			print_out = print_out + out.valstr + "\n";
 			return false;
 		}
 	}
 
-
 	return true;
 }
 
 /*
  Accepts a string and breaks it into a vector of tokens
  */
-vector<token> clr_lex(string input, clr_state* state, bool& success){
-
-	success = true;
-
-	//Create token vector
+vector<token> clr_lex(const std::string& input, clr_state* state, bool& success){
 	vector<token> tks;
+	clr_lex(input, state, success, tks);
+	return tks;
+}
 
-	token temp_tok;
-
-	ensure_whitespace(input, "+-*/^;#"); //For targets, list all symbols which may be mashed up next to another token without a space. The only symbols which fit this criterion are key symbols. This will ensure 'parse' on the next line breaks them up into words correctly
-	vector<string> words = parse(input, " "); //Break up input into 'words', each holding a token. NOTE: This is not the same 'parse' as clr_parse which generates an abstract syntax tree
+/*
+Returns true if 'c' is a key symbol. Key symbols are words on their own even
+when no spaces separate them from their neighbors.
+*/
+static inline bool is_key_symbol(char c){
+	return (c == '+' || c == '-' || c == '*' || c == '/' || c == '^' || c == ';' || c == '#');
+}
 
-	//Create vector of function and variable names (will be needed within for loop)
-	vector<string> fn_names;
-	vector<string> var_names;
-	for (size_t f = 0 ; f < state->functions.size() ; f++){
-		fn_names.push_back(state->functions[f].name);
-	}
-	for (size_t v = 0 ; v < state->variables.size() ; v++){
-		var_names.push_back(state->variables[v].name);
+/*
+Returns true if 'name' is a variable or a function (base, interpreted or plugin)
+in 'state'.
+*/
+static bool is_defined_name(const clr_state* state, const std::string& name){
+	if (find_base_function(name) != NULL || find_function(state, name) != NULL) return true;
+	for (size_t v = 0 ; v < state->variables->size() ; v++){
+		if ((*state->variables)[v].name == name) return true;
 	}
+	return false;
+}
 
-	//Convert each 'word' into a token...
-	for (size_t w = 0 ; w < words.size() ; w++){
+/*
+Finds the next word of 'input' at or after 'pos'. Words are separated by spaces,
+and every key symbol is a word by itself, except a sign ending a keyword (eg.
+S+). The sign is only kept if the word is first on the line or the word without
+it is not a variable or function in 'state', so "x;s+" still adds a variable s.
+Writes the word's position to 'start' and 'len' and moves 'pos' past it.
+Returns false if there are no more words.
+*/
+static bool next_word(const std::string& input, const clr_state* state, size_t& pos, size_t& start, size_t& len){
 
-		//Classify each word as a type of token
-		if (words[w] == "+" || words[w] == "-" || words[w] == "*"  || words[w] == "/" || words[w] == "^" || words[w] == ";" || words[w] == "#"){ //Key Symbol
+	while (pos < input.length() && input[pos] == ' ') pos++;
+	if (pos >= input.length()) return false;
 
-			//If comment, skip remainder of input
-			if (words[w] == "#"){
-				break;
-			}else{
-				//Set fields
-				temp_tok.type = "ksym";
-				temp_tok.valstr = words[w];
-
-				//Add to vector of tokens
-				tks.push_back(temp_tok);
-			}
+	start = pos;
+	if (is_key_symbol(input[pos])){
+		pos++;
+	}else{
+		while (pos < input.length() && input[pos] != ' ' && !is_key_symbol(input[pos])) pos++;
 
-		}else if(isnum(words[w])){ //Number
-			//Set fields
-			temp_tok.type = "num";
-			temp_tok.valnum = strtod(words[w]);
+		//Keywords may end in '+' or '-' (eg. S+) if it ends the word
+		bool sign = (pos < input.length() && (input[pos] == '+' || input[pos] == '-'));
+		if (sign && (pos+1 == input.length() || input[pos+1] == ' ') && find_keyword(input.substr(start, pos+1-start)) != NULL){
+			bool first = (input.find_first_not_of(' ') == start);
+			if (first || !is_defined_name(state, input.substr(start, pos-start))) pos++;
+		}
+	}
+	len = pos - start;
+	return true;
+}
 
-			//Add to vector of tokens
-			tks.push_back(temp_tok);
-		}else if(strvec_contains(state->keywords, to_uppercase(words[w])) != -1){ //keyword
-			//Set fields
-			temp_tok.type = "kwrd";
-			temp_tok.valstr = words[w];
+/*
+Accepts a string and breaks it into tokens, which are written to 'tks'. 'tks' is
+cleared first; reusing it between calls avoids allocating.
+*/
+void clr_lex(const std::string& input, clr_state* state, bool& success, std::vector<token>& tks){
 
-			//Add to vector of tokens
-			tks.push_back(temp_tok);
-		}else if(strvec_contains(fn_names, to_uppercase(words[w])) != -1){ //function (interpreted or base)
-			//Set fields
-			temp_tok.type = "func";
-			temp_tok.valstr = words[w];
+	success = true;
+	tks.clear();
 
-			//Add to vector of tokens
-			tks.push_back(temp_tok);
-		}else if(strvec_contains(var_names, words[w]) != -1){ //Variable
-			//Set fields
-			temp_tok.type = "var";
-			temp_tok.valstr = words[w];
+	token temp_tok;
 
-			//Add to vector of tokens
+	//Keywords which take file paths get the rest of their line split only on
+	// spaces, as paths may contain key symbols (eg. '/' and '-')
+	size_t first = input.find_first_not_of(' ');
+	if (first != string::npos && keyword_takes_paths(input.substr(first, input.find(' ', first) - first))){
+		vector<string> raw_words = parse(input, " ");
+		temp_tok.type = "kwrd";
+		temp_tok.valstr = raw_words[0];
+		tks.push_back(temp_tok);
+		for (size_t w = 1 ; w < raw_words.size() ; w++){
+			if (raw_words[w][0] == '#') break; //Comment - skip remainder of input
+			if (raw_words[w].length() > 1 && raw_words[w][0] == '-' && is_valid_name(raw_words[w].substr(1))){
+				temp_tok.type = "flag";
+			}else{
+				temp_tok.type = "str";
+			}
+			temp_tok.valstr = raw_words[w];
 			tks.push_back(temp_tok);
-		}else{ //New variable or error
+		}
+		return;
+	}
 
-			//If it's a valid variable name, call it a variable (and assume it'll be new)
-			if (is_valid_name(words[w])){
-				//Set fields
-				temp_tok.type = "var";
-				temp_tok.valstr = words[w];
+	//Convert each word into a token...
+	size_t pos = 0, start, len;
+	while (next_word(input, state, pos, start, len)){
 
-				//Add to vector of tokens
-				tks.push_back(temp_tok);
-			}else{ //Otherwise throw an error
-				success = false;
-				tks.clear();
-				temp_tok.valstr = "Failed to convert word '" + words[w] + "' to token.";
-				tks.push_back(temp_tok);
-				return tks;
-			}
+		tks.push_back(temp_tok);
+		token& tk = tks.back();
+		tk.valstr.assign(input, start, len);
 
+		//Classify each word as a type of token
+		if (len == 1 && is_key_symbol(input[start])){ //Key Symbol
 
+			//If comment, skip remainder of input
+			if (input[start] == '#'){
+				tks.pop_back();
+				break;
+			}
+			tk.type = "ksym";
+
+		}else if(isnum(tk.valstr)){ //Number
+			tk.type = "num";
+			tk.valnum = strtod(tk.valstr);
+		}else if(find_keyword(tk.valstr) != NULL){ //keyword
+			tk.type = "kwrd";
+		}else if(find_base_function(tk.valstr) != NULL || find_function(state, tk.valstr) != NULL){ //function (base, interpreted or plugin)
+			tk.type = "func";
+		}else if(is_valid_name(tk.valstr)){ //Variable (new or existing)
+			tk.type = "var";
+		}else{ //Otherwise throw an error
+			success = false;
+			temp_tok.valstr = "Failed to convert word '" + tk.valstr + "' to token.";
+			tks.clear();
+			tks.push_back(temp_tok);
+			return;
 		}
 
-	} //End for loop
+	} //End while loop
 
 	//Loop through tokens - merge '-' token with next token if present. This forms a negative number or flag
 	for (size_t i = 0 ; i < tks.size() ; i++){
@@ -171,9 +282,6 @@ vector<token> clr_lex(string input, clr_state* state, bool& success){
 		}
 	}
 
-	//Return tokens
-	return tks;
-
 }
 
 /*
@@ -190,82 +298,107 @@ examples:
 	|			|			|		  |					|
 [num, 5]	[num, 4]	[num, 3]  [num, 2]		[var, b_field]
 */
-vector<ast> clr_parse(std::vector<token> tks, clr_state* state, bool& success){
-
+vector<ast> clr_parse(const std::vector<token>& tks, clr_state* state, bool& success){
 	vector<ast> trees;
+	vector<ast> spare;
+	clr_parse(tks, state, success, trees, spare);
+	return trees;
+}
+
+/*
+Returns a tree to fill in, appended to 'trees'. Trees in 'spare' are reused
+first, so their branch vectors keep their storage.
+*/
+static ast& add_tree(std::vector<ast>& trees, std::vector<ast>& spare){
+	if (spare.empty()){
+		trees.push_back(ast());
+	}else{
+		trees.push_back(std::move(spare.back()));
+		spare.pop_back();
+	}
+	return trees.back();
+}
+
+/*
+Makes 'tree' the tree 'base' with the tokens tks[first] to tks[last-1] as branches.
+*/
+static void fill_tree(ast& tree, const token& base, const std::vector<token>& tks, size_t first, size_t last){
+	tree.tk = base;
+	tree.next.resize(last - first); //No 'branches' have branches - this is a quirk and feature of RPN - the user handles this
+	for (size_t tb = first ; tb < last ; tb++){
+		tree.next[tb-first].tk = tks[tb];
+		tree.next[tb-first].next.clear();
+	}
+}
+
+/*
+Parses 'tks' (see above) into 'trees'. The previous contents of 'trees' are
+moved to 'spare' and reused, so calling this repeatedly with the same vectors
+does not allocate once they have grown to fit. On failure, trees[0] holds the
+error message.
+*/
+void clr_parse(const std::vector<token>& tks, clr_state* state, bool& success, std::vector<ast>& trees, std::vector<ast>& spare){
+
 	success = true;
-	ast temp_ast;
-	ast temp_ast2;
+	while (!trees.empty()){
+		spare.push_back(std::move(trees.back()));
+		trees.pop_back();
+	}
+
 	//Check tks size
-	if (tks.size() < 1) return trees;
+	if (tks.size() < 1) return;
 
 	//Check for keyword at beginning
 	if (tks[0].type == "kwrd"){ //Found keyword
-		temp_ast.tk = tks[0]; //Create base for AST with keyword token
-		temp_ast2.next.clear();
-		for (size_t tb = 1 ; tb < tks.size() ; tb++){ //Add all other tokens as branches
-			temp_ast2.tk = tks[tb]; //Put token in branch
-			temp_ast.next.push_back(temp_ast2);
-		}
-		trees.push_back(temp_ast); //Add to trees
-	}else{ //Normal parsing operation - RPN
-
-		//For each token
-		size_t branch_start = 0; //Token index at which branches for next AST starts...
-		for (size_t t = 0 ; t < tks.size() ; t++){
-			if (tks[t].type == "ksym" || tks[t].type == "func"){ //Key Symbol or function found - create new AST and add it to vector
-				temp_ast.tk = tks[t]; //Set this token as the 'base' node of the AST
-				temp_ast.next.clear(); //Remove previous trees' branches
-				temp_ast2.next.clear(); //(No 'branches' have branches - this is a quirk and feature of RPN - the user handles this)
-				for (size_t tb = branch_start ; tb < t ; tb++){ //For each token before this trigger, add them as branches to the base
-					temp_ast2.tk = tks[tb]; //Put token in branch
-					temp_ast.next.push_back(temp_ast2);
-				}
-				branch_start = t+1; //Update index to start next branch-adding for-loop (ie. the one right above this line)
-				trees.push_back(temp_ast); //Add tree
-			}else if(tks[t].type == "kwrd" && t != 0){ //If keyword is found later, that's an error!
-				success = false;
-				trees.clear();
-				temp_ast.tk.valstr = "Keyword '" + tks[t].valstr + "' found at word index " + dtos(t, 0, 3) + ".";
-			}
+		fill_tree(add_tree(trees, spare), tks[0], tks, 1, tks.size()); //All other tokens are branches
+		return;
+	}
+
+	//Normal parsing operation - RPN
+	string err;
+	size_t branch_start = 0; //Token index at which branches for next AST starts...
+	for (size_t t = 0 ; t < tks.size() ; t++){
+		if (tks[t].type == "ksym" || tks[t].type == "func"){ //Key Symbol or function found - create new AST and add it to vector
+			fill_tree(add_tree(trees, spare), tks[t], tks, branch_start, t); //Tokens since the last trigger are the branches
+			branch_start = t+1; //Update index to start next branch-adding
+		}else if(tks[t].type == "kwrd" && t != 0){ //If keyword is found later, that's an error!
+			err = "Keyword '" + tks[t].valstr + "' found at word index " + dtos(t, 0, 3) + ".";
+			break;
 		}
+	}
 
-		//If a number is entered without any operator, make it the base of a one-token long AST
-		if (branch_start < tks.size()){
+	//If a number is entered without any operator, make it the base of a one-token long AST
+	if (err == "" && branch_start < tks.size()){
 
-			//Check for multiple numeric values. This is incorrect syntax
-			if (tks.size() - branch_start > 1){
-				success = false;
-				trees.clear();
-				temp_ast.tk.valstr = "Invalid Syntax: Multiple tokens provided, however none were key symbols or functions.\n";
-				temp_ast.tk.valstr = temp_ast.tk.valstr + "\tUse the ENTER symbol (;) to push values into the {y} registers.";
-			}
-			temp_ast.tk = tks[branch_start];
-			temp_ast.next.clear();
-			trees.push_back(temp_ast);
+		//Check for multiple numeric values. This is incorrect syntax
+		if (tks.size() - branch_start > 1){
+			err = "Invalid Syntax: Multiple tokens provided, however none were key symbols or functions.\n";
+			err = err + "\tUse the ENTER symbol (;) to push values into the {y} registers.";
+		}else{
+			fill_tree(add_tree(trees, spare), tks[branch_start], tks, 0, 0);
 		}
 	}
 
-	return trees;
+	if (err != ""){
+		success = false;
+		while (!trees.empty()){
+			spare.push_back(std::move(trees.back()));
+			trees.pop_back();
+		}
+		ast& tree = add_tree(trees, spare);
+		tree.next.clear();
+		tree.tk.type = "";
+		tree.tk.valstr = err;
+	}
 }
 
 /*
 Evaluates an AST (or a subsection of an AST) and returns the output token
 */
-token ast_eval(ast tree, clr_state* state, bool& success){
+token ast_eval(const ast& tree, clr_state* state, bool& success){
 
 	token tk;
 
-	//This is needed for the STO command (and perhaps others)
-	vector<string> var_names;
-	for (size_t v = 0 ; v < state->variables.size() ; v++){
-		var_names.push_back(state->variables[v].name);
-	}
-	vector<string> fn_names;
-	for (size_t f = 0 ; f < state->functions.size() ; f++){
-		fn_names.push_back(state->functions[f].name);
-	}
-
 	//The base will be a ksym, kwrd, or func. Determine which (each handles differently)
 	if (tree.tk.type == "ksym"){ //Key Symbol
 
@@ -289,37 +422,27 @@ token ast_eval(ast tree, clr_state* state, bool& success){
 				tk.valstr = "A numeric type or variable must preceed the ';' operator.";
 				return tk;
 			}else{
+				clr_value val;
+				if (!operand_value(tree.next[0].tk, state, val, tk.valstr)){
+					success = false;
+					return tk;
+				}
 				state->t = state->z;
 				state->z = state->y;
 				state->y = state->x;
-				state->x = tree.next[0].tk.valnum;
+				state->x = val;
 				//End ';' code
 			}
 
 		}
 
-		if (tree.tk.valstr == "+"){
-			state->x = state->y + state->x;
-			state->y = state->z;
-			state->z = state->t;
-			state->t = cart(0, 0);
-		}else if (tree.tk.valstr == "-"){
-			state->x = state->y - state->x;
-			state->y = state->z;
-			state->z = state->t;
-			state->t = cart(0, 0);
-		}else if (tree.tk.valstr == "*"){
-			state->x = state->y * state->x;
-			state->y = state->z;
-			state->z = state->t;
-			state->t = cart(0, 0);
-		}else if (tree.tk.valstr == "/"){
-			state->x = state->y / state->x;
-			state->y = state->z;
-			state->z = state->t;
-			state->t = cart(0, 0);
-		}else if (tree.tk.valstr == "^"){
-			state->x = pow(state->y, state->x);
+		if (tree.tk.valstr == "+" || tree.tk.valstr == "-" || tree.tk.valstr == "*" || tree.tk.valstr == "/" || tree.tk.valstr == "^"){
+			string err;
+			if (!value_binary(tree.tk.valstr[0], state->y, state->x, state->x, err)){
+				success = false;
+				tk.valstr = err;
+				return tk;
+			}
 			state->y = state->z;
 			state->z = state->t;
 			state->t = cart(0, 0);
@@ -349,311 +472,89 @@ token ast_eval(ast tree, clr_state* state, bool& success){
 				tk.valstr = "A numeric type or variable must preceed the ';' operator.";
 				return tk;
 			}
+			clr_value val;
+			if (!operand_value(tree.next[0].tk, state, val, tk.valstr)){
+				success = false;
+				return tk;
+			}
 			state->t = state->z;
 			state->z = state->y;
 			state->y = state->x;
-			state->x = tree.next[0].tk.valnum;
+			state->x = val;
 			//End ';' code
 		}
 
-		//Scan all functions, look for the matching function
-		size_t fidx = 0; //This will hold the index
-		bool found = false;
-		for ( ; fidx < state->functions.size() ; fidx++){
-			if (state->functions[fidx].name == to_uppercase(tree.tk.valstr)){ //If this is the function...
-				found = true; //Indicate that it was found
-				break; //GTFO
-			}
-		}
+		//Base functions come first, then the library's functions
+		const clr_native_function* bf = find_base_function(tree.tk.valstr);
+		const clr_function* lf = (bf == NULL) ? find_function(state, tree.tk.valstr) : NULL;
 
 		//Ensure function was found
-		if (!found){
+		if (bf == NULL && lf == NULL){
 			success = false;
 			tk.valstr = "Failed to locate function '" + tree.tk.valstr + "'. This is a software bug in clr_interpret.cpp";
 			return tk;
 		}
 
 		//Evaluate function
-		if (state->functions[fidx].interpreted){ //Interpreted function
-			for (size_t l = 0 ; l < state->functions[fidx].commands.size() ; l++){
-				string print_out;
-				if (!interpret_clr(state->functions[fidx].commands[l], state, print_out)){
-					success = false;
-					tk.valstr = "Failed to execute interpreted function '" + state->functions[fidx].name + "' on line " + dtos(l, 0, 3) + ".\n";
-					tk.valstr = tk.valstr + print_out;
-					return tk;
-				}
-			}
-			// interpret_clr(std::string input, clr_state* state, std::string& print_out)
-		}else{ //Base function
-			cout << "function!" << endl;
-			state->x = state->functions[fidx].fnptr(state->x, state->y);
-		}
-
-	}else if(tree.tk.type == "kwrd"){ //Keywords
-
-		if (to_uppercase(tree.tk.valstr) == "FLP"){ //Flip contents of {x} and {y}
-			comp temp_x = state->x;
-			state->x = state->y;
-			state->y = temp_x;
-		}else if (to_uppercase(tree.tk.valstr) == "LSTX"){
-
-		}else if (to_uppercase(tree.tk.valstr) == "DN"){ //Roll stack down
-			comp temp_x = state->x;
-			state->x = state->y;
-			state->y = state->z;
-			state->z = state->t;
-			state->t = temp_x;
-		}else if (to_uppercase(tree.tk.valstr) == "UP"){ //Roll stack up
-			comp temp_x = state->x;
-			state->x = state->t;
-			state->t = state->z;
-			state->z = state->y;
-			state->y = temp_x;
-		}else if (to_uppercase(tree.tk.valstr) == "STK"){ //Print stack
-			cout << "\t{T}: " << state->t << endl;
-			cout << "\t{Z}: " << state->z << endl;
-			cout << "\t{Y}: " << state->y << endl;
-			cout << "\t{X}: " << state->x << endl;
-		}else if (to_uppercase(tree.tk.valstr) == "STO"){ //Save {x} into the specified variable.
-
-			//Ensure exactly one variable name follows...
-			if (tree.next.size() != 1){
+		if (bf != NULL){ //Base function
+			string err;
+			if (!value_function(bf->fnptr, bf->batchptr, state->x, state->y, state->x, err)){
 				success = false;
-				tk.valstr = "Too many arguments provided to STO command. Exactly one argument must be given.";
+				tk.valstr = err;
 				return tk;
 			}
+		}else if (lf->interpreted){ //Interpreted function
+			std::shared_ptr<const clr_library> lib = state->library; //Keep the library alive while its commands run
+			const clr_function& fn = *lf;
 
-			//See if variable already exists...
-			size_t vidx = strvec_contains(var_names, tree.next[0].tk.valstr);
-			if (vidx != -1){ //Variable already exists
-				state->variables[vidx].valnum = state->x; //Load {x} into variable
-			}else{ //Create a new variable, load {x} into it, and load it into state
-				variable temp_var;
-				temp_var.name = tree.next[0].tk.valstr;
-				temp_var.type = "num";
-				temp_var.valnum = state->x;
-				state->variables.push_back(temp_var);
-			}
-		}else if (to_uppercase(tree.tk.valstr) == "RCL"){ //Load the variable into {x} and push up the stack
-
-			//Ensure exactly one variable name follows...
-			if (tree.next.size() != 1){
+			if (state->call_depth >= CLR_MAX_CALL_DEPTH){
 				success = false;
-				tk.valstr = "Too many arguments provided to STO command. Exactly one argument must be given.";
+				tk.valstr = "Exceeded the maximum of " + dtos(CLR_MAX_CALL_DEPTH, 0, 3) + " nested function calls in '" + fn.name + "'. Does it call itself?";
 				return tk;
 			}
 
-			//See if variable already exists...
-			size_t vidx = strvec_contains(var_names, tree.next[0].tk.valstr);
-			if (vidx != -1){ //Variable already exists
-				//Push registers up
-				state->t = state->z;
-				state->z = state->y;
-				state->y = state->x;
-				state->x = state->variables[vidx].valnum;
-			}else{ //Variable does not exist - give error
-				success = false;
-				tk.valstr = "Variable '" + tree.next[0].tk.valstr + "' does not exist.\n";
-				return tk;
-			}
-
-		}else if (to_uppercase(tree.tk.valstr) == "CLX"){ //Clear {x}
-			state->x = cart(0, 0);
-		}else if (to_uppercase(tree.tk.valstr) == "CLREG"){ //Clear all registers
-			state->x = cart(0, 0);
-			state->y = cart(0, 0);
-			state->z = cart(0, 0);
-			state->t = cart(0, 0);
-		}else if (to_uppercase(tree.tk.valstr) == "LSVAR"){ //List all variables
-			cout << "Varibales:" << endl;
-			for (size_t v = 0 ; v < state->variables.size() ; v++){
-				cout << "\t" << state->variables[v].name << " = " << state->variables[v].valnum << "\t\tType: " << state->variables[v].type << endl;
-			}
-		}else if (to_uppercase(tree.tk.valstr) == "CLVAR"){ //Clear the variables from CLR
-			state->variables.clear(); //Erase all variables
-			fill_critical_variables(state); //Restore those which are critical to CLR's correct operation
-		}else if (to_uppercase(tree.tk.valstr) == "CLEAR"){ //Execute 'clear' in terminal. Clears the terminal
-			system("clear");
-		}else if (to_uppercase(tree.tk.valstr) == "HELP"){
-
-			/*
-			FLAGS:
-			-intro: prints intro help page (default)
-			-v or -verbose: prints verbose help page
-			-lf: lists all functions
-			-lc or -lk: lists all commands (TODO)
-			-l: prints all information available for requested page. Affects:
-				-lf - (prints if interpreted/compiled. No. lines if interpreted)
-			-vf: View function - prints commands of interpreted function
-			*/
-
-			string help_operation = "intro";
-			bool print_long = false;
-
-			vector<string> pages;
-
-			//Process flags if present
-			if (tree.next.size() > 0){
-				for (size_t n = 0 ; n < tree.next.size() ; n++){ //For each extra token
-					if (tree.next[n].tk.type == "flag" && (to_uppercase(tree.next[n].tk.valstr) == "-INTRO")){
-						help_operation = "intro";
-					}else if (tree.next[n].tk.type == "flag" && (to_uppercase(tree.next[n].tk.valstr) == "-V" || to_uppercase(tree.next[n].tk.valstr) == "VERBOSE")){
-						help_operation = "verbose";
-					}else if (tree.next[n].tk.type == "flag" && (to_uppercase(tree.next[n].tk.valstr) == "-LF")){
-						help_operation = "list_functions";
-					}else if (tree.next[n].tk.type == "flag" && (to_uppercase(tree.next[n].tk.valstr) == "-LC" || to_uppercase(tree.next[n].tk.valstr) == "LK")){
-						help_operation = "list_keywords";
-					}else if (tree.next[n].tk.type == "flag" && (to_uppercase(tree.next[n].tk.valstr) == "-L")){ //If flag is 'print_long'
-						print_long = true;
-					}else if (tree.next[n].tk.type == "flag" && (to_uppercase(tree.next[n].tk.valstr) == "-VF")){ //If flag is 'print_long'
-						help_operation = "view_function";
-					}else if(tree.next[n].tk.type == "flag"){
-						cout << "\t Ignoring Unrecognized flag '" + tree.next[n].tk.valstr + "'." << endl;
-					}else if(tree.next[n].tk.type == "var" || tree.next[n].tk.type == "func" || tree.next[n].tk.type == "kwrd"){ //Must be a page to search for
-						if (help_operation == "intro") help_operation = "search";
-						pages.push_back(tree.next[n].tk.valstr);
-					}
+			state->call_depth++;
+			string print_out;
+			size_t line = 0;
+			bool ran = true;
+			if (state->profile && state->profile->enabled){ //Time each line (see clr_profile.cpp)
+				ran = profile_run(fn, state, print_out, line);
+			}else if (fn.compiled){ //Run compiled trees (see compile_functions)
+				size_t failed;
+				ran = eval_trees(fn.program, state, print_out, failed);
+				if (!ran) line = fn.program_lines[failed];
+			}else{ //Interpret line by line
+				for (line = 0 ; line < fn.commands.size() && ran ; line++){
+					ran = interpret_clr(fn.commands[line], state, print_out);
 				}
+				line--;
 			}
+			state->call_depth--;
 
-			if (help_operation == "list_functions"){
-				if (print_long){
-					cout << "Functions:" << endl;
-					for (size_t f = 0 ; f < state->functions.size() ; f++){
-						cout << "\t" << state->functions[f].name << " - \t";
-						if (state->functions[f].interpreted){
-							cout << "Interpreted function consistning of " << state->functions[f].commands.size() << " commands " << endl;
-						}else{
-							cout << "Compiled function" << endl;
-						}
-
-					}
-				}else{
-					cout << "Functions:" << endl;
-					for (size_t f = 0 ; f < state->functions.size() ; f++){
-						cout << "\t" << state->functions[f].name << endl;
-					}
-				}
-			}else if(help_operation == "list_keywords"){
-				cout << "Keywords:" << endl;
-				for (size_t k = 0; k < state->keywords.size() ; k++){
-					cout << "\t" << state->keywords[k] << endl;
-				}
-			}else if(help_operation == "intro"){
-				if (!print_file(state->help_dir + "clr_intro_help.htx", 0)){
-					success = false;
-					tk.valstr = "Failed to open file '" + state->help_dir + "clr_intro_help.htx" + "'.";
-					return tk;
-				}
-			}else if(help_operation == "verbose"){
-				if (!print_file(state->help_dir + "clr_verbose_help.htx", 0)){
-					success = false;
-					tk.valstr = "Failed to open file '" + state->help_dir + "clr_intro_help.htx" + "'.";
-					return tk;
-				}
-			}else if(help_operation == "view_function"){
-				for (size_t p = 0 ; p < pages.size() ; p++){
-
-					//Scan all functions, look for the matching function
-					size_t fidx = 0; //This will hold the index
-					bool found = false;
-					for ( ; fidx < state->functions.size() ; fidx++){
-						if (state->functions[fidx].name == to_uppercase(pages[p])){ //If this is the function...
-							found = true; //Indicate that it was found
-							break; //GTFO
-						}
-					}
-
-					//Ensure function was found
-					if (!found){
-						continue; //Skip...
-					}
-
-					if (!state->functions[fidx].interpreted){
-						cout << "ERROR: Can not print contents of compiled functions." << endl;
-					}else{
-						//Print function contents
-						cout << "Function: " << state->functions[fidx].name << endl;
-						for (size_t l = 0 ; l < state->functions[fidx].commands.size() ; l++){
-							cout << "\t[" << l << "]: " << state->functions[fidx].commands[l] << endl;
-						}
-					}
-
-
-				}
-			}else if(help_operation == "search"){
-				vector<string> failed;
-				for (size_t p = 0 ; p < pages.size() ; p++){
-					if(strvec_contains(state->keywords, to_uppercase(pages[p])) != -1){ //keyword
-						if (!print_file(state->help_dir + "clr_" + to_lowercase(pages[p]) + "_help.htx", 0)){
-							failed.push_back("Keyword: " + pages[p]);
-						}
-					}else if(strvec_contains(fn_names, to_uppercase(pages[p])) != -1){ //Function
-
-						//Scan all functions, look for the matching function
-						size_t fidx = 0; //This will hold the index
-						bool found = false;
-						for ( ; fidx < state->functions.size() ; fidx++){
-							if (state->functions[fidx].name == to_uppercase(pages[p])){ //If this is the function...
-								found = true; //Indicate that it was found
-								break; //GTFO
-							}
-						}
-
-						//Ensure function was found
-						if (!found){
-							failed.push_back("Function: " + pages[p]);
-							continue; //Skip...
-						}
-
-						if (state->functions[fidx].helpstr.length() < 1){
-							cout << "RESOURCE ERROR: Page for function '" << state->functions[fidx].name <<  "' is blank." << endl;
-						}
-
-						cout << state->functions[fidx].helpstr << endl;
-					}else{
-						failed.push_back("Unrecognized: " + pages[p]);
-					}
-				}
-
-				if (failed.size() == 1){
-					cout << "RESOURCE ERROR: Failed to locate 1 page for " << failed[0] << endl;
-				}else if(failed.size() > 1){
-					cout << "RESOURCE ERROR: Failed to locate " <<  failed.size() << " pages:" << endl;
-					for (size_t f = 0 ; f < failed.size() ; f++){
-						cout << "\t" << failed[f] << endl;
-					}
-				}
-			}else{
+			if (!ran){
 				success = false;
-				tk.valstr = "Failed to interpret 'help_operation'. This is a bug in clr_interpret.cpp.";
+				tk.valstr = "Failed to execute interpreted function '" + fn.name + "' on line " + dtos(line, 0, 3) + ".\n";
+				tk.valstr = tk.valstr + print_out;
 				return tk;
 			}
-
-		}else if (to_uppercase(tree.tk.valstr) == "CD"){
-
-		}else if (to_uppercase(tree.tk.valstr) == "PWD"){ //Execute 'pwd' in terminal. Prints full path
-			system("pwd");
-		}else if (to_uppercase(tree.tk.valstr) == "LS"){ //Execute 'ls' in terminal. Lists directory contents
-			system("ls");
-		}else if (to_uppercase(tree.tk.valstr) == "EXIT"){ //Exit the program
-			state->running = false;
-		}else if (to_uppercase(tree.tk.valstr) == "RUN"){
-
-		}else if (to_uppercase(tree.tk.valstr) == "DELETE"){
-
-		}else if (to_uppercase(tree.tk.valstr) == "DEVMODE"){ //Enter or exit developer mode
-			state->developer_mode = !state->developer_mode;
-			cout << "Developer mode: ";
-			if (state->developer_mode){
-				cout << "ON" << endl;
-			}else{
-				cout << "OFF" << endl;
+		}else{ //Plugin function
+			string err;
+			if (!value_function(lf->fnptr, lf->batchptr, state->x, state->y, state->x, err)){
+				success = false;
+				tk.valstr = err;
+				return tk;
 			}
-		}else if (to_uppercase(tree.tk.valstr) == "ADDFN"){
+		}
+
+	}else if(tree.tk.type == "kwrd"){ //Keywords
 
+		clr_keyword_fn fn = find_keyword(tree.tk.valstr);
+		if (fn == NULL){
+			success = false;
+			tk.valstr = "Unrecognized keyword '" + tree.tk.valstr + "'.";
+			return tk;
 		}
+		return fn(tree, state, success);
 
 	}else if(tree.tk.type == "num"){ //Number
 		//The following block of code was the subroutine for ';'.
@@ -687,39 +588,6 @@ token ast_eval(ast tree, clr_state* state, bool& success){
 
 
 
-/*
-Clear's the keyword vector of 'state', then repopulates it with all keywords in
-CLR.
-
-Void return
-*/
-void fill_keywords(clr_state* state){
-
-	state->keywords.clear();
-	state->keywords.push_back("FLP");
-	state->keywords.push_back("LSTX");
-	state->keywords.push_back("DN");
-	state->keywords.push_back("UP");
-	state->keywords.push_back("STK");
-	state->keywords.push_back("STO");
-	state->keywords.push_back("RCL");
-	state->keywords.push_back("CLX");
-	state->keywords.push_back("CLREG");
-	state->keywords.push_back("LSVAR");
-	state->keywords.push_back("CLVAR");
-	state->keywords.push_back("CLEAR");
-	state->keywords.push_back("HELP");
-	state->keywords.push_back("CD");
-	state->keywords.push_back("PWD");
-	state->keywords.push_back("LS");
-	state->keywords.push_back("EXIT");
-	state->keywords.push_back("RUN");
-	state->keywords.push_back("DELETE");
-	state->keywords.push_back("ADDFN");
-	state->keywords.push_back("DEVMODE");
-
-}
-
 /*
 Fills the 'state' argument's variables vector with all critical CLR variables
 after clearing state.variables.
@@ -732,14 +600,168 @@ void fill_critical_variables(clr_state* state){
 	std::string type;
 	comp valnum;
 
-	state->variables.clear();
+	std::vector<variable>* vars = new std::vector<variable>();
 	variable v;
 	v.name = "i";
 	v.type = "num";
 	v.valnum = cart(0, 1);
-	state->variables.push_back(v);
+	v.dirty = false;
+	vars->push_back(v);
 	v.name = "j";
-	state->variables.push_back(v);
+	vars->push_back(v);
+
+	state->variables.reset(vars); //Other forks keep the old table
+}
+
+/*
+Sets up a fresh state: an empty library, only the critical variables, registers
+zeroed and output printed to 'out'. Interpreted functions are loaded separately
+(see load_functions).
+*/
+void init_state(clr_state* state, std::string help_dir, std::ostream* out){
+	state->running = true;
+	state->help_dir = help_dir;
+	state->developer_mode = false;
+	state->session = NULL;
+	state->call_depth = 0;
+	state->profile.reset();
+	state->library.reset(new clr_library());
+	fill_critical_variables(state);
+	state->x = cart(0, 0);
+	state->y = cart(0, 0);
+	state->z = cart(0, 0);
+	state->t = cart(0, 0);
+	state->out = out;
+	state->job = NULL;
+	state->rng.seed = 0;
+	state->rng.stream = 0;
+	state->rng.counter = 0;
+	sigma_reset(state->sigma);
+}
+
+/*
+Creates a new CLR state which shares 'state's library and variable table. Only
+the registers and flags are copied, so forking is cheap no matter how many
+functions or variables are loaded. The first write to the library or variables
+by either state copies that table (see writable_library and writable_variables).
+The fork is not attached to any session file. It prints to the same stream as
+'state', so a fork run on another thread needs its own 'out'.
+*/
+clr_state fork_state(const clr_state* state){
+	clr_state f = *state;
+	f.session = NULL; //Forks are scratch space - don't let them write the session file
+	f.profile.reset(); //Forks may run on other threads, which the profiler doesn't support
+	f.job = NULL; //...and a job can only yield on its own thread
+	return f;
+}
+
+/*
+Returns a pointer to 'state's library that may be modified. If the library is
+shared with another state, it is copied first so the change is only seen by
+'state'. If 'state' has no library yet, an empty one is created.
+*/
+clr_library* writable_library(clr_state* state){
+
+	if (!state->library){
+		state->library.reset(new clr_library());
+	}else if (state->library.use_count() != 1){
+		state->library.reset(new clr_library(*state->library));
+	}
+
+	return const_cast<clr_library*>(state->library.get()); //Safe - only 'state' holds it
+}
+
+/*
+Returns a pointer to 'state's variable table that may be modified. If the table
+is shared with another state, it is copied first so the change is only seen by
+'state'.
+*/
+std::vector<variable>* writable_variables(clr_state* state){
+
+	if (!state->variables){
+		state->variables.reset(new std::vector<variable>());
+	}else if (state->variables.use_count() != 1){
+		state->variables.reset(new std::vector<variable>(*state->variables));
+	}
+
+	return const_cast<std::vector<variable>*>(state->variables.get()); //Safe - only 'state' holds it
+}
+
+/*
+Stores 'arr' in the variable named 'name', creating the variable if it does not
+exist and replacing its value (of any type) if it does. The array is also saved
+to 'state's session file, if it has one.
+*/
+void store_array(clr_state* state, std::string name, std::shared_ptr<const clr_array> arr){
+
+	variable v;
+	v.name = name;
+	v.type = "arr";
+	v.valnum = cart(0, 0);
+	v.valarr = arr;
+	v.dirty = false;
+
+	mark_dependents_dirty(state, name);
+
+	//Mirror to session file
+	if (state->session != NULL && !session_store_variable(state->session, v)){
+		*state->out << "\t Warning: Failed to save variable '" + name + "' to session file." << endl;
+	}
+
+	std::vector<variable>* vars = writable_variables(state);
+	for (size_t i = 0 ; i < vars->size() ; i++){
+		if ((*vars)[i].name == name){
+			(*vars)[i] = v;
+			return;
+		}
+	}
+	vars->push_back(v);
+}
+
+/*
+Gets the value of the token 't' and writes it to 'out'. Numbers are returned
+as-is and variables are looked up in 'state' (arrays are returned by reference).
+Formula variables are recomputed first if they're out of date. Returns false (and
+describes the problem in 'err') if 't' is a variable which does not exist or
+can't be computed, or is not a number or variable.
+*/
+bool operand_value(const token& t, clr_state* state, clr_value& out, std::string& err){
+
+	if (t.type == "num"){
+		out = clr_value(t.valnum);
+		return true;
+	}else if (t.type != "var"){
+		err = "A numeric type or variable must preceed the operator.";
+		return false;
+	}
+
+	for (size_t v = 0 ; v < state->variables->size() ; v++){
+		const variable& var = (*state->variables)[v];
+		if (var.name != t.valstr) continue;
+		if (var.type == "fml"){
+			return formula_value(state, v, out, err);
+		}else if (var.type == "arr"){
+			out = clr_value(var.valarr);
+		}else{
+			out = clr_value(var.valnum);
+		}
+		return true;
+	}
+
+	err = "Variable '" + t.valstr + "' does not exist.";
+	return false;
+}
+
+/*
+Returns the function named 'name' (case insensitive) in 'state's library, or NULL
+if there is none. The pointer is valid until the library is modified. Base
+functions are not in the library (see find_base_function) and take precedence.
+*/
+const clr_function* find_function(const clr_state* state, const std::string& name){
+	for (size_t f = 0 ; f < state->library->functions.size() ; f++){
+		if (name_equals(name, state->library->functions[f].name.c_str())) return &state->library->functions[f];
+	}
+	return NULL;
 }
 
 /*
@@ -748,7 +770,7 @@ Creates a printable string from the token 't'.
 std::string tokenstr(token t){
 	std::string s;
 	s = "[" + t.type + ",";
-	if (t.type == "ksym" || t.type == "var" || t.type == "kwrd" || t.type == "func"){
+	if (t.type == "ksym" || t.type == "var" || t.type == "kwrd" || t.type == "func" || t.type == "flag" || t.type == "str"){
 		s = s + t.valstr + "]";
 	}else if(t.type == "num"){
 		s = s + dtos(t.valnum.real(), 3, 3)+ "+" + dtos(t.valnum.imag(), 3, 3) + "i]";
@@ -777,8 +799,16 @@ comp cart(double r, double i){
 	return x;
 }
 
+/*
+Returns true if 'word' is a keyword whose arguments are file paths. The lexer
+keeps these arguments intact instead of splitting them on key symbols.
+*/
+bool keyword_takes_paths(const string& word){
+	return (name_equals(word, "ADDFN") || name_equals(word, "LOAD") || name_equals(word, "SAVE") || name_equals(word, "LOADB") || name_equals(word, "PROFILE") || name_equals(word, "RUN"));
+}
+
 //Ensures 'x' is a valid variable name for CLR
-bool is_valid_name(string x){
+bool is_valid_name(const string& x){
 	if (x.length() < 1) return false;
 	if (x.find("!") != string::npos || x.find("@") != string::npos || x.find("$") != string::npos || x.find("%") != string::npos || x.find("&") != string::npos) return false;
 	if (x.find("*") != string::npos || x.find("(") != string::npos || x.find(")") != string::npos || x.find("\"") != string::npos || x.find("'") != string::npos) return false;
@@ -854,19 +884,47 @@ EXAMPLE:
 */
 bool load_functions(std::string path, std::string default_dir, clr_state* state){
 
+	vector<string> files;
+	if (!read_function_list(path, default_dir, files)){
+		*state->out << "Failed to open list file." << endl;
+		return false;
+	}
+
+	clr_library* lib = writable_library(state);
 	clr_function temp_func;
-	temp_func.interpreted = true;
+	bool ret_val = true;
+	string reserved;
+	for (size_t f = 0 ; f < files.size() ; f++){
+		if (!load_function_file(files[f], temp_func)){
+			ret_val = false; //Report not all opened successfully
+		}else if (reserved_name(temp_func.name, reserved)){
+			*state->out << "Skipped function file '" << files[f] << "'. " << reserved << endl;
+			ret_val = false;
+		}else{
+			lib->functions.push_back(temp_func);
+		}
+	}
+
+	compile_functions(state);
+
+	return ret_val;
+}
+
+/*
+Reads the list file at 'path' (see load_functions) into 'files': the path of each
+.clrf file it names, with $(DEFAULT_DIR) replaced by 'default_dir'. Returns false
+if the list can't be opened.
+*/
+bool read_function_list(std::string path, std::string default_dir, std::vector<std::string>& files){
+
+	files.clear();
 
 	//Open list file
 	ifstream list_file(path);
-	if (!list_file.is_open()){
-		cout << "Failed to open list file." << endl;
-		return false;
-	}
+	if (!list_file.is_open()) return false;
 
 	//For each line
 	string line;
-	bool ret_val = true;
 	while (getline(list_file, line)){
 
 		//Skip blank lines
@@ -891,58 +949,56 @@ bool load_functions(std::string path, std::string default_dir, clr_state* state)
 			 index += default_dir.length();
 		}
 
-		//Open .clrf file
-		ifstream clrf(line);
-		if (!clrf.is_open()){ //If can't open file....
-			ret_val = false; //Report not all opened successfully
-			continue; //Try next file
-		}
-
-		//Reset temp_func
-		temp_func.helpstr = "";
-		temp_func.name = "";
-		temp_func.commands.clear();
-
-
-		//Scan each life of .clrf file
-		string fline;
-		size_t count = 0;
-		while (getline(clrf, fline)){
-
-			//Skip blank lines
-			if (line.length() < 1) continue;
-
-			//Process line...
-			if (fline[0] == '@'){ //Look for function name
-				temp_func.name = fline.substr(1); //Add remainder of line as function name
-			}else if (fline[0] == '~'){ //Look for the funciton description
-				temp_func.helpstr = temp_func.helpstr + fline.substr(1) + "\n"; //Add remainder of line as a help file line
-
-			//NOTE: I commented out the below two lines so comments are loaded
-			//	in as function contents. This way -vf lets you see the writer's
-			//	comments for improved readability.
-
-			// }else if (fline[0] == '#'){ //Is a comment. Skip!
-			// 	//Do nothing
-			}else{ //Line is a command line
-				temp_func.commands.push_back(fline);
-			}
-
-		}
+		files.push_back(line);
+	}
 
-		clrf.close();
+	return true;
+}
 
-		//Add function to 'state' if it's valid
-		if (temp_func.name == "" or temp_func.helpstr == ""){ //If name or helpstring is blank, say the read failed
-			ret_val = false;
-		}else{ //Otherwise add to 'state'
-			state->functions.push_back(temp_func);
+/*
+Reads the interpreted function in the .clrf file at 'path' (see load_functions)
+into 'func'. Returns false if the file can't be opened or has no name or help
+text.
+*/
+bool load_function_file(std::string path, clr_function& func){
+
+	func.interpreted = true;
+	func.fnptr = NULL;
+	func.batchptr = NULL;
+	func.compiled = false;
+	func.program.clear();
+	func.program_lines.clear();
+	func.helpstr = "";
+	func.name = "";
+	func.commands.clear();
+	func.source = path;
+
+	//Open .clrf file
+	ifstream clrf(path);
+	if (!clrf.is_open()) return false;
+
+	//Scan each line of .clrf file
+	string fline;
+	while (getline(clrf, fline)){
+
+		//Process line...
+		if (fline[0] == '@'){ //Look for function name
+			func.name = fline.substr(1); //Add remainder of line as function name
+		}else if (fline[0] == '~'){ //Look for the funciton description
+			func.helpstr = func.helpstr + fline.substr(1) + "\n"; //Add remainder of line as a help file line
+
+		//NOTE: I commented out the below two lines so comments are loaded
+		//	in as function contents. This way -vf lets you see the writer's
+		//	comments for improved readability.
+
+		// }else if (fline[0] == '#'){ //Is a comment. Skip!
+		// 	//Do nothing
+		}else{ //Line is a command line
+			func.commands.push_back(fline);
 		}
 
 	}
 
-	list_file.close();
-
-
-	return ret_val;
+	//The read failed if the name or help string is blank
+	return func.name != "" && func.helpstr != "";
 }
@@ -17,23 +17,50 @@ Created by Grant Giesbrecht on 6.6.2019
 #ifndef CLR_INTERPRET_HPP
 #define CLR_INTERPRET_HPP
 
-bool interpret_clr(std::string input, clr_state* state, std::string& print_out);
+bool interpret_clr(const std::string& input, clr_state* state, std::string& print_out);
 
 //CLR's Lexer
-std::vector<token> clr_lex(std::string input, clr_state* state, bool& success);
+std::vector<token> clr_lex(const std::string& input, clr_state* state, bool& success);
+
+//CLR's Lexer (writes into 'tks', reusing its storage)
+void clr_lex(const std::string& input, clr_state* state, bool& success, std::vector<token>& tks);
 
 //CLR's Parser
-std::vector<ast> clr_parse(std::vector<token> tks, clr_state* state, bool& success);
+std::vector<ast> clr_parse(const std::vector<token>& tks, clr_state* state, bool& success);
 
-//Evaluates an AST (or a subsection of an AST)
-token ast_eval(ast tree, clr_state* state, bool& success);
+//CLR's Parser (writes into 'trees', reusing its storage and that of 'spare')
+void clr_parse(const std::vector<token>& tks, clr_state* state, bool& success, std::vector<ast>& trees, std::vector<ast>& spare);
 
-//Fills the 'state' argument's keyword vector with all CLR keywords
-void fill_keywords(clr_state* state);
+//Evaluates a list of ASTs in order
+bool eval_trees(const std::vector<ast>& trees, clr_state* state, std::string& print_out, size_t& failed);
+
+//Evaluates an AST (or a subsection of an AST)
+token ast_eval(const ast& tree, clr_state* state, bool& success);
 
 //Fills the 'state' argument's variables vector with all critical CLR variables
 void fill_critical_variables(clr_state* state);
 
+//Sets up a new state with no functions loaded, printing to 'out'
+void init_state(clr_state* state, std::string help_dir, std::ostream* out);
+
+//Creates a new state sharing 'state's library and variables (copy-on-write)
+clr_state fork_state(const clr_state* state);
+
+//Returns a modifiable library for 'state', copying it first if it is shared
+clr_library* writable_library(clr_state* state);
+
+//Returns a modifiable variable table for 'state', copying it first if it is shared
+std::vector<variable>* writable_variables(clr_state* state);
+
+//Stores an array in a variable, creating the variable if needed
+void store_array(clr_state* state, std::string name, std::shared_ptr<const clr_array> arr);
+
+//Gets the value of a 'num' or 'var' token
+bool operand_value(const token& t, clr_state* state, clr_value& out, std::string& err);
+
+//Finds an interpreted or plugin function by name. Returns NULL if it does not exist
+const clr_function* find_function(const clr_state* state, const std::string& name);
+
 //Create a string form a token
 std::string tokenstr(token t);
 
@@ -44,9 +71,18 @@ std::string aststr(ast t);
 comp cart(double r, double i);
 
 //Determines if the input is a valid variable name
-bool is_valid_name(std::string x);
+bool is_valid_name(const std::string& x);
+
+//Determines if the input is a keyword whose arguments are file paths
+bool keyword_takes_paths(const std::string& word);
 
 //Loads a list (stored in a text file) of functions (stored in .clrf files) into state.
 bool load_functions(std::string path, std::string default_dir, clr_state* state);
 
+//Reads the paths of the .clrf files named in a list file
+bool read_function_list(std::string path, std::string default_dir, std::vector<std::string>& files);
+
+//Reads one interpreted function from a .clrf file
+bool load_function_file(std::string path, clr_function& func);
+
 #endif
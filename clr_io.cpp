@@ -0,0 +1,370 @@
+#include "clr_io.hpp"
+#include "clr_interpret.hpp"
+#include "clr_parallel.hpp"
+#include "clr_keywords.hpp"
+#include <IEGA/string_manip.hpp>
+#include <fstream>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+using namespace std;
+
+/*
+Returns true if 'c' separates fields in a delimited file.
+*/
+static inline bool is_separator(char c){
+	return (c == ',' || c == ' ' || c == '\t' || c == ';' || c == '\r');
+}
+
+/*
+Splits one line ('begin' to 'end', excluding the newline) into fields, converting
+each to a double and appending it to 'vals'. Returns false if a field is not a
+number. Blank lines and comments ('#') produce no values.
+*/
+static bool parse_line(const char* begin, const char* end, vector<double>& vals){
+
+	const char* p = begin;
+	while (p < end){
+		while (p < end && is_separator(*p)) p++; //Skip to next field
+		if (p == end || *p == '#') break;
+
+		char* num_end;
+		double v = strtod(p, &num_end);
+		if (num_end == p || num_end > end || (num_end < end && !is_separator(*num_end) && *num_end != '#')){
+			return false;
+		}
+		vals.push_back(v);
+		p = num_end;
+	}
+
+	return true;
+}
+
+/*
+Holds the values one thread parsed from its share of a chunk.
+
+cols = Parsed values, one vector per column
+lines = Number of lines in the thread's share
+error_line = Index of the first bad line within the share, or -1 if none
+*/
+typedef struct{
+	vector<vector<double> > cols;
+	size_t lines;
+	long error_line;
+}chunk_part;
+
+/*
+Parses the lines in 'begin' to 'end' (which must end on a line boundary) into
+'part'. Every non-blank line must have exactly 'ncols' fields.
+*/
+static void parse_part(const char* begin, const char* end, size_t ncols, chunk_part* part){
+
+	part->cols.assign(ncols, vector<double>());
+	part->lines = 0;
+	part->error_line = -1;
+
+	vector<double> vals;
+	const char* line = begin;
+	while (line < end){
+		const char* eol = (const char*)memchr(line, '\n', end - line);
+		if (eol == NULL) eol = end;
+
+		vals.clear();
+		if (!parse_line(line, eol, vals) || (vals.size() != 0 && vals.size() != ncols)){
+			part->error_line = part->lines;
+			return;
+		}
+		for (size_t c = 0 ; c < vals.size() ; c++){
+			part->cols[c].push_back(vals[c]);
+		}
+
+		part->lines++;
+		line = eol + 1;
+	}
+}
+
+/*
+Loads a delimited numeric text file into array variables, one per column. Fields
+may be separated by commas, semicolons, spaces or tabs. Blank lines and lines
+starting with '#' are skipped.
+
+The file is read in chunks of CLR_IO_CHUNK_SIZE bytes. Each chunk is split on line
+boundaries and the pieces are parsed on separate threads, then appended to the
+columns in order.
+
+Columns are named, in order of preference, by 'names', by the file's first line
+if it is a header (ie. not numeric), or 'col1', 'col2', etc. Header names which
+are not valid variable names or are reserved (see reserved_name) get the default.
+
+path - file to read
+names - variable names for the columns. Leave empty to use the header or defaults.
+state - state in which to create the variables
+err - set to a description of the problem if false is returned
+*/
+bool load_delimited(std::string path, std::vector<std::string> names, clr_state* state, std::string& err){
+
+	ifstream file(path.c_str(), ios::binary);
+	if (!file.is_open()){
+		err = "Failed to open file '" + path + "'.";
+		return false;
+	}
+
+	vector<std::shared_ptr<vector<comp> > > cols;
+	size_t ncols = 0;
+	size_t lines_done = 0; //Lines in previous chunks
+	bool found_first = false; //Has the first data line been seen (so ncols is known)?
+
+	vector<char> chunk(CLR_IO_CHUNK_SIZE);
+	string buf;
+	size_t nparts = parallel_threads();
+	vector<chunk_part> parts(nparts);
+	while (true){
+
+		//Read next chunk, keeping any partial line at the end for next time
+		file.read(&chunk[0], chunk.size());
+		size_t got = file.gcount();
+		bool at_end = (got < chunk.size());
+		buf.append(&chunk[0], got);
+
+		size_t usable = buf.size();
+		if (!at_end){
+			size_t last_nl = buf.rfind('\n');
+			if (last_nl == string::npos) continue; //Line longer than a chunk
+			usable = last_nl + 1;
+		}
+		const char* data = buf.c_str();
+		const char* data_end = data + usable;
+
+		//Find column count (and header) from the first non-blank line
+		while (!found_first && data < data_end){
+			const char* eol = (const char*)memchr(data, '\n', data_end - data);
+			if (eol == NULL) eol = data_end;
+			vector<double> vals;
+			if (!parse_line(data, eol, vals)){ //Not numeric - must be header
+				vector<string> header;
+				for (const char* h = data ; h < eol ; ){
+					while (h < eol && is_separator(*h)) h++;
+					const char* h_end = h;
+					while (h_end < eol && !is_separator(*h_end)) h_end++;
+					if (h_end > h) header.push_back(string(h, h_end));
+					h = h_end;
+				}
+				if (names.size() == 0){
+					for (size_t h = 0 ; h < header.size() ; h++){
+						names.push_back((is_valid_name(header[h]) && find_keyword(header[h]) == NULL) ? header[h] : "col" + dtos(h+1, 0, 3));
+					}
+				}
+				data = (eol < data_end) ? eol + 1 : data_end;
+				lines_done++;
+				ncols = header.size();
+				found_first = true;
+			}else if (vals.size() > 0){
+				ncols = vals.size();
+				found_first = true;
+			}else{ //Blank line or comment
+				data = (eol < data_end) ? eol + 1 : data_end;
+				lines_done++;
+			}
+		}
+		if (found_first && cols.size() == 0){
+			if (names.size() == 0){
+				for (size_t c = 0 ; c < ncols ; c++) names.push_back("col" + dtos(c+1, 0, 3));
+			}
+			if (names.size() != ncols){
+				err = "File '" + path + "' has " + dtos(ncols, 0, 3) + " columns, but " + dtos(names.size(), 0, 3) + " names were given.";
+				return false;
+			}
+			for (size_t c = 0 ; c < ncols ; c++){
+				cols.push_back(std::shared_ptr<vector<comp> >(new vector<comp>()));
+			}
+		}
+
+		//Split chunk into one piece per thread, each ending on a line boundary
+		vector<const char*> bounds(nparts + 1, data_end);
+		bounds[0] = data;
+		for (size_t p = 1 ; p < nparts ; p++){
+			const char* guess = data + (data_end - data)*p/nparts;
+			if (guess < bounds[p-1]) guess = bounds[p-1];
+			const char* nl = (const char*)memchr(guess, '\n', data_end - guess);
+			bounds[p] = (nl == NULL) ? data_end : nl + 1;
+		}
+
+		parallel_for(nparts, 1, [&](size_t begin, size_t end, size_t thread){
+			for (size_t p = begin ; p < end ; p++){
+				parse_part(bounds[p], bounds[p+1], ncols, &parts[p]);
+			}
+		});
+
+		//Append pieces in order
+		for (size_t p = 0 ; p < nparts ; p++){
+			if (parts[p].error_line != -1){
+				err = "Failed to read line " + dtos(lines_done + parts[p].error_line + 1, 0, 3) + " of '" + path + "'. Lines must hold " + dtos(ncols, 0, 3) + " numbers.";
+				return false;
+			}
+			for (size_t c = 0 ; c < ncols ; c++){
+				cols[c]->insert(cols[c]->end(), parts[p].cols[c].begin(), parts[p].cols[c].end());
+			}
+			lines_done += parts[p].lines;
+		}
+
+		buf.erase(0, usable);
+		if (at_end) break;
+	}
+
+	if (!found_first){
+		err = "File '" + path + "' contains no data.";
+		return false;
+	}
+
+	//Create variables
+	for (size_t c = 0 ; c < ncols ; c++){
+		std::shared_ptr<clr_array> arr(new clr_array());
+		arr->data = cols[c]->empty() ? NULL : &(*cols[c])[0];
+		arr->length = cols[c]->size();
+		arr->owner = cols[c];
+		store_array(state, names[c], arr);
+	}
+
+	return true;
+}
+
+/*
+Writes 'arr' to a binary array file at 'path' as CLR_DTYPE_COMPLEX128. The file is
+written beside 'path' and renamed over it once complete, so readers never see a
+partial file.
+*/
+bool save_array_binary(std::string path, const clr_array& arr, std::string& err){
+
+	array_file_header h;
+	memset(&h, 0, sizeof(h));
+	memcpy(h.magic, CLR_ARRAY_MAGIC, 8);
+	h.version = CLR_ARRAY_VERSION;
+	h.byte_order = CLR_ARRAY_BYTE_ORDER;
+	h.dtype = CLR_DTYPE_COMPLEX128;
+	h.length = arr.length;
+	h.data_offset = CLR_ARRAY_DATA_OFFSET;
+
+	string tmp_path = path + ".tmp";
+	int fd = open(tmp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0){
+		err = "Failed to open file '" + path + "' for writing.";
+		return false;
+	}
+
+	//Write header, then data in pieces (write() may not take it all at once)
+	bool ok = (ftruncate(fd, CLR_ARRAY_DATA_OFFSET) == 0 && pwrite(fd, &h, sizeof(h), 0) == sizeof(h));
+	const char* p = (const char*)arr.data;
+	size_t left = arr.length*sizeof(comp);
+	off_t offset = CLR_ARRAY_DATA_OFFSET;
+	while (ok && left > 0){
+		ssize_t wrote = pwrite(fd, p, left, offset);
+		if (wrote <= 0){
+			ok = false;
+			break;
+		}
+		p += wrote;
+		offset += wrote;
+		left -= wrote;
+	}
+	ok = ok && (fsync(fd) == 0);
+	close(fd);
+
+	if (!ok || rename(tmp_path.c_str(), path.c_str()) != 0){
+		unlink(tmp_path.c_str());
+		err = "Failed to write file '" + path + "'.";
+		return false;
+	}
+
+	return true;
+}
+
+/*
+Reads the binary array file at 'path' into 'arr'.
+
+CLR_DTYPE_COMPLEX128 files are memory-mapped and used in place - nothing is read
+until a value is used and the file is unmapped when the last reference to the
+array goes away. Other dtypes are converted into a new array.
+*/
+bool load_array_binary(std::string path, std::shared_ptr<const clr_array>& arr, std::string& err){
+
+	int fd = open(path.c_str(), O_RDONLY);
+	if (fd < 0){
+		err = "Failed to open file '" + path + "'.";
+		return false;
+	}
+
+	//Read and check header
+	struct stat st;
+	array_file_header h;
+	if (fstat(fd, &st) != 0 || pread(fd, &h, sizeof(h), 0) != sizeof(h) || memcmp(h.magic, CLR_ARRAY_MAGIC, 8) != 0){
+		err = "File '" + path + "' is not a CLR array file.";
+		close(fd);
+		return false;
+	}
+	if (h.version != CLR_ARRAY_VERSION || h.byte_order != CLR_ARRAY_BYTE_ORDER){
+		err = "File '" + path + "' was written by an incompatible version of CLR or on a machine with different byte order.";
+		close(fd);
+		return false;
+	}
+	size_t value_size;
+	if (h.dtype == CLR_DTYPE_COMPLEX128){
+		value_size = sizeof(comp);
+	}else if (h.dtype == CLR_DTYPE_FLOAT64){
+		value_size = sizeof(double);
+	}else{
+		err = "File '" + path + "' has unsupported data type " + dtos(h.dtype, 0, 3) + ".";
+		close(fd);
+		return false;
+	}
+	if (h.data_offset < sizeof(h) || h.data_offset % sizeof(double) != 0 || h.data_offset > (uint64_t)st.st_size || h.length > ((uint64_t)st.st_size - h.data_offset)/value_size){
+		err = "File '" + path + "' is truncated or corrupt.";
+		close(fd);
+		return false;
+	}
+
+	std::shared_ptr<clr_array> a(new clr_array());
+	a->length = h.length;
+	a->data = NULL;
+
+	if (h.length == 0){
+		close(fd);
+		arr = a;
+		return true;
+	}
+
+	//Map data. Pages are private so a stray write can never reach the file. The
+	// mapping must start on a page boundary, and pages may be larger than
+	// CLR_ARRAY_DATA_OFFSET (eg. 16K), so map from the page holding the data's start.
+	uint64_t page = (uint64_t)sysconf(_SC_PAGESIZE);
+	uint64_t map_start = h.data_offset - h.data_offset % page;
+	size_t skip = h.data_offset - map_start;
+	size_t map_len = skip + h.length*value_size;
+	void* base = mmap(NULL, map_len, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, map_start);
+	close(fd); //Mapping stays valid
+	if (base == MAP_FAILED){
+		err = "Failed to map file '" + path + "'.";
+		return false;
+	}
+	char* data = (char*)base + skip;
+
+	if (h.dtype == CLR_DTYPE_COMPLEX128){ //Use in place
+		a->data = (comp*)data;
+		a->owner = std::shared_ptr<void>(base, [map_len](void* p){ munmap(p, map_len); });
+	}else{ //Convert
+		std::shared_ptr<vector<comp> > vals(new vector<comp>(h.length));
+		const double* re = (const double*)data;
+		for (size_t k = 0 ; k < h.length ; k++){
+			(*vals)[k] = comp(re[k], 0);
+		}
+		munmap(base, map_len);
+		a->data = &(*vals)[0];
+		a->owner = vals;
+	}
+
+	arr = a;
+	return true;
+}
@@ -0,0 +1,51 @@
+/*
+This file declares functions for moving variables in and out of files.
+
+Created by Grant Giesbrecht on 19.10.2026
+
+*/
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include "clr_types.hpp"
+
+#ifndef CLR_IO_HPP
+#define CLR_IO_HPP
+
+#define CLR_IO_CHUNK_SIZE (8 << 20) //Bytes of a text file parsed at a time
+
+#define CLR_ARRAY_MAGIC "CLRARR01"
+#define CLR_ARRAY_VERSION 1
+#define CLR_ARRAY_BYTE_ORDER 0x01020304 //Reads back differently on a machine of the other endianness
+#define CLR_ARRAY_DATA_OFFSET 4096 //Data starts after the header, on a page boundary on hosts with 4K pages
+
+#define CLR_DTYPE_COMPLEX128 1 //Pairs of doubles (real, imag) - same layout as 'comp'
+#define CLR_DTYPE_FLOAT64 2 //Real doubles
+
+/*
+Header of a binary array file. The values follow at 'data_offset'.
+
+dtype = Layout of each value. One of the CLR_DTYPE_* constants.
+length = Number of values
+*/
+typedef struct{
+	char magic[8];
+	uint32_t version;
+	uint32_t byte_order;
+	uint32_t dtype;
+	uint32_t reserved;
+	uint64_t length;
+	uint64_t data_offset;
+}array_file_header;
+
+//Loads the columns of a delimited numeric text file (eg. CSV) into array variables
+bool load_delimited(std::string path, std::vector<std::string> names, clr_state* state, std::string& err);
+
+//Writes an array to a binary array file
+bool save_array_binary(std::string path, const clr_array& arr, std::string& err);
+
+//Reads a binary array file, mapping it into memory rather than copying where possible
+bool load_array_binary(std::string path, std::shared_ptr<const clr_array>& arr, std::string& err);
+
+#endif
@@ -0,0 +1,338 @@
+#include "clr_kernels.hpp"
+#include <cmath>
+#include <cstring>
+#include <stdint.h>
+
+//Adding then subtracting this rounds a double (|x| < 2^51) to the nearest integer
+#define ROUND_MAGIC 6755399441055744.0
+
+//pi/2 split into three pieces of 33 bits, so q*PIO2_1, q*PIO2_2 and q*PIO2_3 are
+// exact for |q| < 2^20, and the rest, PIO2_3T (fdlibm)
+#define PIO2_1 1.57079632673412561417e+00
+#define PIO2_2 6.07710050630396597660e-11
+#define PIO2_3 2.02226624871116645580e-21
+#define PIO2_3T 8.47842766036889956997e-32
+#define TWO_OVER_PI 6.36619772367581382433e-01
+
+//ln(2) split so k*LN2_HI is exact (fdlibm)
+#define LN2_HI 6.93147180369123816490e-01
+#define LN2_LO 1.90821492927058770002e-10
+#define INV_LN2 1.44269504088896338700e+00
+
+#define SQRT2 1.41421356237309504880
+
+#define SINCOS_LIMIT 1e5
+#define EXP_MIN -708.0
+#define EXP_MAX 709.0
+
+/*
+Reinterprets the bits of a double as an integer and back. memcpy is the portable
+way to do this and compiles to a register move.
+*/
+static inline int64_t bits_of(double x){
+	int64_t b;
+	memcpy(&b, &x, sizeof(b));
+	return b;
+}
+static inline double from_bits(int64_t b){
+	double x;
+	memcpy(&x, &b, sizeof(x));
+	return x;
+}
+
+/*
+Computes s = a + b and the rounding error e, so s + e = a + b exactly (Knuth's
+two-sum, which needs no branch on which of a and b is larger).
+*/
+static inline void two_sum(double a, double b, double& s, double& e){
+	s = a + b;
+	double bb = s - a;
+	e = (a - (s - bb)) + (b - bb);
+}
+
+/*
+sin(r + rt) for |r| <= pi/4, where rt is a correction much smaller than r.
+Taylor series through r^17 (truncation error < 2^-60 |r|), plus
+rt*cos(r) ~ rt*(1 - r^2/2).
+*/
+static inline double poly_sin(double r, double rt){
+	double r2 = r*r;
+	double p = 2.81145725434552059811e-15; //1/17!
+	p = p*r2 - 7.64716373181981640551e-13; //1/15!
+	p = p*r2 + 1.60590438368216133409e-10; //1/13!
+	p = p*r2 - 2.50521083854417202239e-08; //1/11!
+	p = p*r2 + 2.75573192239858925110e-06; //1/9!
+	p = p*r2 - 1.98412698412698412526e-04; //1/7!
+	p = p*r2 + 8.33333333333333321769e-03; //1/5!
+	p = p*r2 - 1.66666666666666657415e-01; //1/3!
+	return r + (r*r2*p + rt*(1.0 - 0.5*r2));
+}
+
+/*
+cos(r + rt) for |r| <= pi/4, where rt is a correction much smaller than r.
+Taylor series through r^18 (truncation error < 2^-60), minus rt*sin(r) ~ rt*r.
+*/
+static inline double poly_cos(double r, double rt){
+	double r2 = r*r;
+	double p = -1.56192069685862252711e-16; //1/18!
+	p = p*r2 + 4.77947733238738525345e-14; //1/16!
+	p = p*r2 - 1.14707455977297245073e-11; //1/14!
+	p = p*r2 + 2.08767569878681001866e-09; //1/12!
+	p = p*r2 - 2.75573192239858882758e-07; //1/10!
+	p = p*r2 + 2.48015873015873015658e-05; //1/8!
+	p = p*r2 - 1.38888888888888894189e-03; //1/6!
+	p = p*r2 + 4.16666666666666643537e-02; //1/4!
+	double hz = 0.5*r2;
+	double w = 1.0 - hz;
+	return w + (((1.0 - w) - hz) + (r2*r2*p - r*rt)); //Recover rounding error of 1 - r^2/2 (fdlibm)
+}
+
+/*
+exp(r) for |r| <= ln(2)/2. Taylor series through r^13; truncation error < 2^-62.
+*/
+static inline double poly_exp(double r){
+	double p = 1.60590438368216133409e-10; //1/13!
+	p = p*r + 2.08767569878681001866e-09; //1/12!
+	p = p*r + 2.50521083854417202239e-08; //1/11!
+	p = p*r + 2.75573192239858882758e-07; //1/10!
+	p = p*r + 2.75573192239858925110e-06; //1/9!
+	p = p*r + 2.48015873015873015658e-05; //1/8!
+	p = p*r + 1.98412698412698412526e-04; //1/7!
+	p = p*r + 1.38888888888888894189e-03; //1/6!
+	p = p*r + 8.33333333333333321769e-03; //1/5!
+	p = p*r + 4.16666666666666643537e-02; //1/4!
+	p = p*r + 1.66666666666666657415e-01; //1/3!
+	p = p*r + 0.5;
+	return 1.0 + (r + r*r*p);
+}
+
+/*
+sinh(r) for |r| <= 1. Taylor series through r^21; truncation error < 2^-65 |r|.
+*/
+static inline double poly_sinh(double r){
+	double r2 = r*r;
+	double p = 1.95729410633912625952e-20; //1/21!
+	p = p*r2 + 8.22063524662432949554e-18; //1/19!
+	p = p*r2 + 2.81145725434552059811e-15; //1/17!
+	p = p*r2 + 7.64716373181981640551e-13; //1/15!
+	p = p*r2 + 1.60590438368216133409e-10; //1/13!
+	p = p*r2 + 2.50521083854417202239e-08; //1/11!
+	p = p*r2 + 2.75573192239858925110e-06; //1/9!
+	p = p*r2 + 1.98412698412698412526e-04; //1/7!
+	p = p*r2 + 8.33333333333333321769e-03; //1/5!
+	p = p*r2 + 1.66666666666666657415e-01; //1/3!
+	return r + r*r2*p;
+}
+
+/*
+2*atanh(s) - 2s for |s| <= 1/3, ie. the tail of log((1+s)/(1-s)). Series through
+s^37; truncation error < 2^-58 |s|.
+*/
+static inline double poly_log_tail(double s){
+	double s2 = s*s;
+	double p = 2.0/37;
+	p = p*s2 + 2.0/35;
+	p = p*s2 + 2.0/33;
+	p = p*s2 + 2.0/31;
+	p = p*s2 + 2.0/29;
+	p = p*s2 + 2.0/27;
+	p = p*s2 + 2.0/25;
+	p = p*s2 + 2.0/23;
+	p = p*s2 + 2.0/21;
+	p = p*s2 + 2.0/19;
+	p = p*s2 + 2.0/17;
+	p = p*s2 + 2.0/15;
+	p = p*s2 + 2.0/13;
+	p = p*s2 + 2.0/11;
+	p = p*s2 + 2.0/9;
+	p = p*s2 + 2.0/7;
+	p = p*s2 + 2.0/5;
+	p = p*s2 + 2.0/3;
+	return s*s2*p;
+}
+
+/*
+Computes sin & cos of 'a'. 'a' is reduced to r + rt = a - q*pi/2 with |r| <= pi/4,
+and q mod 4 picks which of sin(r)/cos(r) (and sign) gives each result.
+
+The reduced argument is carried as the double-double r + rt, like fdlibm's
+rem_pio2: each piece of pi/2 is subtracted with two_sum and the rounding errors
+are collected in rt. Near a multiple of pi/2, where a - q*pi/2 cancels to far
+fewer bits than 'a' has, r is still correct to the last bit.
+*/
+void kernel_sincos(const double* a, double* s, double* c, size_t n){
+
+	for (size_t k = 0 ; k < n ; k++){
+		double qm = a[k]*TWO_OVER_PI + ROUND_MAGIC;
+		int64_t quad = bits_of(qm) & 3; //Low bits of the mantissa hold q
+		double q = qm - ROUND_MAGIC;
+
+		double r1 = a[k] - q*PIO2_1; //Exact
+		double r2, e2, r3, e3;
+		two_sum(r1, -q*PIO2_2, r2, e2);
+		two_sum(r2, -q*PIO2_3, r3, e3);
+		double lo = (e2 + e3) - q*PIO2_3T;
+		double r = r3 + lo;
+		double rt = lo - (r - r3);
+
+		double ps = poly_sin(r, rt);
+		double pc = poly_cos(r, rt);
+		double sv = (quad & 1) ? pc : ps;
+		double cv = (quad & 1) ? ps : pc;
+		s[k] = (quad & 2) ? -sv : sv;
+		c[k] = ((quad + 1) & 2) ? -cv : cv;
+	}
+
+	//Out of range (or NaN/inf) inputs
+	for (size_t k = 0 ; k < n ; k++){
+		if (!(std::fabs(a[k]) <= SINCOS_LIMIT)){
+			s[k] = std::sin(a[k]);
+			c[k] = std::cos(a[k]);
+		}
+	}
+}
+
+/*
+Computes exp(a). 'a' is reduced to r = a - k*ln(2) with |r| <= ln(2)/2, then
+exp(a) = 2^k exp(r) where 2^k is built directly in the exponent bits.
+*/
+void kernel_exp(const double* a, double* out, size_t n){
+
+	for (size_t k = 0 ; k < n ; k++){
+		double x = (a[k] < EXP_MIN) ? EXP_MIN : ((a[k] > EXP_MAX) ? EXP_MAX : a[k]); //Keep 2^k representable
+		double km = x*INV_LN2 + ROUND_MAGIC;
+		double kf = km - ROUND_MAGIC;
+		int64_t ki = bits_of(km) - bits_of(ROUND_MAGIC);
+		double r = (x - kf*LN2_HI) - kf*LN2_LO;
+		out[k] = poly_exp(r) * from_bits((ki + 1023) << 52);
+	}
+
+	for (size_t k = 0 ; k < n ; k++){
+		if (!(a[k] >= EXP_MIN && a[k] <= EXP_MAX)){
+			out[k] = std::exp(a[k]);
+		}
+	}
+}
+
+/*
+Computes sinh & cosh of 'a'. sinh uses its Taylor series when |a| < 1, where the
+exp form would cancel; otherwise both come from e = exp(|a|).
+*/
+void kernel_sinhcosh(const double* a, double* sh, double* ch, size_t n){
+
+	double e[CLR_KERNEL_BLOCK];
+	double x[CLR_KERNEL_BLOCK];
+
+	for (size_t b = 0 ; b < n ; b += CLR_KERNEL_BLOCK){
+		size_t m = (n - b < CLR_KERNEL_BLOCK) ? n - b : CLR_KERNEL_BLOCK;
+
+		for (size_t k = 0 ; k < m ; k++){
+			x[k] = std::fabs(a[b+k]);
+		}
+		kernel_exp(x, e, m);
+
+		for (size_t k = 0 ; k < m ; k++){
+			double ei = 1.0/e[k];
+			double big = 0.5*(e[k] - ei);
+			double small = poly_sinh(x[k]);
+			double mag = (x[k] < 1.0) ? small : big;
+			sh[b+k] = (a[b+k] < 0) ? -mag : mag;
+			ch[b+k] = 0.5*(e[k] + ei);
+		}
+	}
+
+	for (size_t k = 0 ; k < n ; k++){
+		if (!(std::fabs(a[k]) <= -EXP_MIN)){
+			sh[k] = std::sinh(a[k]);
+			ch[k] = std::cosh(a[k]);
+		}
+	}
+}
+
+/*
+Computes log(a). 'a' is split into 2^e * f with sqrt(1/2) <= f < sqrt(2), then
+log(a) = e*ln(2) + log(f), with log(f) = 2*atanh((f-1)/(f+1)).
+*/
+void kernel_log(const double* a, double* out, size_t n){
+
+	for (size_t k = 0 ; k < n ; k++){
+		int64_t bits = bits_of(a[k]);
+		int64_t e = ((bits >> 52) & 0x7FF) - 1023;
+		double f = from_bits((bits & 0x000FFFFFFFFFFFFFLL) | 0x3FF0000000000000LL); //Mantissa in [1, 2)
+		bool hi = f > SQRT2;
+		f = hi ? 0.5*f : f;
+		double ef = (double)(hi ? e + 1 : e);
+
+		double s = (f - 1.0)/(f + 1.0);
+		double logf = 2.0*s + poly_log_tail(s);
+		out[k] = ef*LN2_HI + (ef*LN2_LO + logf);
+	}
+
+	//Zero, negative, subnormal, inf & NaN
+	for (size_t k = 0 ; k < n ; k++){
+		if (!(a[k] >= 2.2250738585072014e-308 && a[k] <= 1.7976931348623157e308)){
+			out[k] = std::log(a[k]);
+		}
+	}
+}
+
+/*
+Computes log(|re + i*im|) = log(m) + log(1 + (n/m)^2)/2 with m and n the larger and
+smaller of |re| & |im|. The second term uses u = (n/m)^2 directly,
+log(1+u) = 2*atanh(u/(2+u)), so it keeps full precision when u is small.
+*/
+void kernel_logabs(const double* re, const double* im, double* out, size_t n){
+
+	double mx[CLR_KERNEL_BLOCK];
+	double lm[CLR_KERNEL_BLOCK];
+
+	for (size_t b = 0 ; b < n ; b += CLR_KERNEL_BLOCK){
+		size_t cnt = (n - b < CLR_KERNEL_BLOCK) ? n - b : CLR_KERNEL_BLOCK;
+
+		for (size_t k = 0 ; k < cnt ; k++){
+			double x = std::fabs(re[b+k]);
+			double y = std::fabs(im[b+k]);
+			mx[k] = (x > y) ? x : y;
+		}
+		kernel_log(mx, lm, cnt);
+
+		for (size_t k = 0 ; k < cnt ; k++){
+			double x = std::fabs(re[b+k]);
+			double y = std::fabs(im[b+k]);
+			double mn = (x > y) ? y : x;
+			double r = (mx[k] > 0) ? mn/mx[k] : 0.0;
+			double u = r*r;
+			double s = u/(2.0 + u);
+			double l1p = 2.0*s + poly_log_tail(s);
+			out[b+k] = lm[k] + 0.5*l1p;
+		}
+	}
+
+	for (size_t k = 0 ; k < n ; k++){
+		if (!(std::isfinite(re[k]) && std::isfinite(im[k]))){
+			out[k] = std::log(std::hypot(re[k], im[k]));
+		}
+	}
+}
+
+/*
+Computes |re + i*im| = m*sqrt(1 + (n/m)^2) with m and n the larger and smaller of
+|re| & |im|.
+*/
+void kernel_hypot(const double* re, const double* im, double* out, size_t n){
+
+	for (size_t k = 0 ; k < n ; k++){
+		double x = std::fabs(re[k]);
+		double y = std::fabs(im[k]);
+		double mx = (x > y) ? x : y;
+		double mn = (x > y) ? y : x;
+		double r = (mx > 0) ? mn/mx : 0.0;
+		out[k] = mx*std::sqrt(1.0 + r*r);
+	}
+
+	for (size_t k = 0 ; k < n ; k++){
+		if (!(std::isfinite(re[k]) && std::isfinite(im[k]))){
+			out[k] = std::hypot(re[k], im[k]);
+		}
+	}
+}
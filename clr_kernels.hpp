@@ -0,0 +1,45 @@
+/*
+This file declares CLR's array kernels. These evaluate elementary functions over
+arrays of doubles and are the building blocks of the batched base functions.
+
+Each kernel is a straight-line loop with no branches or calls in its body so the
+compiler can vectorize it (build with -O2 or higher). Inputs outside a kernel's
+fast range are recomputed with the standard library afterwards, so every kernel
+accepts any input.
+
+Error bounds are the largest errors observed against long double references over
+10^7 random inputs spanning each kernel's fast range (for kernel_sincos, also
+every double within 4 ulp of a multiple of pi/2 in that range).
+
+Created by Grant Giesbrecht on 19.10.2026
+
+*/
+
+#include <stddef.h>
+
+#ifndef CLR_KERNELS_HPP
+#define CLR_KERNELS_HPP
+
+#define CLR_KERNEL_BLOCK 256 //Number of elements batched functions process at a time
+
+//sin(a) -> s, cos(a) -> c. Max error 0.8 ulp for |a| <= 1e5, including a next to
+//	multiples of pi/2 (where sin or cos is near 0).
+void kernel_sincos(const double* a, double* s, double* c, size_t n);
+
+//exp(a) -> out. Max error 1 ulp for -708 <= a <= 709.
+void kernel_exp(const double* a, double* out, size_t n);
+
+//sinh(a) -> sh, cosh(a) -> ch. Max error 2 ulp for |a| <= 708.
+void kernel_sinhcosh(const double* a, double* sh, double* ch, size_t n);
+
+//log(a) -> out. Max error 2 ulp for normal, positive a.
+void kernel_log(const double* a, double* out, size_t n);
+
+//log(|re + i*im|) -> out. Max error 2 ulp where |out| >= 1, otherwise 2^-51
+//	absolute (the result cancels when |re + i*im| is near 1).
+void kernel_logabs(const double* re, const double* im, double* out, size_t n);
+
+//|re + i*im| -> out without intermediate overflow. Max error 2 ulp.
+void kernel_hypot(const double* re, const double* im, double* out, size_t n);
+
+#endif
@@ -0,0 +1,1703 @@
+#include "clr_keywords.hpp"
+#include "clr_interpret.hpp"
+#include "clr_session.hpp"
+#include "clr_plugin.hpp"
+#include "clr_io.hpp"
+#include "clr_arrays.hpp"
+#include "clr_compile.hpp"
+#include "clr_memstat.hpp"
+#include "clr_formula.hpp"
+#include "clr_reduce.hpp"
+#include "clr_profile.hpp"
+#include "clr_matrix.hpp"
+#include "clr_fft.hpp"
+#include "clr_root.hpp"
+#include "clr_integrate.hpp"
+#include "clr_random.hpp"
+#include <IEGA/string_manip.hpp>
+#include <IEGA/stdutil.hpp>
+#include <cstdlib>
+#include <cmath>
+#include <algorithm>
+#include <fstream>
+#include <climits>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace std;
+
+/*
+Returns true if 'word' equals 'name' ignoring case. 'name' must be uppercase.
+Unlike comparing with to_uppercase(word), this does not allocate.
+*/
+bool name_equals(const std::string& word, const char* name){
+	size_t i = 0;
+	for ( ; i < word.length() && name[i] != 0 ; i++){
+		if (name_upper(word[i]) != name[i]) return false;
+	}
+	return (i == word.length() && name[i] == 0);
+}
+
+/*
+Returns the index of the variable named 'name' in 'state', or -1 if there is none.
+*/
+static size_t variable_index(const clr_state* state, const std::string& name){
+	for (size_t v = 0 ; v < state->variables->size() ; v++){
+		if ((*state->variables)[v].name == name) return v;
+	}
+	return -1;
+}
+
+//****************************************************************************
+// KEYWORD HANDLERS
+
+/*
+FLP: Flip contents of {x} and {y}.
+*/
+static token kw_flp(const ast& tree, clr_state* state, bool& success){
+
+	token tk;
+
+	clr_value temp_x = state->x;
+	state->x = state->y;
+	state->y = temp_x;
+
+	return tk;
+}
+
+/*
+LSTX: Recall the last {x}. Not yet implemented.
+*/
+static token kw_lstx(const ast& tree, clr_state* state, bool& success){
+
+	token tk;
+
+	return tk;
+}
+
+/*
+DN: Roll stack down.
+*/
+static token kw_dn(const ast& tree, clr_state* state, bool& success){
+
+	token tk;
+
+	clr_value temp_x = state->x;
+	state->x = state->y;
+	state->y = state->z;
+	state->z = state->t;
+	state->t = temp_x;
+
+	return tk;
+}
+
+/*
+UP: Roll stack up.
+*/
+static token kw_up(const ast& tree, clr_state* state, bool& success){
+
+	token tk;
+
+	clr_value temp_x = state->x;
+	state->x = state->t;
+	state->t = state->z;
+	state->z = state->y;
+	state->y = temp_x;
+
+	return tk;
+}
+
+/*
+STK: Print stack.
+*/
+static token kw_stk(const ast& tree, clr_state* state, bool& success){
+
+	token tk;
+
+	*state->out << "\t{T}: " << valuestr(state->t) << endl;
+	*state->out << "\t{Z}: " << valuestr(state->z) << endl;
+	*state->out << "\t{Y}: " << valuestr(state->y) << endl;
+	*state->out << "\t{X}: " << valuestr(state->x) << endl;
+
+	return tk;
+}
+
+/*
+STO: Save {x} into the specified variable.
+*/
+static token kw_sto(const ast& tree, clr_state* state, bool& success){
+
+	token tk;
+
+	//Ensure exactly one variable name follows...
+	if (tree.next.size() != 1){
+		success = false;
+		tk.valstr = "Too many arguments provided to STO command. Exactly one argument must be given.";
+		return tk;
+	}
+	if (reserved_name(tree.next[0].tk.valstr, tk.valstr)){
+		success = false;
+		return tk;
+	}
+
+	//Arrays are stored by reference (no copy is made)
+	if (state->x.arr){
+		if (!is_valid_name(tree.next[0].tk.valstr)){
+			success = false;
+			tk.valstr = "'" + tree.next[0].tk.valstr + "' is not a valid variable name.";
+			return tk;
+		}
+		store_array(state, tree.next[0].tk.valstr, state->x.arr);
+		return tk;
+	}
+
+	//Formulas which read the variable must be recomputed
+	mark_dependents_dirty(state, tree.next[0].tk.valstr);
+
+	//See if variable already exists...
+	size_t vidx = variable_index(state, tree.next[0].tk.valstr);
+	if (vidx != (size_t)-1){ //Variable already exists
+		variable& v = (*writable_variables(state))[vidx];
+		v.type = "num";
+		v.valnum = state->x.num; //Load {x} into variable
+		v.valarr.reset();
+		v.formula.reset();
+		v.dirty = false;
+	}else{ //Create a new variable, load {x} into it, and load it into state
+		variable temp_var;
+		temp_var.name = tree.next[0].tk.valstr;
+		temp_var.type = "num";
+		temp_var.valnum = state->x.num;
+		temp_var.dirty = false;
+		writable_variables(state)->push_back(temp_var);
+		vidx = state->variables->size()-1;
+	}
+
+	//Mirror to session file
+	if (state->session != NULL && !session_store_variable(state->session, (*state->variables)[vidx])){
+		*state->out << "\t Warning: Failed to save variable '" + tree.next[0].tk.valstr + "' to session file." << endl;
+	}
+
+	return tk;
+}
+
+/*
+RCL: Load the variable into {x} and push up the stack.
+*/
+static token kw_rcl(const ast& tree, clr_state* state, bool& success){
+
+	token tk;
+
+	//Ensure exactly one variable name follows...
+	if (tree.next.size() != 1){
+		success = false;
+		tk.valstr = "Too many arguments provided to STO command. Exactly one argument must be given.";
+		return tk;
+	}
+
+	//See if variable already exists...
+	size_t vidx = variable_index(state, tree.next[0].tk.valstr);
+	if (vidx != (size_t)-1){ //Variable already exists
+		//Get value, recomputing formulas if needed
+		clr_value val;
+		if ((*state->variables)[vidx].type == "fml"){
+			if (!formula_value(state, vidx, val, tk.valstr)){
+				success = false;
+				return tk;
+			}
+		}else if ((*state->variables)[vidx].type == "arr"){
+			val = clr_value((*state->variables)[vidx].valarr);
+		}else{
+			val = (*state->variables)[vidx].valnum;
+		}
+
+		//Push registers up
+		state->t = state->z;
+		state->z = state->y;
+		state->y = state->x;
+		state->x = val;
+	}else{ //Variable does not exist - give error
+		success = false;
+		tk.valstr = "Variable '" + tree.next[0].tk.valstr + "' does not exist.\n";
+		return tk;
+	}
+
+	return tk;
+}
+
+/*
+CLX: Clear {x}.
+*/
+static token kw_clx(const ast& tree, clr_state* state, bool& success){
+
+	token tk;
+
+	state->x = cart(0, 0);
+
+	return tk;
+}
+
+/*
+CLREG: Clear all registers.
+*/
+static token kw_clreg(const ast& tree, clr_state* state, bool& success){
+
+	token tk;
+
+	state->x = cart(0, 0);
+	state->y = cart(0, 0);
+	state->z = cart(0, 0);
+	state->t = cart(0, 0);
+
+	return tk;
+}
+
+/*
+LSVAR: List all variables.
+*/
+static token kw_lsvar(const ast& tree, clr_state* state, bool& success){
+
+	token tk;
+
+	*state->out << "Varibales:" << endl;
+	for (size_t v = 0 ; v < state->variables->size() ; v++){
+		const variable& var = (*state->variables)[v];
+		if (var.type == "fml"){ //Show the last computed value without recomputing
+			*state->out << "\t" << var.name << " = ";
+			if (var.dirty){
+				*state->out << "?";
+			}else if (var.valarr){
+				*state->out << "[" << var.valarr->length << " values]";
+			}else{
+				*state->out << var.valnum;
+			}
+			*state->out << "\t\tType: fml (" << var.formula->text << ")" << endl;
+		}else if ((*state->variables)[v].type == "arr"){
+			*state->out << "\t" << (*state->variables)[v].name << " = [" << (*state->variables)[v].valarr->length << " values]\t\tType: " << (*state->variables)[v].type << endl;
+		}else{
+			*state->out << "\t" << (*state->variables)[v].name << " = " << (*state->variables)[v].valnum << "\t\tType: " << (*state->variables)[v].type << endl;
+		}
+	}
+
+	return tk;
+}
+
+/*
+CLVAR: Clear the variables from CLR.
+*/
+static token kw_clvar(const ast& tree, clr_state* state, bool& success){
+
+	token tk;
+
+	fill_critical_variables(state); //Erase all variables, then restore those which are critical to CLR's correct operation
+	if (state->session != NULL) session_clear_variables(state->session);
+
+	return tk;
+}
+
+/*
+CLEAR: Clears the terminal, by printing the ANSI escape codes that erase the
+screen and move the cursor home.
+*/
+static token kw_clear(const ast& tree, clr_state* state, bool& success){
+
+	token tk;
+
+	*state->out << "\033[2J\033[H" << std::flush;
+
+	return tk;
+}
+
+/*
+Operations of the HELP keyword, selected by its flags. HELP_LONG modifies the
+other operations rather than replacing them.
+*/
+typedef enum{
+	HELP_INTRO,
+	HELP_VERBOSE,
+	HELP_LIST_FUNCTIONS,
+	HELP_LIST_KEYWORDS,
+	HELP_VIEW_FUNCTION,
+	HELP_SEARCH,
+	HELP_LONG
+}help_op;
+
+/*
+Every flag of the HELP keyword and the operation it selects:
+
+-intro: prints intro help page (default)
+-v or -verbose: prints verbose help page
+-lf: lists all functions
+-lc or -lk: lists all commands (TODO)
+-l: prints all information available for requested page. Affects:
+	-lf - (prints if interpreted/compiled. No. lines if interpreted)
+-vf: View function - prints commands of interpreted function
+*/
+#define CLR_HELP_FLAG_TABLE(X) \
+	X("-INTRO", HELP_INTRO) \
+	X("-V", HELP_VERBOSE) \
+	X("-VERBOSE", HELP_VERBOSE) \
+	X("-LF", HELP_LIST_FUNCTIONS) \
+	X("-LC", HELP_LIST_KEYWORDS) \
+	X("-LK", HELP_LIST_KEYWORDS) \
+	X("-L", HELP_LONG) \
+	X("-VF", HELP_VIEW_FUNCTION)
+
+/*
+Returns the operation selected by the HELP flag 'flag' (case insensitive), or -1
+if it is not a HELP flag. Works the same way as find_keyword.
+*/
+static int find_help_flag(const std::string& flag){
+
+	#define CLR_HELP_FLAG_CASE(name, op) case name_hash(name): return name_equals(flag, name) ? op : -1;
+	switch (name_hash(flag.c_str())){
+		CLR_HELP_FLAG_TABLE(CLR_HELP_FLAG_CASE)
+		default: return -1;
+	}
+	#undef CLR_HELP_FLAG_CASE
+}
+
+/*
+Prints the help file at 'path' to 'out'. Returns false if it can't be opened.
+*/
+static bool print_help_file(const std::string& path, std::ostream& out){
+	ifstream in(path.c_str());
+	if (!in.is_open()) return false;
+	out << in.rdbuf();
+	return true;
+}
+
+/*
+HELP: Print help pages. See CLR_HELP_FLAG_TABLE for the flags.
+*/
+static token kw_help(const ast& tree, clr_state* state, bool& success){
+
+	token tk;
+
+	int help_operation = HELP_INTRO;
+	bool print_long = false;
+
+	vector<string> pages;
+
+	//Process flags if present
+	for (size_t n = 0 ; n < tree.next.size() ; n++){ //For each extra token
+		if (tree.next[n].tk.type == "flag"){
+			int op = find_help_flag(tree.next[n].tk.valstr);
+			if (op == -1){
+				*state->out << "\t Ignoring Unrecognized flag '" + tree.next[n].tk.valstr + "'." << endl;
+			}else if (op == HELP_LONG){
+				print_long = true;
+			}else{
+				help_operation = op;
+			}
+		}else if(tree.next[n].tk.type == "var" || tree.next[n].tk.type == "func" || tree.next[n].tk.type == "kwrd"){ //Must be a page to search for
+			if (help_operation == HELP_INTRO) help_operation = HELP_SEARCH;
+			pages.push_back(tree.next[n].tk.valstr);
+		}
+	}
+
+	if (help_operation == HELP_LIST_FUNCTIONS){
+		if (print_long){
+			*state->out << "Functions:" << endl;
+			for (size_t f = 0 ; f < clr_base_function_count ; f++){
+				*state->out << "\t" << clr_base_functions[f].name << " - \tCompiled function" << endl;
+			}
+			for (size_t f = 0 ; f < state->library->functions.size() ; f++){
+				*state->out << "\t" << state->library->functions[f].name << " - \t";
+				if (state->library->functions[f].interpreted){
+					*state->out << "Interpreted function consistning of " << state->library->functions[f].commands.size() << " commands " << endl;
+				}else{
+					*state->out << "Compiled function" << endl;
+				}
+
+			}
+		}else{
+			*state->out << "Functions:" << endl;
+			for (size_t f = 0 ; f < clr_base_function_count ; f++){
+				*state->out << "\t" << clr_base_functions[f].name << endl;
+			}
+			for (size_t f = 0 ; f < state->library->functions.size() ; f++){
+				*state->out << "\t" << state->library->functions[f].name << endl;
+			}
+		}
+	}else if(help_operation == HELP_LIST_KEYWORDS){
+		*state->out << "Keywords:" << endl;
+		for (size_t k = 0; k < clr_keyword_count ; k++){
+			*state->out << "\t" << clr_keyword_names[k] << endl;
+		}
+	}else if(help_operation == HELP_INTRO){
+		if (!print_help_file(state->help_dir + "clr_intro_help.htx", *state->out)){
+			success = false;
+			tk.valstr = "Failed to open file '" + state->help_dir + "clr_intro_help.htx" + "'.";
+			return tk;
+		}
+	}else if(help_operation == HELP_VERBOSE){
+		if (!print_help_file(state->help_dir + "clr_verbose_help.htx", *state->out)){
+			success = false;
+			tk.valstr = "Failed to open file '" + state->help_dir + "clr_intro_help.htx" + "'.";
+			return tk;
+		}
+	}else if(help_operation == HELP_VIEW_FUNCTION){
+		for (size_t p = 0 ; p < pages.size() ; p++){
+
+			if (find_base_function(pages[p]) != NULL){
+				*state->out << "ERROR: Can not print contents of compiled functions." << endl;
+				continue;
+			}
+
+			//Scan all functions, look for the matching function
+			size_t fidx = 0; //This will hold the index
+			bool found = false;
+			for ( ; fidx < state->library->functions.size() ; fidx++){
+				if (state->library->functions[fidx].name == to_uppercase(pages[p])){ //If this is the function...
+					found = true; //Indicate that it was found
+					break; //GTFO
+				}
+			}
+
+			//Ensure function was found
+			if (!found){
+				continue; //Skip...
+			}
+
+			if (!state->library->functions[fidx].interpreted){
+				*state->out << "ERROR: Can not print contents of compiled functions." << endl;
+			}else{
+				//Print function contents
+				*state->out << "Function: " << state->library->functions[fidx].name << endl;
+				for (size_t l = 0 ; l < state->library->functions[fidx].commands.size() ; l++){
+					*state->out << "\t[" << l << "]: " << state->library->functions[fidx].commands[l] << endl;
+				}
+			}
+
+
+		}
+	}else if(help_operation == HELP_SEARCH){
+		vector<string> failed;
+		for (size_t p = 0 ; p < pages.size() ; p++){
+			if(find_keyword(pages[p]) != NULL){ //keyword
+				if (!print_help_file(state->help_dir + "clr_" + to_lowercase(pages[p]) + "_help.htx", *state->out)){
+					failed.push_back("Keyword: " + pages[p]);
+				}
+			}else if(find_base_function(pages[p]) != NULL){ //Base function
+				*state->out << find_base_function(pages[p])->helpstr << endl;
+			}else if(find_function(state, pages[p]) != NULL){ //Function
+
+				//Scan all functions, look for the matching function
+				size_t fidx = 0; //This will hold the index
+				bool found = false;
+				for ( ; fidx < state->library->functions.size() ; fidx++){
+					if (state->library->functions[fidx].name == to_uppercase(pages[p])){ //If this is the function...
+						found = true; //Indicate that it was found
+						break; //GTFO
+					}
+				}
+
+				//Ensure function was found
+				if (!found){
+					failed.push_back("Function: " + pages[p]);
+					continue; //Skip...
+				}
+
+				if (state->library->functions[fidx].helpstr.length() < 1){
+					*state->out << "RESOURCE ERROR: Page for function '" << state->library->functions[fidx].name <<  "' is blank." << endl;
+				}
+
+				*state->out << state->library->functions[fidx].helpstr << endl;
+			}else{
+				failed.push_back("Unrecognized: " + pages[p]);
+			}
+		}
+
+		if (failed.size() == 1){
+			*state->out << "RESOURCE ERROR: Failed to locate 1 page for " << failed[0] << endl;
+		}else if(failed.size() > 1){
+			*state->out << "RESOURCE ERROR: Failed to locate " <<  failed.size() << " pages:" << endl;
+			for (size_t f = 0 ; f < failed.size() ; f++){
+				*state->out << "\t" << failed[f] << endl;
+			}
+		}
+	}else{
+		success = false;
+		tk.valstr = "Failed to interpret 'help_operation'. This is a bug in clr_keywords.cpp.";
+		return tk;
+	}
+
+	return tk;
+}
+
+/*
+CD: Change directory. Not yet implemented.
+*/
+static token kw_cd(const ast& tree, clr_state* state, bool& success){
+
+	token tk;
+
+	return tk;
+}
+
+/*
+PWD: Prints the full path of the working directory.
+*/
+static token kw_pwd(const ast& tree, clr_state* state, bool& success){
+
+	token tk;
+
+	char buf[PATH_MAX];
+	if (getcwd(buf, sizeof(buf)) == NULL){
+		success = false;
+		tk.valstr = "Failed to read the working directory.";
+		return tk;
+	}
+	*state->out << buf << endl;
+
+	return tk;
+}
+
+/*
+LS: Lists the contents of the working directory in alphabetical order, one per
+line. Hidden files are skipped and directories end in '/'.
+*/
+static token kw_ls(const ast& tree, clr_state* state, bool& success){
+
+	token tk;
+
+	DIR* dir = opendir(".");
+	if (dir == NULL){
+		success = false;
+		tk.valstr = "Failed to open the working directory.";
+		return tk;
+	}
+	vector<string> names;
+	for (struct dirent* ent = readdir(dir) ; ent != NULL ; ent = readdir(dir)){
+		if (ent->d_name[0] == '.') continue;
+		struct stat st;
+		bool is_dir = (stat(ent->d_name, &st) == 0 && S_ISDIR(st.st_mode));
+		names.push_back(string(ent->d_name) + (is_dir ? "/" : ""));
+	}
+	closedir(dir);
+	sort(names.begin(), names.end());
+	for (size_t n = 0 ; n < names.size() ; n++) *state->out << names[n] << endl;
+
+	return tk;
+}
+
+/*
+EXIT: Exit the program.
+*/
+static token kw_exit(const ast& tree, clr_state* state, bool& success){
+
+	token tk;
+
+	state->running = false;
+
+	return tk;
+}
+
+/*
+RUN: Run a script. Each line of the file is run as if it had been typed, in the
+same state, stopping at the first line that fails. Scripts may RUN other scripts.
+*/
+static token kw_run(const ast& tree, clr_state* state, bool& success){
+
+	token tk;
+
+	if (tree.next.size() != 1 || tree.next[0].tk.type != "str"){
+		success = false;
+		tk.valstr = "RUN requires the path of a script.";
+		return tk;
+	}
+	string path = tree.next[0].tk.valstr;
+
+	ifstream in(path.c_str());
+	if (!in.is_open()){
+		success = false;
+		tk.valstr = "Failed to open script '" + path + "'.";
+		return tk;
+	}
+
+	if (state->call_depth >= CLR_MAX_CALL_DEPTH){
+		success = false;
+		tk.valstr = "Exceeded the maximum of " + to_string(CLR_MAX_CALL_DEPTH) + " nested calls in script '" + path + "'. Does it run itself?";
+		return tk;
+	}
+
+	string line, print_out;
+	size_t lnum = 0;
+	state->call_depth++;
+	while (state->running && getline(in, line)){
+		lnum++;
+		if (!interpret_clr(line, state, print_out)){
+			state->call_depth--;
+			success = false;
+			tk.valstr = "Failed on line " + to_string(lnum) + " of script '" + path + "'.\n" + print_out;
+			return tk;
+		}
+		*state->out << print_out;
+	}
+	state->call_depth--;
+
+	return tk;
+}
+
+/*
+DELETE: Delete a variable. Not yet implemented.
+*/
+static token kw_delete(const ast& tree, clr_state* state, bool& success){
+
+	token tk;
+
+	return tk;
+}
+
+/*
+DEVMODE: Enter or exit developer mode.
+*/
+static token kw_devmode(const ast& tree, clr_state* state, bool& success){
+
+	token tk;
+
+	state->developer_mode = !state->developer_mode;
+	*state->out << "Developer mode: ";
+	if (state->developer_mode){
+		*state->out << "ON" << endl;
+	}else{
+		*state->out << "OFF" << endl;
+	}
+
+	return tk;
+}
+
+/*
+LOAD: Load columns of a CSV (or similar) file into array variables.
+*/
+static token kw_load(const ast& tree, clr_state* state, bool& success){
+
+	token tk;
+
+	//First argument is the file, any others name the columns
+	if (tree.next.size() < 1 || tree.next[0].tk.type != "str"){
+		success = false;
+		tk.valstr = "LOAD requires the path of the file to load, optionally followed by a variable name for each column.";
+		return tk;
+	}
+	vector<string> names;
+	for (size_t n = 1 ; n < tree.next.size() ; n++){
+		if (!is_valid_name(tree.next[n].tk.valstr)){
+			success = false;
+			tk.valstr = "'" + tree.next[n].tk.valstr + "' is not a valid variable name.";
+			return tk;
+		}
+		if (reserved_name(tree.next[n].tk.valstr, tk.valstr)){
+			success = false;
+			return tk;
+		}
+		names.push_back(tree.next[n].tk.valstr);
+	}
+
+	string err;
+	if (!load_delimited(tree.next[0].tk.valstr, names, state, err)){
+		success = false;
+		tk.valstr = err;
+		return tk;
+	}
+
+	return tk;
+}
+
+/*
+SAVE: Save an array variable to a binary array file.
+*/
+static token kw_save(const ast& tree, clr_state* state, bool& success){
+
+	token tk;
+
+	//Ensure a variable and file follow...
+	if (tree.next.size() != 2){
+		success = false;
+		tk.valstr = "SAVE requires exactly two arguments, the variable to save and the file to save it to.";
+		return tk;
+	}
+
+	size_t vidx = variable_index(state, tree.next[0].tk.valstr);
+	if (vidx == (size_t)-1){
+		success = false;
+		tk.valstr = "Variable '" + tree.next[0].tk.valstr + "' does not exist.";
+		return tk;
+	}else if ((*state->variables)[vidx].type != "arr"){
+		success = false;
+		tk.valstr = "Variable '" + tree.next[0].tk.valstr + "' is not an array. Only arrays can be saved.";
+		return tk;
+	}
+
+	string err;
+	if (!save_array_binary(tree.next[1].tk.valstr, *(*state->variables)[vidx].valarr, err)){
+		success = false;
+		tk.valstr = err;
+		return tk;
+	}
+
+	return tk;
+}
+
+/*
+LOADB: Load a binary array file into a variable.
+*/
+static token kw_loadb(const ast& tree, clr_state* state, bool& success){
+
+	token tk;
+
+	//Ensure a variable and file follow...
+	if (tree.next.size() != 2){
+		success = false;
+		tk.valstr = "LOADB requires exactly two arguments, the variable to load into and the file to load.";
+		return tk;
+	}
+	if (!is_valid_name(tree.next[0].tk.valstr)){
+		success = false;
+		tk.valstr = "'" + tree.next[0].tk.valstr + "' is not a valid variable name.";
+		return tk;
+	}
+	if (reserved_name(tree.next[0].tk.valstr, tk.valstr)){
+		success = false;
+		return tk;
+	}
+
+	string err;
+	std::shared_ptr<const clr_array> arr;
+	if (!load_array_binary(tree.next[1].tk.valstr, arr, err)){
+		success = false;
+		tk.valstr = err;
+		return tk;
+	}
+	store_array(state, tree.next[0].tk.valstr, arr);
+
+	return tk;
+}
+
+/*
+ADDFN: Load base functions from a native plugin.
+*/
+static token kw_addfn(const ast& tree, clr_state* state, bool& success){
+
+	token tk;
+
+	//Ensure exactly one path follows...
+	if (tree.next.size() != 1 || tree.next[0].tk.type != "str"){
+		success = false;
+		tk.valstr = "ADDFN requires exactly one argument, the path to a plugin library.";
+		return tk;
+	}
+
+	string err;
+	if (!load_plugin(tree.next[0].tk.valstr, state, err)){
+		success = false;
+		tk.valstr = err;
+		return tk;
+	}
+	compile_functions(state); //New names may change how commands parse
+
+	return tk;
+}
+
+/*
+MEMSTAT: Print heap allocation counters (requires building with CLR_ALLOC_STATS).
+*/
+static token kw_memstat(const ast& tree, clr_state* state, bool& success){
+
+	token tk;
+
+	if (!alloc_stats_enabled()){
+		*state->out << "Allocation accounting is disabled. Rebuild CLR with -DCLR_ALLOC_STATS to enable it." << endl;
+		return tk;
+	}
+
+	clr_alloc_stats s = alloc_stats();
+	*state->out << "Heap allocations:" << endl;
+	*state->out << "\tAllocations: " << s.allocs << endl;
+	*state->out << "\tFrees: " << s.frees << endl;
+	*state->out << "\tBytes allocated: " << s.bytes_allocated << endl;
+	*state->out << "\tBytes in use: " << s.bytes_live << " (peak " << s.bytes_peak << ")" << endl;
+	*state->out << "\tAllocations by previous line: " << s.line_allocs << endl;
+
+	return tk;
+}
+
+/*
+DEF: Bind a variable to a formula, eg. "DEF area r;r*pi*". The formula is
+recomputed when the variable is read after any of its inputs change.
+*/
+static token kw_def(const ast& tree, clr_state* state, bool& success){
+
+	token tk;
+
+	//Ensure a variable name and formula follow...
+	if (tree.next.size() >= 1 && reserved_name(tree.next[0].tk.valstr, tk.valstr)){
+		success = false;
+		return tk;
+	}
+	if (tree.next.size() < 2 || tree.next[0].tk.type != "var"){
+		success = false;
+		tk.valstr = "DEF requires a variable name followed by a formula (eg. DEF area r;r*pi*).";
+		return tk;
+	}
+
+	vector<token> formula;
+	for (size_t n = 1 ; n < tree.next.size() ; n++){
+		formula.push_back(tree.next[n].tk);
+	}
+
+	if (!define_formula(state, tree.next[0].tk.valstr, formula, tk.valstr)){
+		success = false;
+		return tk;
+	}
+
+	return tk;
+}
+
+/*
+Replaces {x} with a reduction of it, or of {y} and {x} for DOT, which also drops
+the stack like a binary operator.
+*/
+static token reduce_registers(reduce_op op, clr_state* state, bool& success){
+
+	token tk;
+
+	comp result;
+	if (!reduce_value(op, state->x, state->y, result, tk.valstr)){
+		success = false;
+		return tk;
+	}
+
+	state->x = result;
+	if (op == REDUCE_DOT){
+		state->y = state->z;
+		state->z = state->t;
+		state->t = cart(0, 0);
+	}
+
+	return tk;
+}
+
+/*
+SUM: Replace {x} with the sum of its values.
+*/
+static token kw_sum(const ast& tree, clr_state* state, bool& success){
+	return reduce_registers(REDUCE_SUM, state, success);
+}
+
+/*
+MEAN: Replace {x} with the mean of its values.
+*/
+static token kw_mean(const ast& tree, clr_state* state, bool& success){
+	return reduce_registers(REDUCE_MEAN, state, success);
+}
+
+/*
+MIN: Replace {x} with its value with the smallest real part.
+*/
+static token kw_min(const ast& tree, clr_state* state, bool& success){
+	return reduce_registers(REDUCE_MIN, state, success);
+}
+
+/*
+MAX: Replace {x} with its value with the largest real part.
+*/
+static token kw_max(const ast& tree, clr_state* state, bool& success){
+	return reduce_registers(REDUCE_MAX, state, success);
+}
+
+/*
+NORM: Replace {x} with its Euclidean norm.
+*/
+static token kw_norm(const ast& tree, clr_state* state, bool& success){
+	return reduce_registers(REDUCE_NORM, state, success);
+}
+
+/*
+DOT: Replace {y} and {x} with the dot product of {y} and {x} (no conjugation).
+*/
+static token kw_dot(const ast& tree, clr_state* state, bool& success){
+	return reduce_registers(REDUCE_DOT, state, success);
+}
+
+/*
+PROFILE: Profile interpreted functions. "PROFILE ON" starts a new profile,
+"PROFILE OFF" stops it and "PROFILE REPORT" prints it. "PROFILE REPORT file" also
+writes the call stacks to 'file' for flame graph tools.
+*/
+static token kw_profile(const ast& tree, clr_state* state, bool& success){
+
+	token tk;
+
+	if (tree.next.size() < 1){
+		success = false;
+		tk.valstr = "PROFILE requires ON, OFF or REPORT.";
+		return tk;
+	}
+
+	const string& op = tree.next[0].tk.valstr;
+	if (name_equals(op, "ON")){
+		state->profile.reset(new clr_profile());
+		state->profile->enabled = true;
+	}else if (name_equals(op, "OFF")){
+		if (state->profile) state->profile->enabled = false;
+	}else if (name_equals(op, "REPORT")){
+		if (!state->profile){
+			success = false;
+			tk.valstr = "Nothing has been profiled. Use PROFILE ON first.";
+			return tk;
+		}
+		profile_report(state->profile.get(), state->library.get(), *state->out);
+		if (tree.next.size() > 1){
+			if (!profile_write_stacks(state->profile.get(), tree.next[1].tk.valstr, tk.valstr)){
+				success = false;
+				return tk;
+			}
+			*state->out << "Wrote call stacks to '" << tree.next[1].tk.valstr << "'." << endl;
+		}
+	}else{
+		success = false;
+		tk.valstr = "Unrecognized PROFILE option '" + op + "'. Use ON, OFF or REPORT.";
+		return tk;
+	}
+
+	return tk;
+}
+
+/*
+MAT: Make {x} a matrix with the given number of columns, eg. "MAT 3". The array's
+values fill the matrix row by row. "MAT 0" makes it a plain array again.
+*/
+static token kw_mat(const ast& tree, clr_state* state, bool& success){
+
+	token tk;
+
+	if (tree.next.size() != 1 || tree.next[0].tk.type != "num" || tree.next[0].tk.valnum.real() < 0){
+		success = false;
+		tk.valstr = "MAT requires exactly one argument, the number of columns.";
+		return tk;
+	}
+
+	clr_value out;
+	if (!matrix_reshape(state->x, (size_t)tree.next[0].tk.valnum.real(), out, tk.valstr)){
+		success = false;
+		return tk;
+	}
+	state->x = out;
+
+	return tk;
+}
+
+/*
+TRN: Transpose {x}.
+*/
+static token kw_trn(const ast& tree, clr_state* state, bool& success){
+
+	token tk;
+
+	clr_value out;
+	if (!matrix_transpose(state->x, out, tk.valstr)){
+		success = false;
+		return tk;
+	}
+	state->x = out;
+
+	return tk;
+}
+
+/*
+MMUL: Replace {y} and {x} with the matrix product {y}*{x}.
+*/
+static token kw_mmul(const ast& tree, clr_state* state, bool& success){
+
+	token tk;
+
+	clr_value out;
+	if (!matrix_multiply(state->y, state->x, out, tk.valstr)){
+		success = false;
+		return tk;
+	}
+	state->x = out;
+	state->y = state->z;
+	state->z = state->t;
+	state->t = cart(0, 0);
+
+	return tk;
+}
+
+/*
+SOLVE: Replace {y} (a square matrix A) and {x} (b) with the solution of A*x = b.
+*/
+static token kw_solve(const ast& tree, clr_state* state, bool& success){
+
+	token tk;
+
+	clr_value out;
+	if (!matrix_solve(state->y, state->x, out, tk.valstr)){
+		success = false;
+		return tk;
+	}
+	state->x = out;
+	state->y = state->z;
+	state->z = state->t;
+	state->t = cart(0, 0);
+
+	return tk;
+}
+
+/*
+INV: Replace the square matrix in {x} with its inverse.
+*/
+static token kw_inv(const ast& tree, clr_state* state, bool& success){
+
+	token tk;
+
+	clr_value out;
+	if (!matrix_inverse(state->x, out, tk.valstr)){
+		success = false;
+		return tk;
+	}
+	state->x = out;
+
+	return tk;
+}
+
+/*
+DET: Replace the square matrix in {x} with its determinant.
+*/
+static token kw_det(const ast& tree, clr_state* state, bool& success){
+
+	token tk;
+
+	comp out;
+	if (!matrix_determinant(state->x, out, tk.valstr)){
+		success = false;
+		return tk;
+	}
+	state->x = out;
+
+	return tk;
+}
+
+/*
+FFT: Replace {x} with its discrete Fourier transform (of each row, for a matrix).
+*/
+static token kw_fft(const ast& tree, clr_state* state, bool& success){
+
+	token tk;
+
+	clr_value out;
+	if (!fft_value(state->x, false, out, tk.valstr)){
+		success = false;
+		return tk;
+	}
+	state->x = out;
+
+	return tk;
+}
+
+/*
+IFFT: Replace {x} with its inverse discrete Fourier transform, scaled by 1/n.
+*/
+static token kw_ifft(const ast& tree, clr_state* state, bool& success){
+
+	token tk;
+
+	clr_value out;
+	if (!fft_value(state->x, true, out, tk.valstr)){
+		success = false;
+		return tk;
+	}
+	state->x = out;
+
+	return tk;
+}
+
+/*
+Reads options of the form '-name n' from tree.next[first] onwards. Each name in
+'names' (upper case, matched in any case) sets the value at the same index of
+'values' (which holds the defaults).
+Returns false and describes the problem in 'err' if an option isn't in 'names'
+or isn't followed by a number of at least 1.
+*/
+static bool read_options(const ast& tree, size_t first, const vector<string>& names, vector<double>& values, string& err){
+
+	for (size_t n = first ; n < tree.next.size() ; n++){
+		const token& opt = tree.next[n].tk;
+		size_t idx = 0;
+		while (idx < names.size() && !name_equals(opt.valstr, names[idx].c_str())) idx++;
+		if (opt.type != "flag" || idx == names.size()){
+			err = "Unrecognized option '" + opt.valstr + "'.";
+			return false;
+		}
+		if (n+1 >= tree.next.size() || tree.next[n+1].tk.type != "num" || tree.next[n+1].tk.valnum.real() < 1){
+			err = "Option '" + opt.valstr + "' must be followed by a number of at least 1.";
+			return false;
+		}
+		n++;
+		values[idx] = tree.next[n].tk.valnum.real();
+	}
+
+	return true;
+}
+
+/*
+ROOT: Replace {x} with a zero of a function near {x}. {y}, {z} and {t} are passed
+to the function on every call. Options:
+	-digits n	Correct digits wanted (default CLR_ROOT_DIGITS)
+	-evals n	Max function evaluations (default CLR_ROOT_MAX_EVALS)
+*/
+static token kw_root(const ast& tree, clr_state* state, bool& success){
+
+	token tk;
+
+	if (tree.next.size() < 1 || tree.next[0].tk.type != "func"){
+		success = false;
+		tk.valstr = "ROOT requires the name of a function, optionally followed by -digits n and -evals n.";
+		return tk;
+	}
+
+	vector<string> names = {"-DIGITS", "-EVALS"};
+	vector<double> values = {CLR_ROOT_DIGITS, CLR_ROOT_MAX_EVALS};
+	if (!read_options(tree, 1, names, values, tk.valstr)){
+		success = false;
+		tk.valstr = tk.valstr + " ROOT accepts -digits n and -evals n.";
+		return tk;
+	}
+	double digits = values[0];
+	size_t max_evals = (size_t)values[1];
+	if (state->x.arr){
+		success = false;
+		tk.valstr = "ROOT requires a number in {x} to start from.";
+		return tk;
+	}
+
+	clr_callable f;
+	if (!make_callable(state, tree.next[0].tk.valstr, f, tk.valstr)){
+		success = false;
+		return tk;
+	}
+
+	//Evaluate in a fork so the function can't change this state's registers or variables
+	clr_state work = fork_state(state);
+	comp root;
+	if (!find_root(f, &work, state->x.num, pow(10.0, -digits), max_evals, root, tk.valstr)){
+		success = false;
+		return tk;
+	}
+	state->x = root;
+
+	return tk;
+}
+
+/*
+INTEG: Replace {y} and {x} with the integral of a function from {y} to {x}. {z}
+and {t} are passed to the function on every call (as its {y} and {z}). Options:
+	-digits n	Correct digits wanted (default CLR_INTEG_DIGITS)
+	-intervals n	Max subintervals (default CLR_INTEG_MAX_INTERVALS)
+*/
+static token kw_integ(const ast& tree, clr_state* state, bool& success){
+
+	token tk;
+
+	if (tree.next.size() < 1 || tree.next[0].tk.type != "func"){
+		success = false;
+		tk.valstr = "INTEG requires the name of a function, optionally followed by -digits n and -intervals n.";
+		return tk;
+	}
+
+	vector<string> names = {"-DIGITS", "-INTERVALS"};
+	vector<double> values = {CLR_INTEG_DIGITS, CLR_INTEG_MAX_INTERVALS};
+	if (!read_options(tree, 1, names, values, tk.valstr)){
+		success = false;
+		tk.valstr = tk.valstr + " INTEG accepts -digits n and -intervals n.";
+		return tk;
+	}
+	if (state->x.arr || state->y.arr){
+		success = false;
+		tk.valstr = "INTEG requires numbers in {y} and {x} as the limits.";
+		return tk;
+	}
+
+	//The function sees the stack above the limits
+	clr_state work = fork_state(state);
+	work.y = state->z;
+	work.z = state->t;
+	work.t = cart(0, 0);
+	clr_callable f;
+	if (!make_callable(&work, tree.next[0].tk.valstr, f, tk.valstr)){
+		success = false;
+		return tk;
+	}
+
+	comp out;
+	if (!integrate(f, &work, state->y.num, state->x.num, pow(10.0, -values[0]), (size_t)values[1], out, tk.valstr)){
+		success = false;
+		return tk;
+	}
+	state->x = out;
+	state->y = state->z;
+	state->z = state->t;
+	state->t = cart(0, 0);
+
+	return tk;
+}
+
+/*
+Pushes 'val' onto the stack: {x} moves up to {y} and so on, and {t} is lost.
+*/
+static void push_value(clr_state* state, const clr_value& val){
+	state->t = state->z;
+	state->z = state->y;
+	state->y = state->x;
+	state->x = val;
+}
+
+/*
+Pushes a random number, or with '-n count' an array of that many, onto the
+stack. Used by RAND and RANDN.
+*/
+static token random_keyword(const ast& tree, clr_state* state, bool normal, bool& success){
+
+	token tk;
+	string name = normal ? "RANDN" : "RAND";
+
+	vector<string> names = {"-N"};
+	vector<double> values = {0};
+	if (!read_options(tree, 0, names, values, tk.valstr)){
+		success = false;
+		tk.valstr = tk.valstr + " " + name + " accepts -n count.";
+		return tk;
+	}
+
+	clr_value val;
+	if (values[0] == 0){
+		val = comp(normal ? rng_normal(&state->rng, state->rng.counter) : rng_uniform(&state->rng, state->rng.counter), 0);
+		state->rng.counter++;
+	}else{
+		std::shared_ptr<clr_array> arr = new_array((size_t)values[0]);
+		rng_fill(&state->rng, normal, arr->data, arr->length);
+		val = clr_value(std::shared_ptr<const clr_array>(arr));
+	}
+
+	push_value(state, val);
+
+	return tk;
+}
+
+/*
+RAND: Push a random number, uniform on [0, 1), onto the stack. Options:
+	-n count	Push an array of 'count' random numbers instead
+*/
+static token kw_rand(const ast& tree, clr_state* state, bool& success){
+	return random_keyword(tree, state, false, success);
+}
+
+/*
+RANDN: Push a normally distributed random number (mean 0, variance 1) onto the
+stack. Options:
+	-n count	Push an array of 'count' random numbers instead
+*/
+static token kw_randn(const ast& tree, clr_state* state, bool& success){
+	return random_keyword(tree, state, true, success);
+}
+
+/*
+SEED: Seed the random numbers with {x} (a whole number of at least 0). The same
+seed always gives the same numbers from RAND, RANDN and MC.
+*/
+static token kw_seed(const ast& tree, clr_state* state, bool& success){
+
+	token tk;
+
+	double seed = state->x.num.real();
+	if (state->x.arr || state->x.num.imag() != 0 || seed < 0 || seed != floor(seed) || seed >= 18446744073709551616.0){
+		success = false;
+		tk.valstr = "SEED requires a whole number of at least 0 in {x}.";
+		return tk;
+	}
+	state->rng.seed = (uint64_t)seed;
+	state->rng.stream = 0;
+	state->rng.counter = 0;
+
+	return tk;
+}
+
+/*
+MC: Monte Carlo. Run a function on many samples and replace {x} with the mean of
+its results and {y} with the standard error of the mean. Sample i is called with
+{x} = i and its own stream of random numbers (see monte_carlo), and {y}, {z} and
+{t} are passed to the function on every call. The number of samples, mean,
+standard deviation, standard error, min and max are printed. Options:
+	-n count	Number of samples (default CLR_MC_SAMPLES)
+*/
+static token kw_mc(const ast& tree, clr_state* state, bool& success){
+
+	token tk;
+
+	if (tree.next.size() < 1 || tree.next[0].tk.type != "func"){
+		success = false;
+		tk.valstr = "MC requires the name of a function, optionally followed by -n count.";
+		return tk;
+	}
+
+	vector<string> names = {"-N"};
+	vector<double> values = {CLR_MC_SAMPLES};
+	if (!read_options(tree, 1, names, values, tk.valstr)){
+		success = false;
+		tk.valstr = tk.valstr + " MC accepts -n count.";
+		return tk;
+	}
+
+	clr_callable f;
+	if (!make_callable(state, tree.next[0].tk.valstr, f, tk.valstr)){
+		success = false;
+		return tk;
+	}
+
+	clr_welford stats;
+	if (!monte_carlo(f, state, (size_t)values[0], stats, tk.valstr)){
+		success = false;
+		return tk;
+	}
+	double sd = sqrt(welford_variance(stats));
+	double se = sd/sqrt((double)stats.n);
+
+	*state->out << "Samples: " << stats.n << ", mean " << dtos(stats.mean, 8, 3) << ", std dev " << dtos(sd, 6, 3);
+	*state->out << ", std error " << dtos(se, 4, 3) << ", min " << dtos(stats.min, 6, 3) << ", max " << dtos(stats.max, 6, 3) << endl;
+	state->x = cart(stats.mean, 0);
+	state->y = cart(se, 0);
+
+	return tk;
+}
+
+/*
+Adds {x} to the statistics registers, or takes it out if 'remove'. With the flag
+-xy, ({x}, {y}) is also added as a pair. Used by S+ and S-.
+*/
+static token sigma_keyword(const ast& tree, clr_state* state, bool remove, bool& success){
+
+	token tk;
+	string name = remove ? "S-" : "S+";
+
+	bool pairs = false;
+	if (tree.next.size() == 1 && tree.next[0].tk.type == "flag" && name_equals(tree.next[0].tk.valstr, "-XY")){
+		pairs = true;
+	}else if (tree.next.size() != 0){
+		success = false;
+		tk.valstr = name + " accepts only the flag -xy.";
+		return tk;
+	}
+
+	if (!sigma_update(state->sigma, state->x, pairs ? &state->y : NULL, remove, tk.valstr)){
+		success = false;
+		return tk;
+	}
+
+	return tk;
+}
+
+/*
+S+: Add {x} (every value if it's an array) to the statistics registers. Flags:
+	-xy		Also add ({x}, {y}) as a pair (or each pair of values of two arrays),
+			for SCOV, SCORR and LR
+*/
+static token kw_splus(const ast& tree, clr_state* state, bool& success){
+	return sigma_keyword(tree, state, false, success);
+}
+
+/*
+S-: Take {x} back out of the statistics registers (eg. to correct a mistake).
+SMIN and SMAX still include it. Flags:
+	-xy		Also take out the pair ({x}, {y})
+*/
+static token kw_sminus(const ast& tree, clr_state* state, bool& success){
+	return sigma_keyword(tree, state, true, success);
+}
+
+/*
+SCLR: Clear the statistics registers.
+*/
+static token kw_sclr(const ast& tree, clr_state* state, bool& success){
+
+	token tk;
+
+	sigma_reset(state->sigma);
+
+	return tk;
+}
+
+/*
+Returns true if the statistics registers hold at least 'min_n' values (or pairs
+if 'pairs'), and otherwise describes the problem in 'err'.
+*/
+static bool sigma_has(const clr_state* state, size_t min_n, bool pairs, const string& name, string& err){
+	size_t n = pairs ? state->sigma.xy.x.n : state->sigma.x.n;
+	if (n >= min_n) return true;
+	err = name + " requires at least " + to_string(min_n) + (pairs ? " pairs entered with S+ -xy" : " values entered with S+") + " (there are " + to_string(n) + ").";
+	return false;
+}
+
+/*
+SN: Push the number of values in the statistics registers.
+*/
+static token kw_sn(const ast& tree, clr_state* state, bool& success){
+
+	token tk;
+
+	push_value(state, cart((double)state->sigma.x.n, 0));
+
+	return tk;
+}
+
+/*
+SMEAN: Push the mean of the values in the statistics registers.
+*/
+static token kw_smean(const ast& tree, clr_state* state, bool& success){
+
+	token tk;
+
+	if (!sigma_has(state, 1, false, "SMEAN", tk.valstr)){
+		success = false;
+		return tk;
+	}
+	push_value(state, cart(state->sigma.x.mean, 0));
+
+	return tk;
+}
+
+/*
+SVAR: Push the sample variance of the values in the statistics registers.
+*/
+static token kw_svar(const ast& tree, clr_state* state, bool& success){
+
+	token tk;
+
+	if (!sigma_has(state, 2, false, "SVAR", tk.valstr)){
+		success = false;
+		return tk;
+	}
+	push_value(state, cart(welford_variance(state->sigma.x), 0));
+
+	return tk;
+}
+
+/*
+SSDEV: Push the sample standard deviation of the values in the statistics
+registers.
+*/
+static token kw_ssdev(const ast& tree, clr_state* state, bool& success){
+
+	token tk;
+
+	if (!sigma_has(state, 2, false, "SSDEV", tk.valstr)){
+		success = false;
+		return tk;
+	}
+	push_value(state, cart(sqrt(welford_variance(state->sigma.x)), 0));
+
+	return tk;
+}
+
+/*
+SMIN: Push the smallest value entered into the statistics registers.
+*/
+static token kw_smin(const ast& tree, clr_state* state, bool& success){
+
+	token tk;
+
+	if (!sigma_has(state, 1, false, "SMIN", tk.valstr)){
+		success = false;
+		return tk;
+	}
+	push_value(state, cart(state->sigma.x.min, 0));
+
+	return tk;
+}
+
+/*
+SMAX: Push the largest value entered into the statistics registers.
+*/
+static token kw_smax(const ast& tree, clr_state* state, bool& success){
+
+	token tk;
+
+	if (!sigma_has(state, 1, false, "SMAX", tk.valstr)){
+		success = false;
+		return tk;
+	}
+	push_value(state, cart(state->sigma.x.max, 0));
+
+	return tk;
+}
+
+/*
+SCOV: Push the sample covariance of the pairs in the statistics registers.
+*/
+static token kw_scov(const ast& tree, clr_state* state, bool& success){
+
+	token tk;
+
+	if (!sigma_has(state, 2, true, "SCOV", tk.valstr)){
+		success = false;
+		return tk;
+	}
+	push_value(state, cart(covariance_value(state->sigma.xy), 0));
+
+	return tk;
+}
+
+/*
+SCORR: Push the correlation coefficient of the pairs in the statistics
+registers.
+*/
+static token kw_scorr(const ast& tree, clr_state* state, bool& success){
+
+	token tk;
+
+	const clr_covariance& c = state->sigma.xy;
+	if (!sigma_has(state, 2, true, "SCORR", tk.valstr)){
+		success = false;
+		return tk;
+	}
+	if (c.x.m2 == 0 || c.y.m2 == 0){
+		success = false;
+		tk.valstr = "SCORR is undefined when all the x or all the y values are equal.";
+		return tk;
+	}
+	push_value(state, cart(c.cxy/sqrt(c.x.m2*c.y.m2), 0));
+
+	return tk;
+}
+
+/*
+LR: Linear regression. Fits y = a + b*x to the pairs in the statistics registers
+by least squares and pushes the intercept 'a' then the slope 'b' (so {x} holds
+the slope and {y} the intercept).
+*/
+static token kw_lr(const ast& tree, clr_state* state, bool& success){
+
+	token tk;
+
+	const clr_covariance& c = state->sigma.xy;
+	if (!sigma_has(state, 2, true, "LR", tk.valstr)){
+		success = false;
+		return tk;
+	}
+	if (c.x.m2 == 0){
+		success = false;
+		tk.valstr = "LR is undefined when all the x values are equal.";
+		return tk;
+	}
+	double slope = c.cxy/c.x.m2;
+	push_value(state, cart(c.y.mean - slope*c.x.mean, 0));
+	push_value(state, cart(slope, 0));
+
+	return tk;
+}
+
+//****************************************************************************
+// DISPATCH
+
+/*
+Every CLR keyword and the function which executes it. To add a keyword, write its
+handler above and add it here. Names must be uppercase.
+*/
+#define CLR_KEYWORD_TABLE(X) \
+	X("FLP", kw_flp) \
+	X("LSTX", kw_lstx) \
+	X("DN", kw_dn) \
+	X("UP", kw_up) \
+	X("STK", kw_stk) \
+	X("STO", kw_sto) \
+	X("RCL", kw_rcl) \
+	X("CLX", kw_clx) \
+	X("CLREG", kw_clreg) \
+	X("LSVAR", kw_lsvar) \
+	X("CLVAR", kw_clvar) \
+	X("CLEAR", kw_clear) \
+	X("HELP", kw_help) \
+	X("CD", kw_cd) \
+	X("PWD", kw_pwd) \
+	X("LS", kw_ls) \
+	X("EXIT", kw_exit) \
+	X("RUN", kw_run) \
+	X("DELETE", kw_delete) \
+	X("ADDFN", kw_addfn) \
+	X("DEVMODE", kw_devmode) \
+	X("LOAD", kw_load) \
+	X("SAVE", kw_save) \
+	X("LOADB", kw_loadb) \
+	X("MEMSTAT", kw_memstat) \
+	X("DEF", kw_def) \
+	X("SUM", kw_sum) \
+	X("MEAN", kw_mean) \
+	X("MIN", kw_min) \
+	X("MAX", kw_max) \
+	X("NORM", kw_norm) \
+	X("DOT", kw_dot) \
+	X("PROFILE", kw_profile) \
+	X("MAT", kw_mat) \
+	X("TRN", kw_trn) \
+	X("MMUL", kw_mmul) \
+	X("SOLVE", kw_solve) \
+	X("INV", kw_inv) \
+	X("DET", kw_det) \
+	X("FFT", kw_fft) \
+	X("IFFT", kw_ifft) \
+	X("ROOT", kw_root) \
+	X("INTEG", kw_integ) \
+	X("RAND", kw_rand) \
+	X("RANDN", kw_randn) \
+	X("SEED", kw_seed) \
+	X("MC", kw_mc) \
+	X("S+", kw_splus) \
+	X("S-", kw_sminus) \
+	X("SCLR", kw_sclr) \
+	X("SN", kw_sn) \
+	X("SMEAN", kw_smean) \
+	X("SVAR", kw_svar) \
+	X("SSDEV", kw_ssdev) \
+	X("SMIN", kw_smin) \
+	X("SMAX", kw_smax) \
+	X("SCOV", kw_scov) \
+	X("SCORR", kw_scorr) \
+	X("LR", kw_lr)
+
+//Every keyword's name, in the order of CLR_KEYWORD_TABLE
+#define CLR_KEYWORD_NAME(name, fn) name,
+const char* const clr_keyword_names[] = { CLR_KEYWORD_TABLE(CLR_KEYWORD_NAME) };
+#undef CLR_KEYWORD_NAME
+
+const size_t clr_keyword_count = sizeof(clr_keyword_names)/sizeof(clr_keyword_names[0]);
+
+/*
+Returns the handler for the keyword 'word' (case insensitive), or NULL if 'word'
+is not a keyword. The switch is generated from CLR_KEYWORD_TABLE and its labels
+are hashes computed at compile time, so two keywords with the same hash fail to
+compile (ie. the hash is perfect over the keywords). A matching hash is confirmed
+by comparing names, which does not allocate.
+*/
+clr_keyword_fn find_keyword(const std::string& word){
+
+	#define CLR_KEYWORD_CASE(name, fn) case name_hash(name): return name_equals(word, name) ? fn : NULL;
+	switch (name_hash(word.c_str())){
+		CLR_KEYWORD_TABLE(CLR_KEYWORD_CASE)
+		default: return NULL;
+	}
+	#undef CLR_KEYWORD_CASE
+}
+
+/*
+Returns true if 'name' is reserved, and describes why in 'err'. Keywords are
+recognized before variables and functions, so a variable or function named after
+one could never be used. Checked wherever a name is defined (eg. STO, DEF, ADDFN)
+so the clash is reported then rather than when the name is used.
+*/
+bool reserved_name(const std::string& name, std::string& err){
+	if (find_keyword(name) == NULL) return false;
+	err = "The name '" + name + "' is reserved (it is a keyword) and can't be used for a variable or function.";
+	return true;
+}
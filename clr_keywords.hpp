@@ -0,0 +1,43 @@
+/*
+This file declares CLR's keywords. Every keyword is listed once, with the function
+which executes it, in the keyword table in clr_keywords.cpp. The dispatcher and the
+list of keywords are both generated from that table.
+
+Created by Grant Giesbrecht on 19.10.2026
+
+*/
+
+#include <string>
+#include <stdint.h>
+#include "clr_types.hpp"
+
+#ifndef CLR_KEYWORDS_HPP
+#define CLR_KEYWORDS_HPP
+
+//Executes a keyword. 'tree' holds the keyword and its arguments
+typedef token (*clr_keyword_fn)(const ast& tree, clr_state* state, bool& success);
+
+//Converts a character to uppercase (usable at compile time)
+constexpr char name_upper(char c){
+	return (c >= 'a' && c <= 'z') ? (char)(c - 'a' + 'A') : c;
+}
+
+//Case-insensitive FNV-1a hash of a name (usable at compile time, eg. as a case label)
+constexpr uint32_t name_hash(const char* s, uint32_t h = 2166136261u){
+	return (*s == 0) ? h : name_hash(s + 1, (h ^ (uint32_t)(unsigned char)name_upper(*s)) * 16777619u);
+}
+
+//Returns true if 'word' equals 'name' ignoring case ('name' must be uppercase)
+bool name_equals(const std::string& word, const char* name);
+
+//Every keyword's name, uppercase
+extern const char* const clr_keyword_names[];
+extern const size_t clr_keyword_count;
+
+//Returns the function which executes a keyword, or NULL if 'word' is not a keyword
+clr_keyword_fn find_keyword(const std::string& word);
+
+//Returns true if 'name' is a keyword, so it can't name a variable or function, and describes why in 'err'
+bool reserved_name(const std::string& name, std::string& err);
+
+#endif
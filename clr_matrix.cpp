@@ -0,0 +1,524 @@
+#include "clr_matrix.hpp"
+#include "clr_arrays.hpp"
+#include "clr_parallel.hpp"
+#include <vector>
+#include <algorithm>
+#include <cmath>
+
+using namespace std;
+
+/*
+The kernels below work on matrices of 'comp' as interleaved doubles (real, imag)
+and write complex products out in real arithmetic. std::complex's operator* checks
+for infinities and NaNs with a library call, which would keep the loops from
+vectorizing. Leading dimensions ('lda' etc.) are the distance between rows, in
+values.
+*/
+
+/*
+A value seen as a matrix. A plain array is a column and a number is 1x1.
+*/
+typedef struct{
+	const comp* data;
+	size_t rows;
+	size_t cols;
+}matrix_view;
+
+static matrix_view view_of(const clr_value& v){
+	matrix_view m;
+	if (!v.arr){
+		m.data = &v.num;
+		m.rows = 1;
+		m.cols = 1;
+	}else if (v.arr->cols == 0){
+		m.data = v.arr->data;
+		m.rows = v.arr->length;
+		m.cols = 1;
+	}else{
+		m.data = v.arr->data;
+		m.rows = v.arr->length/v.arr->cols;
+		m.cols = v.arr->cols;
+	}
+	return m;
+}
+
+/*
+Returns 'arr' as a register value: a number if 'scalar', a plain array if 'plain'
+and otherwise a matrix with 'cols' columns.
+*/
+static clr_value result_value(std::shared_ptr<clr_array> arr, size_t cols, bool scalar, bool plain){
+	if (scalar) return clr_value(arr->data[0]);
+	arr->cols = plain ? 0 : cols;
+	return clr_value(std::shared_ptr<const clr_array>(arr));
+}
+
+static inline comp cmul(comp a, comp b){
+	return comp(a.real()*b.real() - a.imag()*b.imag(), a.real()*b.imag() + a.imag()*b.real());
+}
+
+//****************************************************************************
+// MULTIPLY
+
+/*
+C[r0:r1, c0:c1] += sign * A[r0:r1, :] * B[:, c0:c1] for complex matrices, where
+the inner dimension is 'p'. The inner dimension is processed CLR_GEMM_BLOCK_K at
+a time. C is updated in blocks of 2 rows by 4 columns which are kept in
+registers for the whole block of the inner dimension, so each step loads 4
+values from B and 2 from A for 8 complex multiply-adds.
+*/
+static void gemm_tile(const double* A, size_t lda, const double* B, size_t ldb, double* C, size_t ldc, size_t r0, size_t r1, size_t c0, size_t c1, size_t p, double sign){
+
+	size_t w = 2*(c1 - c0);
+	for (size_t kk = 0 ; kk < p ; kk += CLR_GEMM_BLOCK_K){
+		size_t k1 = min(p, kk + CLR_GEMM_BLOCK_K);
+		size_t i = r0;
+		for ( ; i + 2 <= r1 ; i += 2){
+			const double* a0 = A + 2*i*lda;
+			const double* a1 = a0 + 2*lda;
+			size_t j = 0;
+			for ( ; j + 8 <= w ; j += 8){
+				double s0[8] = {0, 0, 0, 0, 0, 0, 0, 0}, s1[8] = {0, 0, 0, 0, 0, 0, 0, 0};
+				for (size_t k = kk ; k < k1 ; k++){
+					const double* b = B + 2*(k*ldb + c0) + j;
+					double a0r = a0[2*k], a0i = a0[2*k+1], a1r = a1[2*k], a1i = a1[2*k+1];
+					for (size_t c = 0 ; c < 8 ; c += 2){
+						s0[c] += a0r*b[c] - a0i*b[c+1];
+						s0[c+1] += a0r*b[c+1] + a0i*b[c];
+						s1[c] += a1r*b[c] - a1i*b[c+1];
+						s1[c+1] += a1r*b[c+1] + a1i*b[c];
+					}
+				}
+				double* x0 = C + 2*(i*ldc + c0) + j;
+				double* x1 = x0 + 2*ldc;
+				for (size_t c = 0 ; c < 8 ; c++){
+					x0[c] += sign*s0[c];
+					x1[c] += sign*s1[c];
+				}
+			}
+			double* x0 = C + 2*(i*ldc + c0);
+			double* x1 = x0 + 2*ldc;
+			for (size_t k = kk ; k < k1 && j < w ; k++){
+				double a0r = sign*a0[2*k], a0i = sign*a0[2*k+1];
+				double a1r = sign*a1[2*k], a1i = sign*a1[2*k+1];
+				const double* b = B + 2*(k*ldb + c0);
+				for (size_t jj = j ; jj < w ; jj += 2){
+					double br = b[jj], bi = b[jj+1];
+					x0[jj] += a0r*br - a0i*bi;
+					x0[jj+1] += a0r*bi + a0i*br;
+					x1[jj] += a1r*br - a1i*bi;
+					x1[jj+1] += a1r*bi + a1i*br;
+				}
+			}
+		}
+		for ( ; i < r1 ; i++){
+			double* x0 = C + 2*(i*ldc + c0);
+			for (size_t k = kk ; k < k1 ; k++){
+				double a0r = sign*A[2*(i*lda + k)], a0i = sign*A[2*(i*lda + k) + 1];
+				const double* b = B + 2*(k*ldb + c0);
+				for (size_t j = 0 ; j < w ; j += 2){
+					double br = b[j], bi = b[j+1];
+					x0[j] += a0r*br - a0i*bi;
+					x0[j+1] += a0r*bi + a0i*br;
+				}
+			}
+		}
+	}
+}
+
+/*
+Real version of gemm_tile, for matrices with no imaginary parts. C is updated in
+blocks of 4 rows by 8 columns which are kept in registers for the whole block of
+the inner dimension, so each step loads one row of 8 values from B and four
+values from A for 32 multiply-adds.
+*/
+static void gemm_tile_real(const double* A, size_t lda, const double* B, size_t ldb, double* C, size_t ldc, size_t r0, size_t r1, size_t c0, size_t c1, size_t p){
+
+	size_t w = c1 - c0;
+	for (size_t kk = 0 ; kk < p ; kk += CLR_GEMM_BLOCK_K){
+		size_t k1 = min(p, kk + CLR_GEMM_BLOCK_K);
+		size_t i = r0;
+		for ( ; i + 4 <= r1 ; i += 4){
+			const double* a0 = A + i*lda;
+			const double* a1 = a0 + lda;
+			const double* a2 = a1 + lda;
+			const double* a3 = a2 + lda;
+			size_t j = 0;
+			for ( ; j + 8 <= w ; j += 8){
+				double s0[8] = {0, 0, 0, 0, 0, 0, 0, 0}, s1[8] = {0, 0, 0, 0, 0, 0, 0, 0};
+				double s2[8] = {0, 0, 0, 0, 0, 0, 0, 0}, s3[8] = {0, 0, 0, 0, 0, 0, 0, 0};
+				for (size_t k = kk ; k < k1 ; k++){
+					const double* b = B + k*ldb + c0 + j;
+					double v0 = a0[k], v1 = a1[k], v2 = a2[k], v3 = a3[k];
+					for (size_t c = 0 ; c < 8 ; c++){
+						s0[c] += v0*b[c];
+						s1[c] += v1*b[c];
+						s2[c] += v2*b[c];
+						s3[c] += v3*b[c];
+					}
+				}
+				double* x = C + i*ldc + c0 + j;
+				for (size_t c = 0 ; c < 8 ; c++){
+					x[c] += s0[c];
+					x[ldc + c] += s1[c];
+					x[2*ldc + c] += s2[c];
+					x[3*ldc + c] += s3[c];
+				}
+			}
+			for ( ; j < w ; j++){
+				double s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+				for (size_t k = kk ; k < k1 ; k++){
+					double bj = B[k*ldb + c0 + j];
+					s0 += a0[k]*bj;
+					s1 += a1[k]*bj;
+					s2 += a2[k]*bj;
+					s3 += a3[k]*bj;
+				}
+				double* x = C + i*ldc + c0 + j;
+				x[0] += s0;
+				x[ldc] += s1;
+				x[2*ldc] += s2;
+				x[3*ldc] += s3;
+			}
+		}
+		for ( ; i < r1 ; i++){
+			double* x0 = C + i*ldc + c0;
+			for (size_t k = kk ; k < k1 ; k++){
+				double a0 = A[i*lda + k];
+				const double* b = B + k*ldb + c0;
+				for (size_t j = 0 ; j < w ; j++) x0[j] += a0*b[j];
+			}
+		}
+	}
+}
+
+/*
+Splits an m x n result into tiles of CLR_GEMM_BLOCK_N columns and 64 rows and
+calls tile(r0, r1, c0, c1) for each, spread over threads. Each tile does m*n*p
+multiply-adds, so small products run on one thread.
+*/
+static void for_each_tile(size_t m, size_t n, size_t p, const std::function<void(size_t, size_t, size_t, size_t)>& tile){
+
+	const size_t tile_rows = 64;
+	size_t row_tiles = (m + tile_rows - 1)/tile_rows;
+	size_t col_tiles = (n + CLR_GEMM_BLOCK_N - 1)/CLR_GEMM_BLOCK_N;
+	size_t work = tile_rows*CLR_GEMM_BLOCK_N*(p > 0 ? p : 1);
+	size_t grain = CLR_GEMM_GRAIN/work + 1;
+
+	parallel_for(row_tiles*col_tiles, grain, [&](size_t begin, size_t end, size_t thread){
+		for (size_t t = begin ; t < end ; t++){
+			size_t r0 = (t/col_tiles)*tile_rows, c0 = (t%col_tiles)*CLR_GEMM_BLOCK_N;
+			tile(r0, min(m, r0 + tile_rows), c0, min(n, c0 + CLR_GEMM_BLOCK_N));
+		}
+	});
+}
+
+/*
+C += sign * A*B, where A is m x p, B is p x n and C is m x n. C must not overlap
+A or B.
+*/
+static void gemm(const comp* A, size_t lda, const comp* B, size_t ldb, comp* C, size_t ldc, size_t m, size_t n, size_t p, double sign){
+	const double* a = reinterpret_cast<const double*>(A);
+	const double* b = reinterpret_cast<const double*>(B);
+	double* c = reinterpret_cast<double*>(C);
+	for_each_tile(m, n, p, [&](size_t r0, size_t r1, size_t c0, size_t c1){
+		gemm_tile(a, lda, b, ldb, c, ldc, r0, r1, c0, c1, p, sign);
+	});
+}
+
+/*
+Returns true if none of the 'n' values in 'v' have an imaginary part.
+*/
+static bool is_real(const comp* v, size_t n){
+	for (size_t k = 0 ; k < n ; k++){
+		if (v[k].imag() != 0) return false;
+	}
+	return true;
+}
+
+/*
+Computes the matrix product a*b and writes it to 'out'. If neither has an
+imaginary part, the product is computed in real arithmetic (a quarter of the
+work). The result is a number if both are numbers and a plain array if 'b' is
+one.
+*/
+bool matrix_multiply(const clr_value& a, const clr_value& b, clr_value& out, std::string& err){
+
+	matrix_view A = view_of(a), B = view_of(b);
+	if (A.cols != B.rows){
+		err = "Can not multiply a " + to_string(A.rows) + "x" + to_string(A.cols) + " matrix by a " + to_string(B.rows) + "x" + to_string(B.cols) + " matrix.";
+		return false;
+	}
+	size_t m = A.rows, n = B.cols, p = A.cols;
+
+	std::shared_ptr<clr_array> C = new_array(m*n);
+	if (is_real(A.data, m*p) && is_real(B.data, p*n)){
+		vector<double> ar(m*p), br(p*n), cr(m*n, 0.0);
+		for (size_t k = 0 ; k < m*p ; k++) ar[k] = A.data[k].real();
+		for (size_t k = 0 ; k < p*n ; k++) br[k] = B.data[k].real();
+		for_each_tile(m, n, p, [&](size_t r0, size_t r1, size_t c0, size_t c1){
+			gemm_tile_real(ar.data(), p, br.data(), n, cr.data(), n, r0, r1, c0, c1, p);
+		});
+		for (size_t k = 0 ; k < m*n ; k++) C->data[k] = comp(cr[k], 0);
+	}else{
+		gemm(A.data, p, B.data, n, C->data, n, m, n, p, 1);
+	}
+
+	out = result_value(C, n, !a.arr && !b.arr, b.arr && b.arr->cols == 0);
+	return true;
+}
+
+//****************************************************************************
+// LU DECOMPOSITION
+
+/*
+Factors the n x n matrix 'a' in place into P*A = L*U, with partial pivoting. L
+(unit diagonal, not stored) is left below the diagonal and U on and above it.
+perm[i] is the row of the original matrix now in row i, and 'sign' is the
+parity of the permutation (for the determinant).
+
+The matrix is factored CLR_LU_BLOCK columns at a time: the block of columns is
+factored directly, then the rows to its right are solved for (U12), and the rest
+of the matrix is updated with a single multiply (A22 -= L21*U12), which is where
+nearly all of the work is done. Returns false if the matrix is singular.
+*/
+static bool lu_factor(comp* a, size_t n, vector<size_t>& perm, int& sign){
+
+	perm.resize(n);
+	for (size_t i = 0 ; i < n ; i++) perm[i] = i;
+	sign = 1;
+
+	for (size_t kb = 0 ; kb < n ; kb += CLR_LU_BLOCK){
+		size_t ke = min(n, kb + CLR_LU_BLOCK);
+
+		//Factor columns kb to ke
+		for (size_t c = kb ; c < ke ; c++){
+			size_t piv = c;
+			double best = norm(a[c*n + c]);
+			for (size_t i = c+1 ; i < n ; i++){
+				double v = norm(a[i*n + c]);
+				if (v > best){
+					best = v;
+					piv = i;
+				}
+			}
+			if (best == 0) return false;
+			if (piv != c){
+				swap_ranges(a + c*n, a + c*n + n, a + piv*n);
+				swap(perm[c], perm[piv]);
+				sign = -sign;
+			}
+			comp inv = 1.0/a[c*n + c];
+			for (size_t i = c+1 ; i < n ; i++){
+				comp l = cmul(a[i*n + c], inv);
+				a[i*n + c] = l;
+				for (size_t j = c+1 ; j < ke ; j++) a[i*n + j] -= cmul(l, a[c*n + j]);
+			}
+		}
+		if (ke == n) break;
+
+		//U12 = L11^-1 * A12, spread over columns
+		parallel_for(n - ke, 64, [&](size_t begin, size_t end, size_t thread){
+			for (size_t r = kb+1 ; r < ke ; r++){
+				for (size_t rr = kb ; rr < r ; rr++){
+					comp l = a[r*n + rr];
+					for (size_t j = ke + begin ; j < ke + end ; j++) a[r*n + j] -= cmul(l, a[rr*n + j]);
+				}
+			}
+		});
+
+		//A22 -= L21*U12
+		gemm(a + ke*n + kb, n, a + kb*n + ke, n, a + ke*n + ke, n, n - ke, n - ke, ke - kb, -1);
+	}
+
+	return true;
+}
+
+/*
+Solves L*U*X = P*B in place, where 'lu' and 'perm' come from lu_factor and 'x'
+holds P*B (n rows of 'm' values). Both triangular solves go CLR_LU_BLOCK rows at
+a time: the rows already solved are removed from the next block with a multiply
+and the block itself is solved directly, with the columns of 'x' spread over
+threads.
+*/
+static void lu_solve(const comp* lu, size_t n, comp* x, size_t m){
+
+	//Forward (L has a unit diagonal)
+	for (size_t ib = 0 ; ib < n ; ib += CLR_LU_BLOCK){
+		size_t ie = min(n, ib + CLR_LU_BLOCK);
+		if (ib > 0) gemm(lu + ib*n, n, x, m, x + ib*m, m, ie - ib, m, ib, -1);
+		parallel_for(m, 64, [&](size_t begin, size_t end, size_t thread){
+			for (size_t i = ib+1 ; i < ie ; i++){
+				for (size_t k = ib ; k < i ; k++){
+					comp l = lu[i*n + k];
+					for (size_t j = begin ; j < end ; j++) x[i*m + j] -= cmul(l, x[k*m + j]);
+				}
+			}
+		});
+	}
+
+	//Backward
+	size_t blocks = (n + CLR_LU_BLOCK - 1)/CLR_LU_BLOCK;
+	for (size_t bidx = blocks ; bidx > 0 ; bidx--){
+		size_t ib = (bidx-1)*CLR_LU_BLOCK;
+		size_t ie = min(n, ib + CLR_LU_BLOCK);
+		if (ie < n) gemm(lu + ib*n + ie, n, x + ie*m, m, x + ib*m, m, ie - ib, m, n - ie, -1);
+		parallel_for(m, 64, [&](size_t begin, size_t end, size_t thread){
+			for (size_t i = ie ; i > ib ; i--){
+				size_t r = i-1;
+				for (size_t k = r+1 ; k < ie ; k++){
+					comp u = lu[r*n + k];
+					for (size_t j = begin ; j < end ; j++) x[r*m + j] -= cmul(u, x[k*m + j]);
+				}
+				comp inv = 1.0/lu[r*n + r];
+				for (size_t j = begin ; j < end ; j++) x[r*m + j] = cmul(x[r*m + j], inv);
+			}
+		});
+	}
+}
+
+/*
+Copies the square matrix 'v' into 'lu' and factors it. Returns false (and
+describes the problem in 'err') if 'v' is not square or is singular.
+*/
+static bool factor_value(const clr_value& v, vector<comp>& lu, vector<size_t>& perm, int& sign, bool& singular, std::string& err){
+	matrix_view A = view_of(v);
+	singular = false;
+	if (A.rows != A.cols){
+		err = "Matrix must be square (it is " + to_string(A.rows) + "x" + to_string(A.cols) + ").";
+		return false;
+	}
+	lu.assign(A.data, A.data + A.rows*A.cols);
+	if (!lu_factor(lu.data(), A.rows, perm, sign)){
+		singular = true;
+		err = "Matrix is singular.";
+		return false;
+	}
+	return true;
+}
+
+/*
+Solves a*out = b, with 'a' square and 'b' having as many rows as 'a' (one or more
+columns). 'out' has the same shape as 'b'.
+*/
+bool matrix_solve(const clr_value& a, const clr_value& b, clr_value& out, std::string& err){
+
+	vector<comp> lu;
+	vector<size_t> perm;
+	int sign;
+	bool singular;
+	if (!factor_value(a, lu, perm, sign, singular, err)) return false;
+
+	size_t n = perm.size();
+	matrix_view B = view_of(b);
+	if (B.rows != n){
+		err = "Right hand side has " + to_string(B.rows) + " rows, but the matrix has " + to_string(n) + ".";
+		return false;
+	}
+
+	std::shared_ptr<clr_array> X = new_array(n*B.cols);
+	for (size_t i = 0 ; i < n ; i++){
+		copy(B.data + perm[i]*B.cols, B.data + perm[i]*B.cols + B.cols, X->data + i*B.cols);
+	}
+	lu_solve(lu.data(), n, X->data, B.cols);
+
+	out = result_value(X, B.cols, !b.arr, b.arr && b.arr->cols == 0);
+	return true;
+}
+
+/*
+Computes the inverse of the square matrix 'a' by solving a*out = I.
+*/
+bool matrix_inverse(const clr_value& a, clr_value& out, std::string& err){
+
+	vector<comp> lu;
+	vector<size_t> perm;
+	int sign;
+	bool singular;
+	if (!factor_value(a, lu, perm, sign, singular, err)) return false;
+
+	size_t n = perm.size();
+	std::shared_ptr<clr_array> X = new_array(n*n);
+	for (size_t i = 0 ; i < n ; i++) X->data[i*n + perm[i]] = comp(1, 0); //Row i of P*I
+	lu_solve(lu.data(), n, X->data, n);
+
+	out = result_value(X, n, !a.arr, false);
+	return true;
+}
+
+/*
+Computes the determinant of the square matrix 'a' from its LU decomposition. A
+singular matrix has determinant 0.
+*/
+bool matrix_determinant(const clr_value& a, comp& out, std::string& err){
+
+	vector<comp> lu;
+	vector<size_t> perm;
+	int sign;
+	bool singular;
+	if (!factor_value(a, lu, perm, sign, singular, err)){
+		if (!singular) return false;
+		out = comp(0, 0);
+		return true;
+	}
+
+	size_t n = perm.size();
+	out = comp(sign, 0);
+	for (size_t i = 0 ; i < n ; i++) out = cmul(out, lu[i*n + i]);
+	return true;
+}
+
+//****************************************************************************
+// SHAPE
+
+/*
+Makes a matrix with 'cols' columns from the values of the array in 'x', without
+copying them. 'cols' must divide the array's length. If 'cols' is 0 the result is
+a plain array.
+*/
+bool matrix_reshape(const clr_value& x, size_t cols, clr_value& out, std::string& err){
+
+	if (!x.arr){
+		err = "Only arrays can be reshaped into matrices.";
+		return false;
+	}
+	if (cols != 0 && x.arr->length % cols != 0){
+		err = "An array of " + to_string(x.arr->length) + " values can not be split into rows of " + to_string(cols) + ".";
+		return false;
+	}
+
+	std::shared_ptr<clr_array> arr(new clr_array(*x.arr)); //Shares the values
+	arr->cols = cols;
+	out = clr_value(std::shared_ptr<const clr_array>(arr));
+	return true;
+}
+
+/*
+Transposes 'x' (without conjugating). The copy is done in square tiles of
+CLR_TRANSPOSE_BLOCK so both the rows read and the rows written stay in cache. A
+plain array (ie. a column) becomes a 1xn matrix.
+*/
+bool matrix_transpose(const clr_value& x, clr_value& out, std::string& err){
+
+	if (!x.arr){
+		out = x;
+		return true;
+	}
+
+	matrix_view A = view_of(x);
+	std::shared_ptr<clr_array> T = new_array(A.rows*A.cols);
+	size_t row_tiles = (A.rows + CLR_TRANSPOSE_BLOCK - 1)/CLR_TRANSPOSE_BLOCK;
+	parallel_for(row_tiles, (1 << 16)/(CLR_TRANSPOSE_BLOCK*(A.cols + 1)) + 1, [&](size_t begin, size_t end, size_t thread){
+		for (size_t it = begin ; it < end ; it++){
+			size_t i0 = it*CLR_TRANSPOSE_BLOCK, i1 = min(A.rows, i0 + CLR_TRANSPOSE_BLOCK);
+			for (size_t j0 = 0 ; j0 < A.cols ; j0 += CLR_TRANSPOSE_BLOCK){
+				size_t j1 = min(A.cols, j0 + CLR_TRANSPOSE_BLOCK);
+				for (size_t i = i0 ; i < i1 ; i++){
+					for (size_t j = j0 ; j < j1 ; j++) T->data[j*A.rows + i] = A.data[i*A.cols + j];
+				}
+			}
+		}
+	});
+
+	out = result_value(T, A.rows, false, false);
+	return true;
+}
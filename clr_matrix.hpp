@@ -0,0 +1,42 @@
+/*
+This file declares matrix operations. A matrix is a clr_array with 'cols' set,
+holding its rows one after another (row-major). Element-wise operations treat
+matrices like any other array; the functions here are the ones which depend on
+the shape. A plain array is treated as a column vector and a number as a 1x1
+matrix.
+
+Created by Grant Giesbrecht on 19.10.2026
+
+*/
+
+#include <string>
+#include "clr_types.hpp"
+
+#ifndef CLR_MATRIX_HPP
+#define CLR_MATRIX_HPP
+
+#define CLR_GEMM_BLOCK_K 128 //Inner dimension per block of a multiply (one block of B stays in L2 cache)
+#define CLR_GEMM_BLOCK_N 256 //Columns per block of a multiply (rows of C being updated stay in L1 cache)
+#define CLR_GEMM_GRAIN (1 << 18) //Min multiply-adds per thread
+#define CLR_LU_BLOCK 64 //Columns factored at a time by LU. The rest of the matrix is updated with one multiply per block
+#define CLR_TRANSPOSE_BLOCK 32 //Rows and columns per tile of a transpose
+
+//Reshapes the values of 'x' into a matrix with 'cols' columns (0 makes a plain array)
+bool matrix_reshape(const clr_value& x, size_t cols, clr_value& out, std::string& err);
+
+//Transposes 'x'
+bool matrix_transpose(const clr_value& x, clr_value& out, std::string& err);
+
+//Computes the matrix product a*b
+bool matrix_multiply(const clr_value& a, const clr_value& b, clr_value& out, std::string& err);
+
+//Solves a*out = b for 'out'
+bool matrix_solve(const clr_value& a, const clr_value& b, clr_value& out, std::string& err);
+
+//Computes the inverse of 'a'
+bool matrix_inverse(const clr_value& a, clr_value& out, std::string& err);
+
+//Computes the determinant of 'a'
+bool matrix_determinant(const clr_value& a, comp& out, std::string& err);
+
+#endif
@@ -0,0 +1,142 @@
+#include "clr_memstat.hpp"
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+#ifdef CLR_ALLOC_STATS
+
+//Counters. Updated from any thread, so they're atomic
+static std::atomic<uint64_t> stat_allocs(0);
+static std::atomic<uint64_t> stat_frees(0);
+static std::atomic<uint64_t> stat_bytes(0);
+static std::atomic<uint64_t> stat_live(0);
+static std::atomic<uint64_t> stat_peak(0);
+static uint64_t line_start = 0; //'stat_allocs' when the current line began
+static uint64_t line_allocs = 0;
+
+//Each block is preceded by a header holding its size, so frees can be counted in
+// bytes. 16 bytes keeps the block aligned as malloc would
+#define CLR_ALLOC_HEADER 16
+
+/*
+Allocates 'size' bytes and counts it. Returns NULL on failure.
+*/
+static void* counted_alloc(size_t size){
+
+	char* p = (char*)malloc(size + CLR_ALLOC_HEADER);
+	if (p == NULL) return NULL;
+	*(size_t*)p = size;
+
+	stat_allocs.fetch_add(1, std::memory_order_relaxed);
+	stat_bytes.fetch_add(size, std::memory_order_relaxed);
+	uint64_t live = stat_live.fetch_add(size, std::memory_order_relaxed) + size;
+	uint64_t peak = stat_peak.load(std::memory_order_relaxed);
+	while (live > peak && !stat_peak.compare_exchange_weak(peak, live, std::memory_order_relaxed));
+
+	return p + CLR_ALLOC_HEADER;
+}
+
+/*
+Frees a block from counted_alloc and counts it.
+*/
+static void counted_free(void* ptr){
+
+	if (ptr == NULL) return;
+	char* p = (char*)ptr - CLR_ALLOC_HEADER;
+
+	stat_frees.fetch_add(1, std::memory_order_relaxed);
+	stat_live.fetch_sub(*(size_t*)p, std::memory_order_relaxed);
+	free(p);
+}
+
+/*
+Replacements for the global allocation functions. Every form is counted.
+*/
+void* operator new(size_t size){
+	void* p = counted_alloc(size);
+	if (p == NULL) throw std::bad_alloc();
+	return p;
+}
+
+void* operator new[](size_t size){
+	void* p = counted_alloc(size);
+	if (p == NULL) throw std::bad_alloc();
+	return p;
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept{
+	return counted_alloc(size);
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept{
+	return counted_alloc(size);
+}
+
+void operator delete(void* ptr) noexcept{
+	counted_free(ptr);
+}
+
+void operator delete[](void* ptr) noexcept{
+	counted_free(ptr);
+}
+
+void operator delete(void* ptr, const std::nothrow_t&) noexcept{
+	counted_free(ptr);
+}
+
+void operator delete[](void* ptr, const std::nothrow_t&) noexcept{
+	counted_free(ptr);
+}
+
+/*
+Returns true if CLR was built with allocation accounting.
+*/
+bool alloc_stats_enabled(){
+	return true;
+}
+
+/*
+Returns the current counters.
+*/
+clr_alloc_stats alloc_stats(){
+	clr_alloc_stats s;
+	s.allocs = stat_allocs.load();
+	s.frees = stat_frees.load();
+	s.bytes_allocated = stat_bytes.load();
+	s.bytes_live = stat_live.load();
+	s.bytes_peak = stat_peak.load();
+	s.line_allocs = line_allocs;
+	return s;
+}
+
+/*
+Marks the start of evaluating a REPL line.
+*/
+void alloc_stats_begin_line(){
+	line_start = stat_allocs.load();
+}
+
+/*
+Marks the end of evaluating a REPL line. The allocations made since
+alloc_stats_begin_line() are reported as 'line_allocs'.
+*/
+void alloc_stats_end_line(){
+	line_allocs = stat_allocs.load() - line_start;
+}
+
+#else //Accounting disabled
+
+bool alloc_stats_enabled(){
+	return false;
+}
+
+clr_alloc_stats alloc_stats(){
+	clr_alloc_stats s = {0, 0, 0, 0, 0, 0};
+	return s;
+}
+
+void alloc_stats_begin_line(){}
+
+void alloc_stats_end_line(){}
+
+#endif
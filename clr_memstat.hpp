@@ -0,0 +1,45 @@
+/*
+This file declares CLR's heap allocation accounting. When CLR is built with
+CLR_ALLOC_STATS defined, the global operator new and delete are replaced with
+versions that count every allocation. Otherwise the functions below report that
+accounting is disabled and cost nothing.
+
+Created by Grant Giesbrecht on 19.10.2026
+
+*/
+
+#include <stdint.h>
+
+#ifndef CLR_MEMSTAT_HPP
+#define CLR_MEMSTAT_HPP
+
+/*
+Snapshot of the allocation counters.
+
+allocs = Number of allocations since startup
+frees = Number of deallocations since startup
+bytes_allocated = Total bytes requested since startup
+bytes_live = Bytes currently allocated
+bytes_peak = Largest value 'bytes_live' has had
+line_allocs = Allocations made while the previous REPL line was evaluated
+*/
+typedef struct{
+	uint64_t allocs;
+	uint64_t frees;
+	uint64_t bytes_allocated;
+	uint64_t bytes_live;
+	uint64_t bytes_peak;
+	uint64_t line_allocs;
+}clr_alloc_stats;
+
+//Returns true if CLR was built with allocation accounting
+bool alloc_stats_enabled();
+
+//Returns the current counters
+clr_alloc_stats alloc_stats();
+
+//Marks the start and end of evaluating a REPL line (sets 'line_allocs')
+void alloc_stats_begin_line();
+void alloc_stats_end_line();
+
+#endif
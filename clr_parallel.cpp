@@ -0,0 +1,195 @@
+#include "clr_parallel.hpp"
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <vector>
+#include <exception>
+
+using namespace std;
+
+/*
+A range of a parallel_for call, waiting to be run.
+
+fn = Function to call on the range
+begin, end, index = Arguments for 'fn'
+remaining = Ranges of the same call not yet finished (owned by the caller)
+*/
+typedef struct{
+	const std::function<void(size_t, size_t, size_t)>* fn;
+	size_t begin;
+	size_t end;
+	size_t index;
+	size_t* remaining;
+}pool_task;
+
+/*
+The threads which run parallel_for's ranges. They are started the first time a
+call is split and then wait for more ranges until the program exits, so callers
+which split work many times in a row (eg. INTEG, every refinement round) don't
+start and join threads each time.
+
+lock = Guards everything below
+wake = Signalled when ranges are queued, or to stop the workers
+done = Signalled when a range finishes
+tasks = Ranges waiting for a thread
+workers = The pool's threads
+stop = Set when the program exits
+*/
+struct parallel_pool{
+	std::mutex lock;
+	std::condition_variable wake;
+	std::condition_variable done;
+	std::deque<pool_task> tasks;
+	std::vector<std::thread> workers;
+	bool stop;
+
+	parallel_pool() : stop(false) {}
+	~parallel_pool();
+};
+
+static thread_local bool pool_worker = false; //Set on the pool's own threads
+
+/*
+Stops the workers once the queue is empty and waits for them to exit.
+*/
+parallel_pool::~parallel_pool(){
+	{
+		lock_guard<mutex> guard(lock);
+		stop = true;
+	}
+	wake.notify_all();
+	for (size_t w = 0 ; w < workers.size() ; w++) workers[w].join();
+}
+
+/*
+Returns the pool, created on first use.
+*/
+static parallel_pool& get_pool(){
+	static parallel_pool pool;
+	return pool;
+}
+
+/*
+Runs 'task' with 'pool's lock released, then counts it as finished. Exceptions
+are kept in 'failure' (if not NULL) so the caller's range bookkeeping still
+completes.
+*/
+static void run_task(parallel_pool& pool, unique_lock<mutex>& held, const pool_task& task, exception_ptr* failure){
+	held.unlock();
+	try{
+		(*task.fn)(task.begin, task.end, task.index);
+	}catch (...){
+		if (failure == NULL) throw;
+		*failure = current_exception();
+	}
+	held.lock();
+	if (--*task.remaining == 0) pool.done.notify_all();
+}
+
+/*
+Body of each worker thread: runs queued ranges until the pool stops.
+*/
+static void worker_main(parallel_pool* pool){
+	pool_worker = true;
+	unique_lock<mutex> held(pool->lock);
+	while (true){
+		pool->wake.wait(held, [pool]{ return pool->stop || !pool->tasks.empty(); });
+		if (pool->tasks.empty()) return;
+		pool_task task = pool->tasks.front();
+		pool->tasks.pop_front();
+		run_task(*pool, held, task, NULL);
+	}
+}
+
+/*
+Returns the number of threads parallel_for will use at most. This is the number
+of hardware threads, or 1 if that can't be determined.
+*/
+size_t parallel_threads(){
+	size_t n = thread::hardware_concurrency();
+	return (n > 0) ? n : 1;
+}
+
+/*
+Splits [0, n) into at most parallel_threads() contiguous ranges of at least
+'min_grain' items and calls fn(begin, end, thread_index) for each range. The
+last range runs on the calling thread and the others on the pool's workers
+(see parallel_pool). While waiting for them, the caller runs any of its ranges
+no worker has picked up yet. Returns once every range is done.
+
+'thread_index' runs from 0 to the number of ranges - 1, in order of 'begin', so
+callers can keep per-thread results and combine them in order afterwards.
+
+A call made from one of the pool's workers (eg. a keyword inside a function run
+by INTEG) runs its ranges in order on that worker, so workers never wait on each
+other. The ranges are the same, so the result is too.
+*/
+void parallel_for(size_t n, size_t min_grain, std::function<void(size_t, size_t, size_t)> fn){
+
+	if (n == 0) return;
+	if (min_grain < 1) min_grain = 1;
+
+	size_t ranges = n/min_grain;
+	if (ranges > parallel_threads()) ranges = parallel_threads();
+	if (ranges < 1) ranges = 1;
+
+	//Small jobs aren't worth handing to another thread
+	if (ranges == 1){
+		fn(0, n, 0);
+		return;
+	}
+
+	size_t step = n/ranges;
+	size_t extra = n%ranges;
+	vector<pool_task> split(ranges);
+	size_t remaining = ranges - 1;
+	size_t begin = 0;
+	for (size_t r = 0 ; r < ranges ; r++){
+		split[r].fn = &fn;
+		split[r].begin = begin;
+		split[r].end = begin + step + (r < extra ? 1 : 0);
+		split[r].index = r;
+		split[r].remaining = &remaining;
+		begin = split[r].end;
+	}
+
+	if (pool_worker){
+		for (size_t r = 0 ; r < ranges ; r++) fn(split[r].begin, split[r].end, r);
+		return;
+	}
+
+	//Queue all but the last range, starting the workers if this is the first call
+	parallel_pool& pool = get_pool();
+	unique_lock<mutex> held(pool.lock);
+	while (pool.workers.size() + 1 < parallel_threads()){
+		pool.workers.push_back(thread(worker_main, &pool));
+	}
+	pool.tasks.insert(pool.tasks.end(), split.begin(), split.end() - 1);
+	held.unlock();
+	pool.wake.notify_all();
+
+	exception_ptr failure;
+	try{
+		fn(split[ranges-1].begin, split[ranges-1].end, ranges-1);
+	}catch (...){
+		failure = current_exception();
+	}
+
+	//Wait for the rest, running those still queued here
+	held.lock();
+	while (remaining > 0){
+		deque<pool_task>::iterator it = pool.tasks.begin();
+		while (it != pool.tasks.end() && it->remaining != &remaining) it++;
+		if (it == pool.tasks.end()){
+			pool.done.wait(held);
+			continue;
+		}
+		pool_task task = *it;
+		pool.tasks.erase(it);
+		run_task(pool, held, task, &failure);
+	}
+	held.unlock();
+
+	if (failure) rethrow_exception(failure);
+}
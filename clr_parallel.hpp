@@ -0,0 +1,20 @@
+/*
+This file declares CLR's helpers for running work on multiple threads.
+
+Created by Grant Giesbrecht on 19.10.2026
+
+*/
+
+#include <stddef.h>
+#include <functional>
+
+#ifndef CLR_PARALLEL_HPP
+#define CLR_PARALLEL_HPP
+
+//Returns the number of threads parallel_for will use at most
+size_t parallel_threads();
+
+//Splits [0, n) into contiguous ranges and calls fn(begin, end, thread_index) for each on its own thread (from a pool kept between calls)
+void parallel_for(size_t n, size_t min_grain, std::function<void(size_t, size_t, size_t)> fn);
+
+#endif
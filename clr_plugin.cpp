@@ -0,0 +1,94 @@
+#include "clr_plugin.hpp"
+#include "clr_interpret.hpp"
+#include "clr_keywords.hpp"
+#include <IEGA/string_manip.hpp>
+#include <dlfcn.h>
+
+using namespace std;
+
+/*
+Opens the shared library at 'path', reads its function table and adds each
+function to 'state' as a base function. Returns false and describes the problem
+in 'err' if the library can't be loaded, or if any of its functions is invalid,
+has the same name as an existing function or is named after a keyword. In that
+case no functions are added.
+
+NOTE: Plugins are never closed, as the functions they add may be shared by
+	forks of 'state' and are expected to live as long as the program.
+*/
+bool load_plugin(std::string path, clr_state* state, std::string& err){
+
+	//Open library
+	void* handle = dlopen(path.c_str(), RTLD_NOW | RTLD_LOCAL);
+	if (handle == NULL){
+		err = "Failed to open plugin '" + path + "': " + dlerror();
+		return false;
+	}
+
+	clr_plugin_entry entry = (clr_plugin_entry) dlsym(handle, CLR_PLUGIN_ENTRY_SYMBOL);
+	if (entry == NULL){
+		err = "Plugin '" + path + "' does not export '" + CLR_PLUGIN_ENTRY_SYMBOL + "'.";
+		dlclose(handle);
+		return false;
+	}
+
+	//Read function table
+	size_t count = 0;
+	int abi_version = -1;
+	const clr_plugin_function* table = entry(&count, &abi_version);
+	if (abi_version != CLR_PLUGIN_ABI_VERSION){
+		err = "Plugin '" + path + "' was built for plugin ABI version " + dtos(abi_version, 0, 3) + " (expected " + dtos(CLR_PLUGIN_ABI_VERSION, 0, 3) + ").";
+		dlclose(handle);
+		return false;
+	}
+
+	//Check every function before adding any
+	vector<clr_function> added;
+	clr_function temp_func;
+	temp_func.interpreted = false;
+	temp_func.compiled = false;
+	for (size_t f = 0 ; f < count ; f++){
+
+		if (table[f].name == NULL || table[f].fnptr == NULL || !is_valid_name(table[f].name)){
+			err = "Plugin '" + path + "' has an invalid entry at index " + dtos(f, 0, 3) + ".";
+			dlclose(handle);
+			return false;
+		}
+
+		temp_func.name = to_uppercase(table[f].name);
+		temp_func.fnptr = table[f].fnptr;
+		temp_func.batchptr = table[f].batchptr;
+		if (table[f].helpstr != NULL){
+			temp_func.helpstr = table[f].helpstr;
+		}else{
+			temp_func.helpstr = "No help page provided.\n\nType: Plugin Function (" + path + ")\n";
+		}
+
+		bool exists = (find_base_function(temp_func.name) != NULL);
+		for (size_t e = 0 ; e < state->library->functions.size() ; e++){
+			if (state->library->functions[e].name == temp_func.name) exists = true;
+		}
+		for (size_t e = 0 ; e < added.size() ; e++){
+			if (added[e].name == temp_func.name) exists = true;
+		}
+		if (exists){
+			err = "Plugin '" + path + "' defines function '" + temp_func.name + "', which already exists.";
+			dlclose(handle);
+			return false;
+		}
+		string reserved;
+		if (reserved_name(temp_func.name, reserved)){
+			err = "Plugin '" + path + "' defines function '" + temp_func.name + "'. " + reserved;
+			dlclose(handle);
+			return false;
+		}
+
+		added.push_back(temp_func);
+	}
+
+	//Add to library
+	clr_library* lib = writable_library(state);
+	lib->functions.insert(lib->functions.end(), added.begin(), added.end());
+
+	return true;
+}
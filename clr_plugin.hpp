@@ -0,0 +1,56 @@
+/*
+This file defines the interface between CLR and native plugins. A plugin is a
+shared library which adds base functions to CLR at runtime via the ADDFN
+keyword, so fast functions can be added without editing clr_base_functions.cpp.
+
+Created by Grant Giesbrecht on 19.10.2026
+
+*/
+
+#include <string>
+#include "clr_types.hpp"
+
+#ifndef CLR_PLUGIN_HPP
+#define CLR_PLUGIN_HPP
+
+#define CLR_PLUGIN_ABI_VERSION 1
+#define CLR_PLUGIN_ENTRY_SYMBOL "clr_plugin_functions"
+
+/*
+Describes one function exported by a plugin. This is the same structure as the
+base function table (see clr_native_function in clr_types.hpp).
+
+name = Function name (ie. how it's called). Converted to uppercase when loaded.
+fnptr = Callback which executes the function. Must have the same signature as
+	the base functions in clr_base_functions.hpp.
+batchptr = Optional batched version of 'fnptr'. May be NULL.
+helpstr = Help page text. May be NULL.
+*/
+typedef clr_native_function clr_plugin_function;
+
+/*
+Every plugin must export a function with this signature named
+'clr_plugin_functions' (with C linkage). It returns the plugin's table of
+functions, which must remain valid for the life of the program, and writes the
+number of entries to 'count'. 'abi_version' must be set to CLR_PLUGIN_ABI_VERSION.
+
+EXAMPLE:
+
+	static comp my_sqr(comp x, comp y){ return x*x; }
+
+	static clr_plugin_function table[] = {
+		{"MYSQR", my_sqr, NULL, "Computes {x}^2.\n"}
+	};
+
+	extern "C" const clr_plugin_function* clr_plugin_functions(size_t* count, int* abi_version){
+		*count = 1;
+		*abi_version = CLR_PLUGIN_ABI_VERSION;
+		return table;
+	}
+*/
+typedef const clr_plugin_function* (*clr_plugin_entry) (size_t* count, int* abi_version);
+
+//Opens the plugin at 'path' and adds its functions to 'state'
+bool load_plugin(std::string path, clr_state* state, std::string& err);
+
+#endif
@@ -0,0 +1,181 @@
+#include "clr_profile.hpp"
+#include "clr_interpret.hpp"
+#include <IEGA/string_manip.hpp>
+#include <iostream>
+#include <fstream>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+using namespace std;
+
+/*
+Returns the seconds from 'a' to 'b'.
+*/
+static double seconds(std::chrono::steady_clock::time_point a, std::chrono::steady_clock::time_point b){
+	return std::chrono::duration<double>(b - a).count();
+}
+
+/*
+Adds the line which just finished in the innermost frame to the profile.
+*/
+static void end_line(clr_profile* prof, std::chrono::steady_clock::time_point now){
+
+	profile_frame& fr = prof->frames.back();
+	profile_function& pf = prof->functions[fr.name];
+	double total = seconds(fr.line_start, now) - fr.line_overhead;
+	double self = total - fr.child;
+
+	profile_counter& c = pf.lines[fr.line];
+	c.count++;
+	c.total += total;
+	c.self += self;
+	pf.self += self;
+	fr.lines_total += total;
+
+	string stack;
+	for (size_t f = 0 ; f < prof->frames.size() ; f++){
+		if (f > 0) stack = stack + ";";
+		stack = stack + prof->frames[f].name;
+	}
+	prof->stacks[stack] += self;
+}
+
+/*
+Runs the interpreted function 'fn' on 'state' one command at a time, timing each
+command and recording it in 'state's profile. Nested calls of interpreted
+functions are profiled the same way (via ast_eval), and their time is subtracted
+from the calling line's self time.
+
+Only the evaluation of commands is timed: lexing and parsing them, and the
+profiler's own bookkeeping, is left out of the function's times and its callers'
+times, so the times are close to those of the compiled function. Calls are not
+inlined while profiling so every function is seen separately.
+
+Returns false if a command fails, with its index in 'line' and the error in
+'print_out'.
+*/
+bool profile_run(const clr_function& fn, clr_state* state, std::string& print_out, size_t& line){
+
+	std::shared_ptr<clr_profile> prof = state->profile; //Keep the profile alive if PROFILE runs inside the function
+
+	//Enter function
+	profile_function& pf = prof->functions[fn.name];
+	if (pf.lines.size() < fn.commands.size()) pf.lines.resize(fn.commands.size(), profile_counter());
+	pf.calls++;
+	profile_frame fr;
+	fr.name = fn.name;
+	fr.line = 0;
+	fr.child = 0;
+	fr.lines_total = 0;
+	fr.line_overhead = 0;
+	fr.recursive = false;
+	for (size_t f = 0 ; f < prof->frames.size() ; f++){
+		if (prof->frames[f].name == fn.name) fr.recursive = true;
+	}
+	fr.start = std::chrono::steady_clock::now();
+	prof->frames.push_back(fr);
+
+	bool ran = true;
+	for (line = 0 ; line < fn.commands.size() && ran ; line++){
+
+		bool success;
+		vector<token> tks = clr_lex(fn.commands[line], state, success);
+		vector<ast> trees;
+		if (success) trees = clr_parse(tks, state, success);
+		if (!success){ //Let the interpreter report the error
+			ran = interpret_clr(fn.commands[line], state, print_out);
+			continue;
+		}
+
+		profile_frame& cur = prof->frames.back();
+		cur.line = line;
+		cur.child = 0;
+		cur.line_overhead = 0;
+		cur.line_start = std::chrono::steady_clock::now();
+		size_t failed;
+		ran = eval_trees(trees, state, print_out, failed);
+		end_line(prof.get(), std::chrono::steady_clock::now());
+	}
+	line--;
+
+	//Leave function
+	std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+	double total = prof->frames.back().lines_total;
+	double overhead = seconds(prof->frames.back().start, now) - total;
+	if (!prof->frames.back().recursive) pf.total += total;
+	prof->frames.pop_back();
+	if (prof->frames.size() > 0){
+		prof->frames.back().child += total;
+		prof->frames.back().line_overhead += overhead;
+	}
+
+	return ran;
+}
+
+/*
+Formats seconds as milliseconds for the report.
+*/
+static string ms(double s){
+	char buf[32];
+	snprintf(buf, sizeof(buf), "%10.3f", s*1e3);
+	return buf;
+}
+
+/*
+Prints every profiled function to 'out', most self time first, as a listing in
+the same form as HELP -vf with each command's count, self and total time (in ms)
+in front of it. Functions no longer in 'lib' are listed without their commands.
+*/
+void profile_report(const clr_profile* prof, const clr_library* lib, std::ostream& out){
+
+	vector<pair<double, string> > order;
+	for (map<string, profile_function>::const_iterator it = prof->functions.begin() ; it != prof->functions.end() ; it++){
+		order.push_back(make_pair(-it->second.self, it->first));
+	}
+	sort(order.begin(), order.end());
+
+	if (order.size() == 0){
+		out << "No interpreted functions have been profiled." << endl;
+		return;
+	}
+
+	for (size_t o = 0 ; o < order.size() ; o++){
+		const profile_function& pf = prof->functions.find(order[o].second)->second;
+		const clr_function* fn = NULL;
+		for (size_t f = 0 ; f < lib->functions.size() ; f++){
+			if (lib->functions[f].name == order[o].second) fn = &lib->functions[f];
+		}
+
+		out << "Function: " << order[o].second << " (" << pf.calls << " calls, self" << ms(pf.self) << " ms, total" << ms(pf.total) << " ms)" << endl;
+		out << "\t     count    self ms   total ms" << endl;
+		for (size_t l = 0 ; l < pf.lines.size() ; l++){
+			char count[32];
+			snprintf(count, sizeof(count), "%10zu", pf.lines[l].count);
+			out << "\t" << count << " " << ms(pf.lines[l].self) << " " << ms(pf.lines[l].total) << "   [" << l << "]: ";
+			if (fn != NULL && l < fn->commands.size()) out << fn->commands[l];
+			out << endl;
+		}
+	}
+}
+
+/*
+Writes one line per call stack to 'path': the stack's function names joined by
+';', a space, and the self time spent in it in microseconds. This is the input
+format of flame graph tools (eg. flamegraph.pl). Returns false and describes the
+problem in 'err' if the file can't be written.
+*/
+bool profile_write_stacks(const clr_profile* prof, std::string path, std::string& err){
+
+	ofstream out(path.c_str());
+	if (!out.is_open()){
+		err = "Failed to create file '" + path + "'.";
+		return false;
+	}
+
+	for (map<string, double>::const_iterator it = prof->stacks.begin() ; it != prof->stacks.end() ; it++){
+		out << it->first << " " << (long long)llround(it->second*1e6) << "\n";
+	}
+
+	return true;
+}
@@ -0,0 +1,96 @@
+/*
+This file declares the profiler for interpreted functions. While it's on (see the
+PROFILE keyword), every call of an interpreted function and every line it runs is
+timed, so the functions and lines which use the most time can be found.
+
+Created by Grant Giesbrecht on 19.10.2026
+
+*/
+
+#include <string>
+#include <vector>
+#include <map>
+#include <chrono>
+#include "clr_types.hpp"
+
+#ifndef CLR_PROFILE_HPP
+#define CLR_PROFILE_HPP
+
+/*
+Counters for one line of a function.
+
+count = Number of times the line ran
+self = Seconds spent on the line, excluding interpreted functions it called
+total = Seconds spent on the line, including interpreted functions it called
+*/
+typedef struct{
+	size_t count;
+	double self;
+	double total;
+}profile_counter;
+
+/*
+Counters for one interpreted function.
+
+calls = Number of times the function was called
+self = Seconds spent in the function's own lines
+total = Seconds from call to return, including nested calls (recursive calls are
+	only counted once, at the outermost call)
+lines = Counters for each of the function's commands
+*/
+typedef struct{
+	size_t calls;
+	double self;
+	double total;
+	std::vector<profile_counter> lines;
+}profile_function;
+
+/*
+A call being timed.
+
+line = Index of the command running in the function
+child = Seconds spent in calls made by the current command
+lines_total = Seconds spent running the function's commands so far. Time spent
+	between commands (eg. lexing and parsing them) is profiler overhead.
+line_overhead = Profiler overhead of calls made by the current command. This is
+	left out of the command's time.
+recursive = True if the function is also further down the stack
+*/
+typedef struct{
+	std::string name;
+	size_t line;
+	std::chrono::steady_clock::time_point start;
+	std::chrono::steady_clock::time_point line_start;
+	double child;
+	double lines_total;
+	double line_overhead;
+	bool recursive;
+}profile_frame;
+
+/*
+A profile. Only the state which turned profiling on records into it - forked
+states are never profiled.
+
+enabled = True while recording
+functions = Counters for each function, by name
+stacks = Self seconds spent in each call stack, as names joined by ';' (eg.
+	"QUAD;SQR"). This is the 'collapsed stack' format of flame graph tools.
+frames = Calls being timed, outermost first
+*/
+struct clr_profile{
+	bool enabled;
+	std::map<std::string, profile_function> functions;
+	std::map<std::string, double> stacks;
+	std::vector<profile_frame> frames;
+};
+
+//Runs interpreted function 'fn' a line at a time, recording each line in 'state's profile
+bool profile_run(const clr_function& fn, clr_state* state, std::string& print_out, size_t& line);
+
+//Prints an annotated listing of every profiled function, most self time first
+void profile_report(const clr_profile* prof, const clr_library* lib, std::ostream& out);
+
+//Writes the profile's call stacks in collapsed stack format (microseconds)
+bool profile_write_stacks(const clr_profile* prof, std::string path, std::string& err);
+
+#endif
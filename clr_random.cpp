@@ -0,0 +1,154 @@
+#include "clr_random.hpp"
+#include "clr_interpret.hpp"
+#include "clr_arrays.hpp"
+#include "clr_parallel.hpp"
+#include <IEGA/string_manip.hpp>
+#include <vector>
+#include <sstream>
+#include <cmath>
+
+using namespace std;
+
+#define PHILOX_M0 0xD2511F53u
+#define PHILOX_M1 0xCD9E8D57u
+#define PHILOX_W0 0x9E3779B9u //Key schedule increments (golden ratio and sqrt(3) - 1)
+#define PHILOX_W1 0xBB67AE85u
+
+/*
+Philox4x32 (Salmon et al., "Parallel random numbers: as easy as 1, 2, 3"). Each
+round multiplies two of the words by constants and mixes the high and low halves
+of the products with the other words and the key, which is bumped every round.
+*/
+void philox4x32(const uint32_t ctr[4], const uint32_t key[2], uint32_t out[4]){
+
+	uint32_t c0 = ctr[0], c1 = ctr[1], c2 = ctr[2], c3 = ctr[3];
+	uint32_t k0 = key[0], k1 = key[1];
+	for (size_t r = 0 ; r < CLR_PHILOX_ROUNDS ; r++){
+		uint64_t p0 = (uint64_t)PHILOX_M0*c0;
+		uint64_t p1 = (uint64_t)PHILOX_M1*c2;
+		uint32_t n0 = (uint32_t)(p1 >> 32) ^ c1 ^ k0;
+		uint32_t n2 = (uint32_t)(p0 >> 32) ^ c3 ^ k1;
+		c0 = n0;
+		c1 = (uint32_t)p1;
+		c2 = n2;
+		c3 = (uint32_t)p0;
+		k0 += PHILOX_W0;
+		k1 += PHILOX_W1;
+	}
+	out[0] = c0;
+	out[1] = c1;
+	out[2] = c2;
+	out[3] = c3;
+}
+
+/*
+Computes the block for draw 'k' of 'rng's stream. The counter is the draw and
+the stream, and the key is the seed.
+*/
+static void draw_block(const clr_rng* rng, uint64_t k, uint32_t out[4]){
+	uint32_t ctr[4] = {(uint32_t)k, (uint32_t)(k >> 32), (uint32_t)rng->stream, (uint32_t)(rng->stream >> 32)};
+	uint32_t key[2] = {(uint32_t)rng->seed, (uint32_t)(rng->seed >> 32)};
+	philox4x32(ctr, key, out);
+}
+
+/*
+Returns a double uniform on [0, 1) made from the 53 high bits of 'hi' and 'lo'.
+*/
+static inline double to_unit(uint32_t hi, uint32_t lo){
+	return ((hi >> 5)*67108864.0 + (lo >> 6))*(1.0/9007199254740992.0);
+}
+
+double rng_uniform(const clr_rng* rng, uint64_t k){
+	uint32_t b[4];
+	draw_block(rng, k, b);
+	return to_unit(b[0], b[1]);
+}
+
+/*
+Box-Muller transform of the two uniforms in the draw's block.
+*/
+double rng_normal(const clr_rng* rng, uint64_t k){
+	uint32_t b[4];
+	draw_block(rng, k, b);
+	double u1 = 1.0 - to_unit(b[0], b[1]); //(0, 1], so the log is finite
+	double u2 = to_unit(b[2], b[3]);
+	return sqrt(-2*log(u1))*cos(2*M_PI*u2);
+}
+
+/*
+Fills 'out' with the next 'n' draws of 'rng's stream, in parallel. Element k is
+draw counter+k of the stream whichever thread computes it, so the array is the
+same for any number of threads.
+*/
+void rng_fill(clr_rng* rng, bool normal, comp* out, size_t n){
+	const clr_rng r = *rng;
+	parallel_for(n, CLR_RANDOM_GRAIN, [&](size_t begin, size_t end, size_t thread){
+		for (size_t k = begin ; k < end ; k++){
+			out[k] = comp(normal ? rng_normal(&r, r.counter + k) : rng_uniform(&r, r.counter + k), 0);
+		}
+	});
+	rng->counter += n;
+}
+
+/*
+Runs 'f' once per sample and accumulates the results in 'out'. Sample i is
+called with {x} = i and draws its random numbers (see RAND and RANDN) from
+stream i+1 of 'state's seed (stream 0 is the interpreter's own), so every sample
+is independent of which thread runs it and of the others.
+
+Each sample starts from a fresh copy of the same fork of 'state', so variables
+a sample stores (or any other change it makes) are not seen by the samples run
+after it on the same thread. Resetting the copy is cheap because the variable
+table and library are shared until a sample writes to them. Whatever the samples
+print goes to a buffer per thread, and the buffers are written to 'state's output
+in order afterwards, so threads never share a stream.
+
+The samples are split into blocks of CLR_MC_BLOCK, which are run in parallel,
+accumulated separately and then merged in order. So the result is the same, to
+the last bit, for any number of threads. Returns false and describes the problem
+in 'err' if the function fails or returns anything but a finite real number.
+*/
+bool monte_carlo(const clr_callable& f, const clr_state* state, size_t samples, clr_welford& out, std::string& err){
+
+	size_t blocks = (samples + CLR_MC_BLOCK - 1)/CLR_MC_BLOCK;
+	const clr_state start = fork_state(state);
+	vector<clr_state> works(parallel_threads(), start);
+	vector<clr_welford> sums(blocks);
+	vector<string> errs(works.size());
+	vector<char> failed(works.size(), 0);
+	vector<ostringstream> outs(works.size());
+	parallel_for(blocks, 1, [&](size_t begin, size_t end, size_t thread){
+		clr_state& work = works[thread];
+		for (size_t b = begin ; b < end ; b++){
+			welford_reset(sums[b]);
+			for (size_t i = b*CLR_MC_BLOCK ; i < samples && i < (b+1)*CLR_MC_BLOCK ; i++){
+				work = start;
+				work.out = &outs[thread];
+				work.rng.stream = i+1;
+				work.rng.counter = 0;
+				comp fx;
+				if (!call_callable(f, &work, comp((double)i, 0), fx, errs[thread])){
+					failed[thread] = 1;
+					return;
+				}
+				if (fx.imag() != 0 || !std::isfinite(fx.real())){
+					errs[thread] = "Function '" + f.name + "' returned " + valuestr(clr_value(fx)) + " for sample " + to_string(i) + ", but a finite real number was expected.";
+					failed[thread] = 1;
+					return;
+				}
+				welford_add(sums[b], fx.real());
+			}
+		}
+	});
+	for (size_t t = 0 ; t < works.size() ; t++) *state->out << outs[t].str();
+	for (size_t t = 0 ; t < works.size() ; t++){
+		if (failed[t]){
+			err = errs[t];
+			return false;
+		}
+	}
+
+	welford_reset(out);
+	for (size_t b = 0 ; b < blocks ; b++) welford_merge(out, sums[b]);
+	return true;
+}
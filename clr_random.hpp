@@ -0,0 +1,42 @@
+/*
+This file declares CLR's random numbers. They come from Philox4x32-10, a
+counter-based generator: each number is a function of the seed, a stream
+number and its position in the stream, rather than of a running state. So any
+draw can be computed independently of the others. Arrays are filled (and Monte
+Carlo samples drawn) in parallel and still come out the same for any number of
+threads.
+
+Created by Grant Giesbrecht on 19.10.2026
+
+*/
+
+#include <stdint.h>
+#include <string>
+#include "clr_types.hpp"
+#include "clr_callable.hpp"
+#include "clr_stats.hpp"
+
+#ifndef CLR_RANDOM_HPP
+#define CLR_RANDOM_HPP
+
+#define CLR_PHILOX_ROUNDS 10
+#define CLR_RANDOM_GRAIN 4096 //Min numbers per thread when filling an array
+#define CLR_MC_SAMPLES 10000 //Default number of Monte Carlo samples
+#define CLR_MC_BLOCK 1024 //Samples per block. Blocks are the unit of work and of summing.
+
+//Computes the Philox4x32-10 block for 'ctr' and 'key'
+void philox4x32(const uint32_t ctr[4], const uint32_t key[2], uint32_t out[4]);
+
+//Returns draw 'k' of 'rng's stream, uniform on [0, 1)
+double rng_uniform(const clr_rng* rng, uint64_t k);
+
+//Returns draw 'k' of 'rng's stream, normally distributed with mean 0 and variance 1
+double rng_normal(const clr_rng* rng, uint64_t k);
+
+//Fills 'out' with the next 'n' draws of 'rng's stream (in parallel) and advances it
+void rng_fill(clr_rng* rng, bool normal, comp* out, size_t n);
+
+//Runs 'f' on 'samples' samples, each with its own random stream, and accumulates the results
+bool monte_carlo(const clr_callable& f, const clr_state* state, size_t samples, clr_welford& out, std::string& err);
+
+#endif
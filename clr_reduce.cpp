@@ -0,0 +1,259 @@
+#include "clr_reduce.hpp"
+#include "clr_parallel.hpp"
+#include <vector>
+#include <cmath>
+
+using namespace std;
+
+/*
+The reductions below read arrays of 'comp' as interleaved doubles (real, imag),
+which std::complex guarantees. Each block loop keeps eight independent
+accumulators so the compiler can keep them in vector registers without having
+to reorder floating point additions itself.
+
+Blocks are combined by pairwise summation: the range is halved until it's at
+most CLR_REDUCE_BLOCK values, so rounding error grows with log(n) rather than n.
+Large arrays are split across threads first (see parallel_reduce), and the
+threads' results are added in order.
+*/
+
+/*
+Sums the 'n' complex values in 'd'.
+*/
+static comp sum_block(const double* d, size_t n){
+	double a[8] = {0, 0, 0, 0, 0, 0, 0, 0};
+	size_t k = 0;
+	for ( ; k + 4 <= n ; k += 4){
+		for (size_t j = 0 ; j < 8 ; j++) a[j] += d[2*k+j];
+	}
+	for ( ; k < n ; k++){
+		a[0] += d[2*k];
+		a[1] += d[2*k+1];
+	}
+	return comp((a[0] + a[2]) + (a[4] + a[6]), (a[1] + a[3]) + (a[5] + a[7]));
+}
+
+/*
+Sums the squared magnitudes of the 'n' complex values in 'd'.
+*/
+static double sumsq_block(const double* d, size_t n){
+	double a[8] = {0, 0, 0, 0, 0, 0, 0, 0};
+	size_t k = 0;
+	for ( ; k + 4 <= n ; k += 4){
+		for (size_t j = 0 ; j < 8 ; j++) a[j] += d[2*k+j]*d[2*k+j];
+	}
+	for ( ; k < n ; k++){
+		a[0] += d[2*k]*d[2*k] + d[2*k+1]*d[2*k+1];
+	}
+	return ((a[0] + a[1]) + (a[2] + a[3])) + ((a[4] + a[5]) + (a[6] + a[7]));
+}
+
+/*
+Sums y[k]*x[k] for the 'n' complex values in 'y' and 'x'.
+*/
+static comp dot_block(const double* y, const double* x, size_t n){
+	double re[4] = {0, 0, 0, 0};
+	double im[4] = {0, 0, 0, 0};
+	size_t k = 0;
+	for ( ; k + 4 <= n ; k += 4){
+		for (size_t j = 0 ; j < 4 ; j++){
+			double yr = y[2*(k+j)], yi = y[2*(k+j)+1];
+			double xr = x[2*(k+j)], xi = x[2*(k+j)+1];
+			re[j] += yr*xr - yi*xi;
+			im[j] += yr*xi + yi*xr;
+		}
+	}
+	for ( ; k < n ; k++){
+		re[0] += y[2*k]*x[2*k] - y[2*k+1]*x[2*k+1];
+		im[0] += y[2*k]*x[2*k+1] + y[2*k+1]*x[2*k];
+	}
+	return comp((re[0] + re[1]) + (re[2] + re[3]), (im[0] + im[1]) + (im[2] + im[3]));
+}
+
+static comp pairwise_sum(const double* d, size_t n){
+	if (n <= CLR_REDUCE_BLOCK) return sum_block(d, n);
+	size_t h = n/2;
+	return pairwise_sum(d, h) + pairwise_sum(d + 2*h, n - h);
+}
+
+static double pairwise_sumsq(const double* d, size_t n){
+	if (n <= CLR_REDUCE_BLOCK) return sumsq_block(d, n);
+	size_t h = n/2;
+	return pairwise_sumsq(d, h) + pairwise_sumsq(d + 2*h, n - h);
+}
+
+static comp pairwise_dot(const double* y, const double* x, size_t n){
+	if (n <= CLR_REDUCE_BLOCK) return dot_block(y, x, n);
+	size_t h = n/2;
+	return pairwise_dot(y, x, h) + pairwise_dot(y + 2*h, x + 2*h, n - h);
+}
+
+/*
+Returns the index of the value in d[begin, end) with the smallest (or largest if
+'largest') real part. Ties go to the first. NaNs are only returned if every
+value is NaN.
+*/
+static size_t extreme_index(const comp* d, size_t begin, size_t end, bool largest){
+	size_t best = begin;
+	double best_re = d[begin].real();
+	for (size_t k = begin + 1 ; k < end ; k++){
+		double re = d[k].real();
+		if ((largest ? re > best_re : re < best_re) || (best_re != best_re)){
+			best = k;
+			best_re = re;
+		}
+	}
+	return best;
+}
+
+/*
+Splits [0, n) into per-thread ranges, calls part(begin, end) for each and adds
+the results in order. The result is the same for a given number of threads.
+*/
+template <typename T>
+static T parallel_reduce(size_t n, const std::function<T(size_t, size_t)>& part){
+	vector<T> partials(parallel_threads(), T(0));
+	parallel_for(n, CLR_REDUCE_GRAIN, [&](size_t begin, size_t end, size_t thread){
+		partials[thread] = part(begin, end);
+	});
+	T total = T(0);
+	for (size_t p = 0 ; p < partials.size() ; p++) total += partials[p];
+	return total;
+}
+
+/*
+Reduces 'x' (and 'y' for REDUCE_DOT) to a number and writes it to 'out'. A
+number in 'x' behaves like an array of one value, except that DOT pairs a number
+with every value of an array in the other register.
+
+Returns false (and describes the problem in 'err') for MEAN, MIN or MAX of an
+empty array or DOT of arrays of different lengths.
+*/
+bool reduce_value(reduce_op op, const clr_value& x, const clr_value& y, comp& out, std::string& err){
+
+	const comp* data = x.arr ? x.arr->data : &x.num;
+	size_t n = x.arr ? x.arr->length : 1;
+	const double* d = reinterpret_cast<const double*>(data);
+
+	switch(op){
+		case REDUCE_SUM:
+		case REDUCE_MEAN:
+			if (op == REDUCE_MEAN && n == 0){
+				err = "Can not take the mean of an empty array.";
+				return false;
+			}
+			out = parallel_reduce<comp>(n, [&](size_t begin, size_t end){
+				return pairwise_sum(d + 2*begin, end - begin);
+			});
+			if (op == REDUCE_MEAN) out /= (double)n;
+			return true;
+		case REDUCE_NORM:
+			out = sqrt(parallel_reduce<double>(n, [&](size_t begin, size_t end){
+				return pairwise_sumsq(d + 2*begin, end - begin);
+			}));
+			return true;
+		case REDUCE_MIN:
+		case REDUCE_MAX:{
+			if (n == 0){
+				err = "Can not find the extreme of an empty array.";
+				return false;
+			}
+			bool largest = (op == REDUCE_MAX);
+			vector<size_t> partials(parallel_threads(), -1);
+			parallel_for(n, CLR_REDUCE_GRAIN, [&](size_t begin, size_t end, size_t thread){
+				partials[thread] = extreme_index(data, begin, end, largest);
+			});
+			size_t best = partials[0];
+			for (size_t p = 1 ; p < partials.size() && partials[p] != (size_t)-1 ; p++){
+				double re = data[partials[p]].real(), best_re = data[best].real();
+				if ((largest ? re > best_re : re < best_re) || (best_re != best_re)) best = partials[p];
+			}
+			out = data[best];
+			return true;
+		}
+		case REDUCE_DOT:{
+			if (!x.arr && !y.arr){
+				out = y.num*x.num;
+				return true;
+			}
+			if (!x.arr || !y.arr){ //A number times every value of an array
+				const clr_value& a = x.arr ? x : y;
+				const double* ad = reinterpret_cast<const double*>(a.arr->data);
+				out = (x.arr ? y.num : x.num) * parallel_reduce<comp>(a.arr->length, [&](size_t begin, size_t end){
+					return pairwise_sum(ad + 2*begin, end - begin);
+				});
+				return true;
+			}
+			if (x.arr->length != y.arr->length){
+				err = "Array lengths do not match (" + to_string(y.arr->length) + " and " + to_string(x.arr->length) + ").";
+				return false;
+			}
+			const double* yd = reinterpret_cast<const double*>(y.arr->data);
+			out = parallel_reduce<comp>(n, [&](size_t begin, size_t end){
+				return pairwise_dot(yd + 2*begin, d + 2*begin, end - begin);
+			});
+			return true;
+		}
+	}
+
+	return false;
+}
+
+/*
+Adds the values in 'x' to the statistics registers 's' (or takes them out if
+'remove'). If 'y' is not NULL, each value of 'x' and the value at the same
+place in 'y' are also added as a pair. A number behaves like an array of one
+value.
+
+Arrays are split into blocks of CLR_SIGMA_BLOCK, which are accumulated in
+parallel and merged in order, so the result doesn't depend on the number of
+threads. Returns false (and leaves 's' unchanged) if a value isn't real or the
+shapes of 'x' and 'y' don't match.
+*/
+bool sigma_update(clr_sigma& s, const clr_value& x, const clr_value* y, bool remove, std::string& err){
+
+	const comp* xd = x.arr ? x.arr->data : &x.num;
+	size_t n = x.arr ? x.arr->length : 1;
+	const comp* yd = NULL;
+	if (y != NULL){
+		if ((bool)y->arr != (bool)x.arr || (x.arr && y->arr->length != n)){
+			err = "{x} and {y} must both be numbers or arrays of the same length to form pairs.";
+			return false;
+		}
+		yd = y->arr ? y->arr->data : &y->num;
+	}
+
+	size_t blocks = (n + CLR_SIGMA_BLOCK - 1)/CLR_SIGMA_BLOCK;
+	vector<clr_sigma> parts(blocks);
+	vector<char> complex(blocks, 0);
+	parallel_for(blocks, 1, [&](size_t begin, size_t end, size_t thread){
+		for (size_t b = begin ; b < end ; b++){
+			sigma_reset(parts[b]);
+			for (size_t k = b*CLR_SIGMA_BLOCK ; k < n && k < (b+1)*CLR_SIGMA_BLOCK ; k++){
+				if (xd[k].imag() != 0 || (yd != NULL && yd[k].imag() != 0)) complex[b] = 1;
+				welford_add(parts[b].x, xd[k].real());
+				if (yd != NULL) covariance_add(parts[b].xy, xd[k].real(), yd[k].real());
+			}
+		}
+	});
+
+	clr_sigma batch;
+	sigma_reset(batch);
+	for (size_t b = 0 ; b < blocks ; b++){
+		if (complex[b]){
+			err = "The statistics registers only accept real numbers.";
+			return false;
+		}
+		welford_merge(batch.x, parts[b].x);
+		covariance_merge(batch.xy, parts[b].xy);
+	}
+
+	if (remove){
+		welford_unmerge(s.x, batch.x);
+		covariance_unmerge(s.xy, batch.xy);
+	}else{
+		welford_merge(s.x, batch.x);
+		covariance_merge(s.xy, batch.xy);
+	}
+	return true;
+}
@@ -0,0 +1,37 @@
+/*
+This file declares reductions, which collapse an array register value to a
+single number (eg. its sum).
+
+Created by Grant Giesbrecht on 19.10.2026
+
+*/
+
+#include <string>
+#include "clr_types.hpp"
+
+#ifndef CLR_REDUCE_HPP
+#define CLR_REDUCE_HPP
+
+#define CLR_REDUCE_BLOCK 256 //Values summed directly at the bottom of the pairwise recursion
+#define CLR_REDUCE_GRAIN (1 << 16) //Min values per thread in a parallel reduction
+#define CLR_SIGMA_BLOCK (1 << 16) //Values accumulated separately (then merged) when feeding the statistics registers
+
+/*
+Kinds of reduction.
+*/
+enum reduce_op{
+	REDUCE_SUM, //Sum of the values
+	REDUCE_MEAN, //Mean of the values
+	REDUCE_MIN, //Value with the smallest real part
+	REDUCE_MAX, //Value with the largest real part
+	REDUCE_NORM, //Euclidean norm, sqrt(sum |v|^2)
+	REDUCE_DOT //Sum of y[k]*x[k]
+};
+
+//Reduces 'x' (and 'y' for REDUCE_DOT) to a number
+bool reduce_value(reduce_op op, const clr_value& x, const clr_value& y, comp& out, std::string& err);
+
+//Adds the values in 'x' (and the pairs they form with 'y' if not NULL) to 's', or takes them out if 'remove'
+bool sigma_update(clr_sigma& s, const clr_value& x, const clr_value* y, bool remove, std::string& err);
+
+#endif
@@ -0,0 +1,243 @@
+#include "clr_reload.hpp"
+#include "clr_interpret.hpp"
+#include "clr_compile.hpp"
+#include "clr_keywords.hpp"
+#include <iostream>
+#include <vector>
+#include <set>
+#include <cstring>
+#include <cerrno>
+#include <climits>
+#include <cstdlib>
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+#ifdef __linux__
+
+/*
+Returns the absolute path of 'path' with its directory resolved (following
+symbolic links), so paths written differently compare equal. The file itself
+need not exist.
+*/
+static string absolute_path(const string& path){
+
+	size_t slash = path.find_last_of('/');
+	string dir = (slash == string::npos) ? "." : ((slash == 0) ? "/" : path.substr(0, slash));
+	string base = (slash == string::npos) ? path : path.substr(slash+1);
+
+	char buf[PATH_MAX];
+	if (realpath(dir.c_str(), buf) == NULL) return path;
+	string out = buf;
+	if (out[out.length()-1] != '/') out = out + "/";
+	return out + base;
+}
+
+/*
+Watches the file at 'path' (which is loaded as 'path'). Editors often save by
+writing a new file and renaming it over the old one, so the file's directory is
+watched rather than the file itself. Returns false if the directory can't be
+watched.
+*/
+static bool watch_file(clr_reload* rl, const string& path, string& err){
+
+	string abs = absolute_path(path);
+	string dir = abs.substr(0, abs.find_last_of('/'));
+	if (dir == "") dir = "/";
+
+	bool watched = false;
+	for (map<int, string>::iterator it = rl->dirs.begin() ; it != rl->dirs.end() ; it++){
+		if (it->second == dir) watched = true;
+	}
+	if (!watched){
+		int wd = inotify_add_watch(rl->fd, dir.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_DELETE);
+		if (wd < 0){
+			err = "Failed to watch directory '" + dir + "' (" + strerror(errno) + ").";
+			return false;
+		}
+		rl->dirs[wd] = dir;
+	}
+
+	rl->files[abs] = path;
+	return true;
+}
+
+/*
+Creates the inotify instance and watches the list file and every function file
+it names. Returns false and describes the problem in 'err' if any of them can't be
+watched.
+*/
+bool reload_open(std::string list_path, std::string default_dir, clr_reload* rl, std::string& err){
+
+	rl->list_path = list_path;
+	rl->default_dir = default_dir;
+	rl->dirs.clear();
+	rl->files.clear();
+	rl->fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (rl->fd < 0){
+		err = string("Failed to start inotify (") + strerror(errno) + ").";
+		return false;
+	}
+
+	vector<string> files;
+	read_function_list(list_path, default_dir, files);
+	files.push_back(list_path);
+	for (size_t f = 0 ; f < files.size() ; f++){
+		if (!watch_file(rl, files[f], err)){
+			reload_close(rl);
+			return false;
+		}
+	}
+
+	return true;
+}
+
+/*
+Returns the index in 'lib' of the function loaded from 'path', or -1 if there is
+none.
+*/
+static long source_index(const clr_library* lib, const string& path){
+	for (size_t f = 0 ; f < lib->functions.size() ; f++){
+		if (lib->functions[f].interpreted && lib->functions[f].source == path) return f;
+	}
+	return -1;
+}
+
+/*
+Reads the function file at 'path' again and replaces (or adds, or removes if the
+file is gone) its function in 'lib'. If the file exists but can't be read as a
+function, the previous version is kept. What was done is printed to 'out'.
+*/
+static void reload_file(clr_library* lib, const string& path, std::ostream& out){
+
+	long idx = source_index(lib, path);
+	clr_function fn;
+	string reserved;
+	bool loaded = load_function_file(path, fn);
+	if (loaded && reserved_name(fn.name, reserved)){
+		out << "Warning: Failed to reload '" << path << "'. " << reserved << " Keeping the previous version." << endl;
+	}else if (loaded){
+		if (idx == -1){
+			lib->functions.push_back(fn);
+		}else{
+			lib->functions[idx] = fn;
+		}
+		out << "Reloaded function '" << fn.name << "' from '" << path << "'." << endl;
+	}else if (access(path.c_str(), F_OK) != 0){
+		if (idx != -1){
+			out << "Removed function '" << lib->functions[idx].name << "' ('" << path << "' was deleted)." << endl;
+			lib->functions.erase(lib->functions.begin() + idx);
+		}
+	}else{
+		out << "Warning: Failed to reload '" << path << "'. Keeping the previous version." << endl;
+	}
+}
+
+/*
+Reads the pending inotify events and reloads the functions whose files changed.
+If the list file changed, functions no longer listed are removed and newly listed
+files are loaded and watched. Only changed files are read, and the library is
+only copied (see writable_library) when something changed, so states holding the
+old library keep a consistent copy. Functions are compiled again afterwards.
+
+This never blocks - call it between commands. Returns true if anything was
+reloaded.
+*/
+bool reload_poll(clr_reload* rl, clr_state* state){
+
+	if (rl->fd < 0) return false;
+
+	//Collect changed files
+	set<string> changed;
+	char buf[CLR_RELOAD_BUFFER] __attribute__((aligned(__alignof__(struct inotify_event))));
+	while (true){
+		ssize_t len = read(rl->fd, buf, sizeof(buf));
+		if (len <= 0) break;
+		for (char* p = buf ; p < buf + len ; p += sizeof(struct inotify_event) + ((struct inotify_event*)p)->len){
+			const struct inotify_event* ev = (const struct inotify_event*)p;
+			if (ev->len == 0 || rl->dirs.count(ev->wd) == 0) continue;
+			string abs = rl->dirs[ev->wd] + ((rl->dirs[ev->wd] == "/") ? "" : "/") + ev->name;
+			if (rl->files.count(abs) > 0) changed.insert(abs);
+		}
+	}
+	if (changed.size() == 0) return false;
+
+	clr_library* lib = writable_library(state);
+	string list_abs = absolute_path(rl->list_path);
+
+	//Apply changes to the list
+	set<string> reload;
+	if (changed.count(list_abs) > 0){
+		vector<string> files;
+		if (!read_function_list(rl->list_path, rl->default_dir, files)){
+			*state->out << "Warning: Failed to read function list '" << rl->list_path << "'. Keeping the current functions." << endl;
+		}else{
+			set<string> listed(files.begin(), files.end());
+			for (map<string, string>::iterator it = rl->files.begin() ; it != rl->files.end() ; ){
+				if (it->first != list_abs && listed.count(it->second) == 0){
+					rl->files.erase(it++);
+				}else{
+					it++;
+				}
+			}
+			for (size_t f = lib->functions.size() ; f-- > 0 ; ){
+				const clr_function& fn = lib->functions[f];
+				if (fn.interpreted && fn.source != "" && listed.count(fn.source) == 0){
+					*state->out << "Removed function '" << fn.name << "' (no longer listed)." << endl;
+					lib->functions.erase(lib->functions.begin() + f);
+				}
+			}
+			for (size_t f = 0 ; f < files.size() ; f++){
+				if (source_index(lib, files[f]) != -1) continue;
+				string err;
+				if (!watch_file(rl, files[f], err)) *state->out << "Warning: " << err << endl;
+				reload.insert(files[f]);
+			}
+		}
+	}
+
+	//Reload changed functions
+	for (set<string>::iterator it = changed.begin() ; it != changed.end() ; it++){
+		if (*it != list_abs && rl->files.count(*it) > 0) reload.insert(rl->files[*it]);
+	}
+	for (set<string>::iterator it = reload.begin() ; it != reload.end() ; it++){
+		reload_file(lib, *it, *state->out);
+	}
+
+	compile_functions(state); //Changed functions may be inlined into others
+
+	return true;
+}
+
+/*
+Stops watching and releases the inotify instance.
+*/
+void reload_close(clr_reload* rl){
+	if (rl->fd >= 0) close(rl->fd);
+	rl->fd = -1;
+	rl->dirs.clear();
+	rl->files.clear();
+}
+
+#else
+
+bool reload_open(std::string list_path, std::string default_dir, clr_reload* rl, std::string& err){
+	rl->list_path = list_path;
+	rl->default_dir = default_dir;
+	rl->fd = -1;
+	return true;
+}
+
+bool reload_poll(clr_reload* rl, clr_state* state){
+	return false;
+}
+
+void reload_close(clr_reload* rl){
+	rl->fd = -1;
+}
+
+#endif
@@ -0,0 +1,50 @@
+/*
+This file declares hot reloading of interpreted functions. The function list and
+the directories of the .clrf files it names are watched with inotify, and when a
+file changes only that file is read again and its function replaced, so edits
+are picked up without restarting CLR (which would lose registers and variables).
+
+Hot reloading needs inotify and so only works on Linux. Elsewhere the functions
+below do nothing.
+
+Created by Grant Giesbrecht on 19.10.2026
+
+*/
+
+#include <string>
+#include <map>
+#include "clr_types.hpp"
+
+#ifndef CLR_RELOAD_HPP
+#define CLR_RELOAD_HPP
+
+#define CLR_RELOAD_BUFFER 4096 //Bytes of inotify events read at a time
+
+/*
+Files being watched for changes.
+
+list_path = Function list file, as given to load_functions
+default_dir = Directory $(DEFAULT_DIR) stands for in the list
+fd = inotify file descriptor, or -1 if not watching
+dirs = Watched directories (absolute), by inotify watch descriptor
+files = Watched files, as an absolute path mapped to the path they are loaded from
+	(the list file and each .clrf file in it)
+*/
+typedef struct{
+	std::string list_path;
+	std::string default_dir;
+	int fd;
+	std::map<int, std::string> dirs;
+	std::map<std::string, std::string> files;
+}clr_reload;
+
+//Starts watching the function list at 'list_path' and every file it names
+bool reload_open(std::string list_path, std::string default_dir, clr_reload* rl, std::string& err);
+
+//Reloads any functions whose files changed since the last call. Returns true if any were
+bool reload_poll(clr_reload* rl, clr_state* state);
+
+//Stops watching
+void reload_close(clr_reload* rl);
+
+#endif
@@ -0,0 +1,200 @@
+#include "clr_root.hpp"
+#include "clr_arrays.hpp"
+#include <IEGA/string_manip.hpp>
+#include <cmath>
+#include <cfloat>
+#include <algorithm>
+
+using namespace std;
+
+/*
+A root search in progress.
+
+f = Function being solved
+state = State the function runs in
+evals = Function evaluations so far
+max_evals = Max function evaluations
+best = Point with the smallest |f| seen so far
+best_f = |f| at 'best'
+*/
+typedef struct{
+	const clr_callable* f;
+	clr_state* state;
+	size_t evals;
+	size_t max_evals;
+	comp best;
+	double best_f;
+}root_job;
+
+/*
+Evaluates the function at 'x' into 'fx', counting the evaluation. Returns false
+and describes the problem in 'err' if the function fails or the search has run
+out of evaluations.
+*/
+static bool eval(root_job& job, comp x, comp& fx, std::string& err){
+
+	if (job.evals >= job.max_evals){
+		err = "No root of '" + job.f->name + "' found within " + to_string(job.max_evals) + " evaluations. ";
+		err = err + "Closest point: " + valuestr(clr_value(job.best)) + " (|f| = " + dtos(job.best_f, 6, 3) + ").";
+		return false;
+	}
+	job.evals++;
+
+	if (!call_callable(*job.f, job.state, x, fx, err)) return false;
+	if (abs(fx) < job.best_f){
+		job.best = x;
+		job.best_f = abs(fx);
+	}
+	return true;
+}
+
+/*
+Returns true if 'a' is worse than 'b' as an estimate of zero. Infinities and
+NaNs are worse than anything.
+*/
+static bool worse(comp a, comp b){
+	double aa = abs(a);
+	return !std::isfinite(aa) || aa > abs(b);
+}
+
+/*
+Brent's method on the bracket [a, b] (f(a) and f(b) have opposite signs). Each
+step takes the inverse quadratic (or secant) step if it lands well inside the
+bracket and shrinks it fast enough, and bisects otherwise, so it always
+converges. The function's imaginary part is ignored inside the bracket.
+*/
+static bool brent(root_job& job, double a, double b, double fa, double fb, double tol, comp& root, std::string& err){
+
+	double c = b, fc = fb;
+	double d = b - a, e = d;
+	while (true){
+		if ((fb > 0 && fc > 0) || (fb < 0 && fc < 0)){
+			c = a;
+			fc = fa;
+			d = b - a;
+			e = d;
+		}
+		if (fabs(fc) < fabs(fb)){
+			a = b;
+			b = c;
+			c = a;
+			fa = fb;
+			fb = fc;
+			fc = fa;
+		}
+
+		double tol1 = 2*DBL_EPSILON*fabs(b) + 0.5*tol*max(1.0, fabs(b));
+		double xm = 0.5*(c - b);
+		if (fabs(xm) <= tol1 || fb == 0){
+			root = b;
+			return true;
+		}
+
+		if (fabs(e) >= tol1 && fabs(fa) > fabs(fb)){
+			double s = fb/fa, p, q;
+			if (a == c){ //Secant
+				p = 2*xm*s;
+				q = 1 - s;
+			}else{ //Inverse quadratic interpolation
+				double r = fb/fc;
+				q = fa/fc;
+				p = s*(2*xm*q*(q - r) - (b - a)*(r - 1));
+				q = (q - 1)*(r - 1)*(s - 1);
+			}
+			if (p > 0) q = -q;
+			p = fabs(p);
+			if (2*p < min(3*xm*q - fabs(tol1*q), fabs(e*q))){
+				e = d;
+				d = p/q;
+			}else{ //Interpolation failed - bisect
+				d = xm;
+				e = d;
+			}
+		}else{ //Bracket is shrinking too slowly - bisect
+			d = xm;
+			e = d;
+		}
+
+		a = b;
+		fa = fb;
+		b += (fabs(d) > tol1) ? d : ((xm > 0) ? tol1 : -tol1);
+		comp fz;
+		if (!eval(job, b, fz, err)) return false;
+		fb = fz.real();
+	}
+}
+
+/*
+Finds a zero of 'f' near 'x0' and writes it to 'root'. The search stops when a
+step is smaller than 'tol' (relative to max(1, |root|)), and fails if it needs
+more than 'max_evals' evaluations of 'f'.
+
+The first step is a Newton step with the derivative estimated from a second point
+very close to 'x0'. After that each step is a secant step through the last two
+points, which converges almost as fast as Newton's method without evaluating a
+derivative. A step which makes |f| larger is halved (up to CLR_ROOT_BACKTRACK
+times) so the search doesn't run away from a root it's near. If the points and
+function values are real and the function changes sign between the last two
+points, the search switches to Brent's method on that bracket.
+
+Returns false and describes the problem in 'err' if the function fails, is flat
+at a point or no root is found.
+*/
+bool find_root(const clr_callable& f, clr_state* state, comp x0, double tol, size_t max_evals, comp& root, std::string& err){
+
+	root_job job;
+	job.f = &f;
+	job.state = state;
+	job.evals = 0;
+	job.max_evals = max_evals;
+	job.best = x0;
+	job.best_f = INFINITY;
+
+	comp a = x0, fa;
+	if (!eval(job, a, fa, err)) return false;
+	comp b = a + sqrt(DBL_EPSILON)*max(1.0, abs(a)), fb;
+	if (!eval(job, b, fb, err)) return false;
+
+	while (true){
+
+		if (fa == comp(0, 0)){
+			root = a;
+			return true;
+		}
+		if (fb == comp(0, 0)){
+			root = b;
+			return true;
+		}
+
+		//Real bracket found - switch to Brent's method
+		bool real = a.imag() == 0 && b.imag() == 0 && fa.imag() == 0 && fb.imag() == 0;
+		if (real && (fa.real() < 0) != (fb.real() < 0)){
+			return brent(job, a.real(), b.real(), fa.real(), fb.real(), tol, root, err);
+		}
+
+		comp df = fb - fa;
+		if (df == comp(0, 0) || !std::isfinite(abs(df))){
+			err = "Function '" + f.name + "' is flat near " + valuestr(clr_value(b)) + ", so ROOT can't find a step.";
+			return false;
+		}
+
+		//Secant step, halved while it makes |f| larger
+		comp step = -fb*(b - a)/df;
+		comp c = b + step, fc;
+		if (!eval(job, c, fc, err)) return false;
+		for (size_t k = 0 ; k < CLR_ROOT_BACKTRACK && worse(fc, fb) ; k++){
+			step /= 2.0;
+			c = b + step;
+			if (!eval(job, c, fc, err)) return false;
+		}
+
+		a = b;
+		fa = fb;
+		b = c;
+		fb = fc;
+		if (abs(step) <= tol*max(1.0, abs(b))){
+			root = b;
+			return true;
+		}
+	}
+}
@@ -0,0 +1,25 @@
+/*
+This file declares the root finder used by ROOT. It finds a zero of a function
+near a starting point with secant steps (which also work for complex roots), and
+switches to Brent's method, which always converges, as soon as a real function
+changes sign between two points.
+
+Created by Grant Giesbrecht on 19.10.2026
+
+*/
+
+#include <string>
+#include "clr_types.hpp"
+#include "clr_callable.hpp"
+
+#ifndef CLR_ROOT_HPP
+#define CLR_ROOT_HPP
+
+#define CLR_ROOT_DIGITS 12 //Default number of correct digits (tolerance 10^-digits, relative to max(1, |root|))
+#define CLR_ROOT_MAX_EVALS 100 //Default max function evaluations
+#define CLR_ROOT_BACKTRACK 8 //Max times a secant step is halved when it makes |f| larger
+
+//Finds a zero of 'f' near 'x0', evaluating it in 'state' at most 'max_evals' times
+bool find_root(const clr_callable& f, clr_state* state, comp x0, double tol, size_t max_evals, comp& root, std::string& err);
+
+#endif
@@ -0,0 +1,217 @@
+#include "clr_sched.hpp"
+#include "clr_interpret.hpp"
+
+using namespace std;
+
+static thread_local clr_job* starting_job = NULL; //Job being started, read by job_main
+
+/*
+Runs a job's lines. This is the bottom of the job's coroutine stack, and returning
+from it goes back to the worker (through the context's uc_link).
+*/
+static void job_main(){
+
+	clr_job* job = starting_job;
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	string print_out;
+	for (size_t l = 0 ; l < job->lines.size() && job->state->running && job->err == "" ; l++){
+		try{
+			if (!interpret_clr(job->lines[l], job->state, print_out)) job->failed++;
+			*job->state->out << print_out;
+		}catch (const std::exception& e){ //Nothing may unwind past this function
+			*job->state->out << "ERROR: " << e.what() << endl;
+			job->failed++;
+		}
+		job->line_us.push_back(std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count());
+	}
+	job->state->job = NULL;
+	job->finished = true;
+}
+
+/*
+Returns false and describes why in 'err' if 'job' has been cancelled or has
+passed its deadline.
+*/
+static bool job_may_run(clr_job* job, std::string& err){
+	if (job->cancel.load(std::memory_order_relaxed)){
+		err = "Cancelled.";
+		return false;
+	}
+	if (std::chrono::steady_clock::now() > job->deadline){
+		err = "Deadline exceeded.";
+		return false;
+	}
+	return true;
+}
+
+/*
+Marks 'job' done and wakes anyone waiting for it.
+*/
+static void job_done(clr_job* job){
+	job->stack.reset();
+	std::lock_guard<std::mutex> lock(job->lock);
+	job->done = true;
+	job->wake.notify_all();
+}
+
+/*
+Scheduler thread. Takes the job at the front of the queue, runs it for a slice,
+and puts it at the back if it isn't finished, so every job gets an equal share
+of the thread. A job is started (given a stack) the first time it runs. Exits
+once stopping and every job is done.
+*/
+static void worker_main(sched_worker* w, size_t slice){
+
+	while (true){
+		std::shared_ptr<clr_job> job;
+		{
+			std::unique_lock<std::mutex> lock(w->lock);
+			while (w->queue.empty() && !w->stopping) w->wake.wait(lock);
+			if (w->queue.empty()) return;
+			job = w->queue.front();
+			w->queue.pop_front();
+			if (w->stopping) job->cancel = true; //Covers the job that was running when sched_stop was called
+		}
+
+		if (!job->started){
+			string err;
+			if (!job_may_run(job.get(), err)){ //Never ran - no need to give it a stack
+				job->err = err;
+				job_done(job.get());
+				continue;
+			}
+			job->started = true;
+			job->stack.reset(new char[CLR_SCHED_STACK]);
+			getcontext(&job->context);
+			job->context.uc_stack.ss_sp = job->stack.get();
+			job->context.uc_stack.ss_size = CLR_SCHED_STACK;
+			job->context.uc_link = &w->home;
+			makecontext(&job->context, job_main, 0);
+			job->home = &w->home;
+			job->state->job = job.get();
+			starting_job = job.get();
+		}
+
+		job->budget = slice;
+		job->slices++;
+		swapcontext(&w->home, &job->context);
+
+		if (job->finished){
+			job_done(job.get());
+		}else{
+			std::lock_guard<std::mutex> lock(w->lock);
+			w->queue.push_back(job);
+		}
+	}
+}
+
+/*
+Starts 'threads' scheduler threads (at least 1). Each job evaluates 'slice'
+trees (at least 1) before it yields to the next job on its thread.
+*/
+void sched_start(clr_scheduler* sched, size_t threads, size_t slice){
+	sched->next = 0;
+	sched->slice = (slice > 0) ? slice : 1;
+	sched->workers.clear();
+	if (threads < 1) threads = 1;
+	for (size_t t = 0 ; t < threads ; t++){
+		sched->workers.push_back(std::unique_ptr<sched_worker>(new sched_worker()));
+		sched->workers[t]->stopping = false;
+	}
+	for (size_t t = 0 ; t < sched->workers.size() ; t++){
+		sched->workers[t]->thread = std::thread(worker_main, sched->workers[t].get(), sched->slice);
+	}
+}
+
+/*
+Queues 'lines' to run on 'state' and returns the job. Jobs are handed to the
+threads in turn. 'state' must not be used by anything else (including another
+job) until the job is done. Its output goes to state->out as it's printed.
+*/
+std::shared_ptr<clr_job> sched_submit(clr_scheduler* sched, clr_state* state, const std::vector<std::string>& lines, double timeout){
+
+	std::shared_ptr<clr_job> job(new clr_job());
+	job->state = state;
+	job->lines = lines;
+	job->deadline = std::chrono::steady_clock::time_point::max();
+	if (timeout > 0){
+		job->deadline = std::chrono::steady_clock::now() + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(timeout));
+	}
+	job->cancel = false;
+	job->failed = 0;
+	job->slices = 0;
+	job->budget = 0;
+	job->started = false;
+	job->finished = false;
+	job->home = NULL;
+	job->done = false;
+
+	sched_worker* w = sched->workers[sched->next++ % sched->workers.size()].get();
+	std::lock_guard<std::mutex> lock(w->lock);
+	w->queue.push_back(job);
+	w->wake.notify_one();
+	return job;
+}
+
+/*
+Asks 'job' to stop. It stops at its next checkpoint (at the latest when its
+current tree finishes), failing the line it's on, and sched_wait then returns
+false.
+*/
+void sched_cancel(clr_job* job){
+	job->cancel = true;
+}
+
+/*
+Waits until 'job' is done. Returns true if it ran every line (some of which may
+have failed - see job->failed) and false if it was cancelled or passed its
+deadline.
+*/
+bool sched_wait(clr_job* job){
+	std::unique_lock<std::mutex> lock(job->lock);
+	while (!job->done) job->wake.wait(lock);
+	return job->err == "";
+}
+
+/*
+Cancels every queued or running job, lets running jobs unwind to their next
+checkpoint, and stops the threads.
+*/
+void sched_stop(clr_scheduler* sched){
+	for (size_t t = 0 ; t < sched->workers.size() ; t++){
+		sched_worker* w = sched->workers[t].get();
+		std::lock_guard<std::mutex> lock(w->lock);
+		for (size_t j = 0 ; j < w->queue.size() ; j++) w->queue[j]->cancel = true;
+		w->stopping = true;
+		w->wake.notify_all();
+	}
+	for (size_t t = 0 ; t < sched->workers.size() ; t++){
+		sched->workers[t]->thread.join();
+	}
+	sched->workers.clear();
+}
+
+/*
+Called by eval_trees before each tree when 'state' is running a job. Counts the
+tree against the job's slice and, once the slice is used up, yields to the
+next job on the thread. Returns false (and describes why in 'err') if the job
+was cancelled or has passed its deadline, so the line being run fails and the
+job stops.
+*/
+bool sched_checkpoint(clr_state* state, std::string& err){
+
+	clr_job* job = state->job;
+	if (job->cancel.load(std::memory_order_relaxed)){
+		err = "Cancelled.";
+		job->err = err;
+		return false;
+	}
+	if (job->budget > 0 && --job->budget > 0) return true;
+
+	swapcontext(&job->context, job->home); //Slice used up - let the other jobs on this thread run
+	if (!job_may_run(job, err)){
+		job->err = err;
+		return false;
+	}
+	return true;
+}
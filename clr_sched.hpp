@@ -0,0 +1,121 @@
+/*
+This file declares the scheduler, which runs CLR input for many sessions on a
+few threads. Each job (the lines to run on one session) runs as a coroutine on
+its own stack. After every CLR_SCHED_SLICE trees it evaluates, it yields back to
+its thread's scheduler, which resumes the next job. So one long script can't
+hold a thread while other sessions wait. Jobs can be cancelled and given
+deadlines, which are checked at the same points.
+
+A job yields between the trees of a line or an interpreted function. So a
+single long operation (eg. an FFT of a huge array) still runs to completion
+before the job yields. Work run on forks (ROOT's and INTEG's evaluations,
+formulas) doesn't yield either.
+
+Created by Grant Giesbrecht on 19.10.2026
+
+*/
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
+#include <ucontext.h>
+#include "clr_types.hpp"
+
+#ifndef CLR_SCHED_HPP
+#define CLR_SCHED_HPP
+
+#define CLR_SCHED_SLICE 1000 //Default trees a job evaluates before yielding
+#define CLR_SCHED_STACK (512*1024) //Bytes of stack per running job. Enough for CLR_MAX_CALL_DEPTH nested calls.
+
+/*
+Input to run on a session, and its progress.
+
+state = Session the lines run on. Must not be used elsewhere until the job is done.
+lines = Input lines, run in order. Lines which fail don't stop the job.
+deadline = Time by which the job must be done, after which it's stopped
+cancel = Set to stop the job at its next checkpoint (see sched_cancel)
+failed = Number of lines which failed
+line_us = Time from the job first running until each line finished, in microseconds
+err = Why the job was stopped early. Empty if it ran every line.
+slices = Number of time slices the job ran for
+budget = Trees left to evaluate in the current slice
+started, finished = Job has started or finished running
+stack = Coroutine stack. Only allocated while the job runs.
+context = Where the job resumes
+home = Where the job yields to (its worker's loop)
+done = Set (under 'lock') when the job is finished, to wake sched_wait
+*/
+struct clr_job{
+	clr_state* state;
+	std::vector<std::string> lines;
+	std::chrono::steady_clock::time_point deadline;
+	std::atomic<bool> cancel;
+	size_t failed;
+	std::vector<double> line_us;
+	std::string err;
+	size_t slices;
+
+	size_t budget;
+	bool started;
+	bool finished;
+	std::unique_ptr<char[]> stack;
+	ucontext_t context;
+	ucontext_t* home;
+
+	std::mutex lock;
+	std::condition_variable wake;
+	bool done;
+};
+
+/*
+One scheduler thread and its jobs, which it runs in turn for a slice each. Jobs
+stay on the thread they were given to, since a coroutine can't move between
+threads.
+*/
+typedef struct{
+	std::mutex lock;
+	std::condition_variable wake;
+	std::deque<std::shared_ptr<clr_job> > queue;
+	bool stopping;
+	ucontext_t home;
+	std::thread thread;
+}sched_worker;
+
+/*
+A set of scheduler threads.
+
+workers = Threads. Jobs are spread over them in turn.
+next = Worker the next job goes to
+slice = Trees a job evaluates per slice
+*/
+typedef struct{
+	std::vector<std::unique_ptr<sched_worker> > workers;
+	std::atomic<size_t> next;
+	size_t slice;
+}clr_scheduler;
+
+//Starts 'threads' scheduler threads giving jobs 'slice' trees at a time
+void sched_start(clr_scheduler* sched, size_t threads, size_t slice);
+
+//Queues 'lines' to run on 'state'. A 'timeout' (seconds) of 0 or less means no deadline.
+std::shared_ptr<clr_job> sched_submit(clr_scheduler* sched, clr_state* state, const std::vector<std::string>& lines, double timeout);
+
+//Asks 'job' to stop at its next checkpoint
+void sched_cancel(clr_job* job);
+
+//Waits for 'job' to finish. Returns false if it was stopped early (see job->err).
+bool sched_wait(clr_job* job);
+
+//Cancels all unfinished jobs and stops the scheduler's threads
+void sched_stop(clr_scheduler* sched);
+
+//Called between trees. Yields if the job's slice is used up. Returns false if the job must stop.
+bool sched_checkpoint(clr_state* state, std::string& err);
+
+#endif
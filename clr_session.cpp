@@ -0,0 +1,439 @@
+#include "clr_session.hpp"
+#include "clr_interpret.hpp"
+#include "clr_arrays.hpp"
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+using namespace std;
+
+/*
+Returns the header of the mapped session.
+*/
+static session_header* header_of(clr_session* sess){
+	return reinterpret_cast<session_header*>(sess->base);
+}
+
+/*
+Returns the 'idx'th record slot of the mapped session.
+*/
+static session_record* record_at(clr_session* sess, uint64_t idx){
+	return reinterpret_cast<session_record*>(sess->base + CLR_SESSION_DATA_OFFSET + idx*sizeof(session_record));
+}
+
+/*
+Starts flushing 'len' bytes starting at 'addr' to disk, without waiting for it
+(see session_close). This gives no order between ranges, so until the session is
+closed a power loss can leave any mix of them on disk. msync requires a page
+aligned address so the start is rounded down.
+*/
+static void sync_range(clr_session* sess, const void* addr, size_t len){
+	size_t page = (size_t)sysconf(_SC_PAGESIZE);
+	size_t start = (const char*)addr - sess->base;
+	size_t aligned = start - (start % page);
+	msync(sess->base + aligned, len + (start - aligned), MS_ASYNC);
+}
+
+/*
+Returns the size in bytes of a session file with room for 'capacity' records and
+no array values.
+*/
+static size_t file_size(uint64_t capacity){
+	return CLR_SESSION_DATA_OFFSET + capacity*sizeof(session_record);
+}
+
+/*
+Returns the file size at which a session file of 'size' bytes is next compacted,
+so at most about half the file is ever values of overwritten arrays.
+*/
+static uint64_t next_compaction(uint64_t size){
+	return (size > CLR_SESSION_COMPACT_SLACK) ? 2*size : size + CLR_SESSION_COMPACT_SLACK;
+}
+
+/*
+Returns where array values appended to a file of 'size' bytes start.
+*/
+static uint64_t array_start(uint64_t size){
+	return (size + CLR_SESSION_ARRAY_ALIGN - 1)/CLR_SESSION_ARRAY_ALIGN*CLR_SESSION_ARRAY_ALIGN;
+}
+
+/*
+Writes 'len' bytes from 'p' to 'fd' at 'offset', in pieces if need be (pwrite may
+not take it all at once).
+*/
+static bool write_all(int fd, const char* p, uint64_t len, uint64_t offset){
+	while (len > 0){
+		ssize_t wrote = pwrite(fd, p, len, offset);
+		if (wrote <= 0) return false;
+		p += wrote;
+		offset += wrote;
+		len -= wrote;
+	}
+	return true;
+}
+
+/*
+Copies 'len' bytes at 'from_offset' in 'from' to 'to_offset' in 'to'.
+*/
+static bool copy_range(int from, uint64_t from_offset, int to, uint64_t to_offset, uint64_t len){
+	vector<char> buf(len < (1 << 20) ? len : (1 << 20));
+	while (len > 0){
+		size_t n = (len < buf.size()) ? len : buf.size();
+		if (pread(from, &buf[0], n, from_offset) != (ssize_t)n || !write_all(to, &buf[0], n, to_offset)) return false;
+		from_offset += n;
+		to_offset += n;
+		len -= n;
+	}
+	return true;
+}
+
+/*
+Maps the values of the array in 'rec' from the session file and writes the array
+to 'arr'. The pages are private, so a stray write can never reach the file, but
+pages not yet written to still show later writes to the file. The array only
+stays unchanged because array values are never rewritten in place: they are
+appended past the end of the file, and compaction renames a new file over the
+old one, whose pages stay mapped. Keep it that way.
+Returns false if the record points outside the file.
+*/
+static bool map_array(clr_session* sess, const session_record* rec, std::shared_ptr<const clr_array>& arr){
+
+	struct stat st;
+	if (fstat(sess->fd, &st) != 0) return false;
+	if (rec->data_length % sizeof(comp) != 0 || rec->data_offset % sizeof(double) != 0) return false;
+	if (rec->data_offset > (uint64_t)st.st_size || rec->data_length > (uint64_t)st.st_size - rec->data_offset) return false;
+
+	std::shared_ptr<clr_array> a(new clr_array());
+	a->length = rec->data_length/sizeof(comp);
+	a->cols = (size_t)rec->re;
+	a->data = NULL;
+	if (a->length > 0){
+		uint64_t page = (uint64_t)sysconf(_SC_PAGESIZE);
+		uint64_t map_start = rec->data_offset - rec->data_offset % page;
+		size_t skip = rec->data_offset - map_start;
+		size_t map_len = skip + rec->data_length;
+		void* base = mmap(NULL, map_len, PROT_READ | PROT_WRITE, MAP_PRIVATE, sess->fd, map_start);
+		if (base == MAP_FAILED) return false;
+		a->data = (comp*)((char*)base + skip);
+		a->owner = std::shared_ptr<void>(base, [map_len](void* p){ munmap(p, map_len); });
+	}
+	arr = a;
+	return true;
+}
+
+/*
+Maps the file open in 'sess->fd', which must be 'length' bytes long.
+*/
+static bool map_file(clr_session* sess, size_t length, string& err){
+	void* p = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_SHARED, sess->fd, 0);
+	if (p == MAP_FAILED){
+		err = "Failed to map session file '" + sess->path + "'.";
+		return false;
+	}
+	sess->base = (char*)p;
+	sess->length = length;
+	return true;
+}
+
+/*
+Writes an empty session with room for 'capacity' records to the open file
+descriptor 'fd'.
+*/
+static bool init_file(int fd, uint64_t capacity){
+
+	if (ftruncate(fd, file_size(capacity)) != 0) return false;
+
+	session_header h;
+	memset(&h, 0, sizeof(h));
+	memcpy(h.magic, CLR_SESSION_MAGIC, 8);
+	h.version = CLR_SESSION_VERSION;
+	h.record_size = sizeof(session_record);
+	h.capacity = capacity;
+	h.count = 0;
+	h.reg_seq = 0;
+
+	if (pwrite(fd, &h, sizeof(h), 0) != sizeof(h)) return false;
+	return fsync(fd) == 0;
+}
+
+/*
+Opens the session file at 'path' and maps it into memory. If the file does not
+exist, an empty session is created. Returns false and describes the problem in
+'err' if the file can not be opened or is not a valid session.
+*/
+bool session_open(std::string path, clr_session* sess, std::string& err){
+
+	sess->path = path;
+	sess->base = NULL;
+	sess->length = 0;
+
+	sess->fd = open(path.c_str(), O_RDWR | O_CREAT, 0644);
+	if (sess->fd < 0){
+		err = "Failed to open session file '" + path + "'.";
+		return false;
+	}
+
+	//Create file if new
+	struct stat st;
+	fstat(sess->fd, &st);
+	if (st.st_size == 0){
+		if (!init_file(sess->fd, CLR_SESSION_INITIAL_CAPACITY)){
+			err = "Failed to initialize session file '" + path + "'.";
+			close(sess->fd);
+			return false;
+		}
+		fstat(sess->fd, &st);
+	}
+
+	//Validate header
+	if ((size_t)st.st_size < CLR_SESSION_DATA_OFFSET){
+		err = "File '" + path + "' is not a CLR session.";
+		close(sess->fd);
+		return false;
+	}
+	if (!map_file(sess, st.st_size, err)){
+		close(sess->fd);
+		return false;
+	}
+	session_header* h = header_of(sess);
+	if (memcmp(h->magic, CLR_SESSION_MAGIC, 8) != 0 || h->version < 1 || h->version > CLR_SESSION_VERSION || h->record_size != sizeof(session_record)){
+		err = "File '" + path + "' is not a CLR session or was written by an incompatible version.";
+		session_close(sess);
+		return false;
+	}
+	if (file_size(h->capacity) > sess->length || h->count > h->capacity){
+		err = "Session file '" + path + "' is truncated.";
+		session_close(sess);
+		return false;
+	}
+	h->version = CLR_SESSION_VERSION; //A version 1 file is a version 2 file without arrays
+	sess->compact_at = next_compaction(st.st_size);
+
+	return true;
+}
+
+/*
+Unmaps and closes the session, waiting until everything written is on disk.
+Safe to call on a session that failed to open.
+*/
+void session_close(clr_session* sess){
+	if (sess->base != NULL){
+		msync(sess->base, sess->length, MS_SYNC);
+		munmap(sess->base, sess->length);
+		sess->base = NULL;
+	}
+	if (sess->fd >= 0){
+		fsync(sess->fd); //Array values are written with pwrite, not through the mapping
+		close(sess->fd);
+		sess->fd = -1;
+	}
+}
+
+/*
+Loads the registers and variables stored in 'sess' into 'state'. Variables in
+the session replace variables of the same name in 'state'; others are kept.
+Arrays are mapped from the file (see map_array). Returns false if an array could
+not be restored (the rest are still loaded).
+*/
+bool session_restore(clr_session* sess, clr_state* state){
+
+	session_header* h = header_of(sess);
+
+	//Restore registers from the last complete snapshot
+	double* r = h->regs[h->reg_seq % 2];
+	state->x = cart(r[0], r[1]);
+	state->y = cart(r[2], r[3]);
+	state->z = cart(r[4], r[5]);
+	state->t = cart(r[6], r[7]);
+
+	//Replay variable log. Later records for a name overwrite earlier ones
+	std::vector<variable>* vars = writable_variables(state);
+	variable v;
+	v.dirty = false;
+	bool restored = true;
+	for (uint64_t i = 0 ; i < h->count ; i++){
+		session_record* rec = record_at(sess, i);
+		v.name = string(rec->name, strnlen(rec->name, sizeof(rec->name)));
+		v.type = string(rec->type, strnlen(rec->type, sizeof(rec->type)));
+		v.valnum = cart(rec->re, rec->im);
+		v.valarr.reset();
+		if (v.type == "arr"){
+			v.valnum = cart(0, 0);
+			if (!map_array(sess, rec, v.valarr)){
+				restored = false;
+				continue;
+			}
+		}
+
+		size_t vidx = 0;
+		for ( ; vidx < vars->size() ; vidx++){
+			if ((*vars)[vidx].name == v.name) break;
+		}
+		if (vidx < vars->size()){
+			(*vars)[vidx] = v;
+		}else{
+			vars->push_back(v);
+		}
+	}
+
+	return restored;
+}
+
+/*
+Rewrites the session keeping only the latest record for each variable (and the
+values of only those arrays), growing the file if the live set would still leave
+it mostly full. The new file is built beside the old one and renamed over it, so
+a crash leaves one or the other intact.
+*/
+static bool compact(clr_session* sess){
+
+	session_header* h = header_of(sess);
+
+	//Find the latest record for each name
+	vector<session_record> live;
+	for (uint64_t i = 0 ; i < h->count ; i++){
+		session_record* rec = record_at(sess, i);
+		size_t l = 0;
+		for ( ; l < live.size() ; l++){
+			if (strncmp(live[l].name, rec->name, sizeof(rec->name)) == 0) break;
+		}
+		if (l < live.size()){
+			live[l] = *rec;
+		}else{
+			live.push_back(*rec);
+		}
+	}
+
+	uint64_t capacity = h->capacity;
+	while (live.size()*2 > capacity) capacity *= 2;
+
+	//Write new file
+	string tmp_path = sess->path + ".tmp";
+	int fd = open(tmp_path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0) return false;
+	if (!init_file(fd, capacity)){
+		close(fd);
+		unlink(tmp_path.c_str());
+		return false;
+	}
+	bool ok = true;
+	uint64_t end = file_size(capacity);
+	for (size_t l = 0 ; l < live.size() && ok ; l++){
+		if (live[l].data_length == 0) continue;
+		uint64_t at = array_start(end);
+		ok = copy_range(sess->fd, live[l].data_offset, fd, at, live[l].data_length);
+		live[l].data_offset = at;
+		end = at + live[l].data_length;
+	}
+	session_header nh;
+	pread(fd, &nh, sizeof(nh), 0);
+	nh.count = live.size();
+	nh.reg_seq = h->reg_seq;
+	memcpy(nh.regs, h->regs, sizeof(nh.regs));
+	if (!live.empty()){
+		pwrite(fd, &live[0], live.size()*sizeof(session_record), CLR_SESSION_DATA_OFFSET);
+	}
+	pwrite(fd, &nh, sizeof(nh), 0);
+	if (!ok || fsync(fd) != 0 || rename(tmp_path.c_str(), sess->path.c_str()) != 0){
+		close(fd);
+		unlink(tmp_path.c_str());
+		return false;
+	}
+
+	//Swap mapping over to the new file
+	munmap(sess->base, sess->length);
+	sess->base = NULL;
+	close(sess->fd);
+	sess->fd = fd;
+	sess->compact_at = next_compaction(end);
+	string err;
+	return map_file(sess, file_size(capacity), err);
+}
+
+/*
+Appends 'var' to the session's variable log. An array's values are written to
+the end of the file first. The record is written before it is counted, so if CLR
+crashes or is killed at any point the session never holds a partially written
+record. Flushes to disk are started but not waited on, as the session is written
+on every STO, and they can complete in any order: this is not safe against a
+power loss or OS crash before session_close, which waits for them. Returns false
+if the variable can not be stored (eg. its name is too long).
+*/
+bool session_store_variable(clr_session* sess, const variable& var){
+
+	if (var.name.length() > sizeof(((session_record*)0)->name) || var.type.length() > sizeof(((session_record*)0)->type)){
+		return false;
+	}
+	if (var.type == "arr" && !var.valarr) return false;
+
+	if (header_of(sess)->count == header_of(sess)->capacity){
+		if (!compact(sess)) return false;
+	}
+
+	//Append array values
+	uint64_t data_offset = 0, data_length = 0;
+	if (var.type == "arr"){
+		struct stat st;
+		data_length = var.valarr->length*sizeof(comp);
+		if (fstat(sess->fd, &st) != 0) return false;
+		if (array_start(st.st_size) + data_length > sess->compact_at){
+			if (!compact(sess) || fstat(sess->fd, &st) != 0) return false;
+		}
+		data_offset = array_start(st.st_size);
+		if (!write_all(sess->fd, (const char*)var.valarr->data, data_length, data_offset)) return false;
+	}
+
+	session_header* h = header_of(sess);
+	session_record* rec = record_at(sess, h->count);
+	memset(rec, 0, sizeof(session_record));
+	memcpy(rec->name, var.name.c_str(), var.name.length());
+	memcpy(rec->type, var.type.c_str(), var.type.length());
+	if (var.type == "arr"){
+		rec->re = (double)var.valarr->cols;
+		rec->data_offset = data_offset;
+		rec->data_length = data_length;
+	}else{
+		rec->re = var.valnum.real();
+		rec->im = var.valnum.imag();
+	}
+	sync_range(sess, rec, sizeof(session_record));
+
+	//Commit
+	__sync_synchronize(); //Record must be complete before it's counted
+	h->count = h->count + 1;
+	sync_range(sess, h, sizeof(session_header));
+
+	return true;
+}
+
+/*
+Removes all variables from the session. Resetting the count is a single store,
+so the log is either entirely kept or entirely dropped.
+*/
+void session_clear_variables(clr_session* sess){
+	session_header* h = header_of(sess);
+	h->count = 0;
+	sync_range(sess, h, sizeof(session_header));
+}
+
+/*
+Writes a snapshot of 'state's registers into the inactive slot, then flips
+'reg_seq' to point at it. Registers change on nearly every line so the flush is
+not waited on. Registers holding arrays are saved as 0 - only arrays stored in
+variables are kept in the session.
+*/
+void session_store_registers(clr_session* sess, const clr_state* state){
+
+	session_header* h = header_of(sess);
+	double* r = h->regs[(h->reg_seq + 1) % 2];
+	r[0] = state->x.num.real(); r[1] = state->x.num.imag();
+	r[2] = state->y.num.real(); r[3] = state->y.num.imag();
+	r[4] = state->z.num.real(); r[5] = state->z.num.imag();
+	r[6] = state->t.num.real(); r[7] = state->t.num.imag();
+	__sync_synchronize(); //Snapshot must be complete before it's published
+	h->reg_seq = h->reg_seq + 1;
+
+	sync_range(sess, h, sizeof(session_header));
+}
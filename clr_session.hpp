@@ -0,0 +1,98 @@
+/*
+This file declares the persistent session store. A session file holds the
+registers and variable table of a CLR instance so a later run can pick up where
+the last one left off without replaying any scripts.
+
+The file is a header page, a log of fixed size variable records, then the values
+of array variables. Restored arrays are mapped from the file and used in place,
+so a large array costs nothing to restore until its values are used.
+
+Writes are ordered so the file stays consistent if CLR crashes or is killed at
+any point. They are only certain to be on disk once the session is closed, so a
+power loss or OS crash before then can leave the file inconsistent.
+
+Created by Grant Giesbrecht on 19.10.2026
+
+*/
+
+#include <string>
+#include <stdint.h>
+#include "clr_types.hpp"
+
+#ifndef CLR_SESSION_HPP
+#define CLR_SESSION_HPP
+
+#define CLR_SESSION_MAGIC "CLRSESS1"
+#define CLR_SESSION_VERSION 2 //Version 1 files (no arrays) are read and upgraded
+#define CLR_SESSION_DATA_OFFSET 4096 //Records start on the second page
+#define CLR_SESSION_INITIAL_CAPACITY 256 //Records in a newly created file
+#define CLR_SESSION_ARRAY_ALIGN 4096 //Array values start on a multiple of this
+#define CLR_SESSION_COMPACT_SLACK (64 << 20) //Bytes of array values stored before the file is compacted
+
+/*
+The first page of a session file.
+
+count = Number of committed records. A record only counts once this is bumped,
+	so if CLR crashes mid-write at most the record being written is lost.
+reg_seq = Index of the last register snapshot written. Snapshots alternate
+	between the two 'regs' slots so a torn write never corrupts the last good one.
+regs = Register snapshots, stored as real/imag pairs for x, y, z then t.
+*/
+typedef struct{
+	char magic[8];
+	uint32_t version;
+	uint32_t record_size;
+	uint64_t capacity;
+	uint64_t count;
+	uint64_t reg_seq;
+	double regs[2][8];
+}session_header;
+
+/*
+One entry in the session's append-only variable log. Later records for the same
+name override earlier ones.
+
+re, im = Value of a 'num' variable. For an 'arr' variable, 're' holds the number
+	of columns (0 unless it's a matrix).
+data_offset, data_length = Where an 'arr' variable's values (as 'comp') are in the
+	file, and their length in bytes. 0 for other types.
+*/
+typedef struct{
+	char name[40];
+	char type[8];
+	double re;
+	double im;
+	uint64_t data_offset;
+	uint64_t data_length;
+}session_record;
+
+/*
+An open, memory-mapped session file.
+*/
+struct clr_session{
+	std::string path;
+	int fd;
+	char* base; //Start of the mapping
+	size_t length; //Length of the mapping in bytes
+	uint64_t compact_at; //File size past which storing an array compacts the file first
+};
+
+//Opens (or creates) the session file at 'path' and maps it into memory
+bool session_open(std::string path, clr_session* sess, std::string& err);
+
+//Unmaps and closes a session
+void session_close(clr_session* sess);
+
+//Loads the registers and variables stored in 'sess' into 'state'
+bool session_restore(clr_session* sess, clr_state* state);
+
+//Appends a variable (number or array) to the session's log
+bool session_store_variable(clr_session* sess, const variable& var);
+
+//Removes all variables from the session
+void session_clear_variables(clr_session* sess);
+
+//Writes a snapshot of 'state's registers to the session
+void session_store_registers(clr_session* sess, const clr_state* state);
+
+#endif
@@ -0,0 +1,31 @@
+#include "clr_sink.hpp"
+
+clr_sink_buffer::clr_sink_buffer(clr_sink_fn fn, void* user) : fn(fn), user(user){
+	setp(buf, buf + CLR_SINK_BUFFER);
+}
+
+clr_sink_buffer::~clr_sink_buffer(){
+	sync();
+}
+
+/*
+Called when the buffer is full. Passes its contents on, then stores 'c'.
+*/
+int clr_sink_buffer::overflow(int c){
+	sync();
+	if (c != traits_type::eof()){
+		*pptr() = (char)c;
+		pbump(1);
+	}
+	return traits_type::not_eof(c);
+}
+
+/*
+Passes the buffered output on.
+*/
+int clr_sink_buffer::sync(){
+	size_t n = pptr() - pbase();
+	if (n > 0 && fn != NULL) fn(pbase(), n, user);
+	setp(buf, buf + CLR_SINK_BUFFER);
+	return 0;
+}
@@ -0,0 +1,50 @@
+/*
+This file declares output sinks. Everything a state prints goes to the stream
+in its 'out' field (see clr_state), so where output ends up is chosen per state
+by giving it a stream over one of the buffers below: a callback (eg. a
+connection to a client, or a log), or nothing at all. States on different
+threads print to their own sinks without sharing a lock.
+
+Created by Grant Giesbrecht on 19.10.2026
+
+*/
+
+#include <streambuf>
+#include <stddef.h>
+
+#ifndef CLR_SINK_HPP
+#define CLR_SINK_HPP
+
+#define CLR_SINK_BUFFER 1024 //Bytes collected before a callback sink is called
+
+//Receives 'len' bytes of output. 'text' is not NUL terminated.
+typedef void (*clr_sink_fn) (const char* text, size_t len, void* user);
+
+/*
+A stream buffer which passes output to a callback along with 'user'. Output is
+collected and passed on when the buffer fills or the stream is flushed (eg. by
+endl), so the callback isn't called for every character.
+*/
+class clr_sink_buffer : public std::streambuf{
+public:
+	clr_sink_buffer(clr_sink_fn fn, void* user);
+	~clr_sink_buffer();
+protected:
+	int overflow(int c);
+	int sync();
+private:
+	clr_sink_fn fn;
+	void* user;
+	char buf[CLR_SINK_BUFFER];
+};
+
+/*
+A stream buffer which discards everything.
+*/
+class clr_null_buffer : public std::streambuf{
+protected:
+	int overflow(int c){ return c; }
+	std::streamsize xsputn(const char* s, std::streamsize n){ return n; }
+};
+
+#endif
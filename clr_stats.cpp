@@ -0,0 +1,113 @@
+#include "clr_stats.hpp"
+#include <cmath>
+
+void welford_reset(clr_welford& w){
+	w.n = 0;
+	w.mean = 0;
+	w.m2 = 0;
+	w.min = INFINITY;
+	w.max = -INFINITY;
+}
+
+void welford_add(clr_welford& w, double x){
+	w.n++;
+	double d = x - w.mean;
+	w.mean += d/w.n;
+	w.m2 += d*(x - w.mean);
+	if (x < w.min) w.min = x;
+	if (x > w.max) w.max = x;
+}
+
+/*
+Merges with Chan et al.'s formula for the combined sum of squared differences.
+The result only depends on the order of merging, so merging the same pieces in
+the same order always gives the same result.
+*/
+void welford_merge(clr_welford& a, const clr_welford& b){
+	if (b.n == 0) return;
+	if (a.n == 0){
+		a = b;
+		return;
+	}
+	double n = (double)a.n + b.n;
+	double d = b.mean - a.mean;
+	a.mean += d*b.n/n;
+	a.m2 += b.m2 + d*d*((double)a.n*b.n/n);
+	a.n += b.n;
+	if (b.min < a.min) a.min = b.min;
+	if (b.max > a.max) a.max = b.max;
+}
+
+/*
+Inverts welford_merge: 'a' becomes the accumulator which, merged with 'b', gives
+the current 'a'. The min and max can't be recovered, so they still include the
+values taken out. Taking out everything empties 'a'.
+*/
+void welford_unmerge(clr_welford& a, const clr_welford& b){
+	if (b.n == 0) return;
+	if (b.n >= a.n){
+		double mn = a.min, mx = a.max;
+		welford_reset(a);
+		a.min = mn;
+		a.max = mx;
+		return;
+	}
+	double n = (double)a.n - b.n;
+	double mean = (a.n*a.mean - b.n*b.mean)/n;
+	double d = b.mean - mean;
+	a.m2 -= b.m2 + d*d*(n*b.n/a.n);
+	if (a.m2 < 0) a.m2 = 0; //Rounding
+	a.mean = mean;
+	a.n -= b.n;
+}
+
+double welford_variance(const clr_welford& w){
+	return (w.n > 1) ? w.m2/(w.n - 1) : 0;
+}
+
+void covariance_reset(clr_covariance& c){
+	welford_reset(c.x);
+	welford_reset(c.y);
+	c.cxy = 0;
+}
+
+void covariance_add(clr_covariance& c, double x, double y){
+	double dx = x - c.x.mean;
+	welford_add(c.x, x);
+	welford_add(c.y, y);
+	c.cxy += dx*(y - c.y.mean);
+}
+
+void covariance_merge(clr_covariance& a, const clr_covariance& b){
+	if (b.x.n == 0) return;
+	double n = (double)a.x.n + b.x.n;
+	double dx = b.x.mean - a.x.mean, dy = b.y.mean - a.y.mean;
+	a.cxy += b.cxy + dx*dy*((double)a.x.n*b.x.n/n);
+	welford_merge(a.x, b.x);
+	welford_merge(a.y, b.y);
+}
+
+void covariance_unmerge(clr_covariance& a, const clr_covariance& b){
+	if (b.x.n == 0) return;
+	if (b.x.n >= a.x.n){
+		welford_unmerge(a.x, b.x);
+		welford_unmerge(a.y, b.y);
+		a.cxy = 0;
+		return;
+	}
+	double n = (double)a.x.n - b.x.n;
+	double dx = b.x.mean - (a.x.n*a.x.mean - b.x.n*b.x.mean)/n;
+	double dy = b.y.mean - (a.y.n*a.y.mean - b.y.n*b.y.mean)/n;
+	a.cxy -= b.cxy + dx*dy*(n*b.x.n/a.x.n);
+	welford_unmerge(a.x, b.x);
+	welford_unmerge(a.y, b.y);
+}
+
+double covariance_value(const clr_covariance& c){
+	return (c.x.n > 1) ? c.cxy/(c.x.n - 1) : 0;
+}
+
+void sigma_reset(clr_sigma& s){
+	welford_reset(s.x);
+	covariance_reset(s.xy);
+}
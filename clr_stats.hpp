@@ -0,0 +1,91 @@
+/*
+This file declares streaming statistics. Values are added one at a time with
+Welford's method, which stays accurate for any number of values (summing
+squares would lose precision when the mean is large compared to the spread),
+and two accumulators can be merged, so values can be accumulated in parallel.
+Values can also be taken out again (see S-). An accumulator's size is fixed no
+matter how many values pass through it.
+
+Created by Grant Giesbrecht on 19.10.2026
+
+*/
+
+#include <stddef.h>
+
+#ifndef CLR_STATS_HPP
+#define CLR_STATS_HPP
+
+/*
+Statistics of a stream of real numbers.
+
+n = Number of values
+mean = Mean of the values
+m2 = Sum of the squared differences from the mean
+min, max = Smallest and largest value
+*/
+typedef struct{
+	size_t n;
+	double mean;
+	double m2;
+	double min;
+	double max;
+}clr_welford;
+
+/*
+Statistics of a stream of pairs of real numbers (x, y), for covariance and
+linear regression.
+
+x, y = Statistics of the x and y values
+cxy = Sum of the products of the x and y differences from their means
+*/
+typedef struct{
+	clr_welford x;
+	clr_welford y;
+	double cxy;
+}clr_covariance;
+
+/*
+The statistics registers fed by S+ and S- (see clr_keywords.cpp).
+
+x = Every value fed
+xy = The pairs fed with S+ -xy
+*/
+typedef struct{
+	clr_welford x;
+	clr_covariance xy;
+}clr_sigma;
+
+//Empties 'w'
+void welford_reset(clr_welford& w);
+
+//Adds 'x' to 'w'
+void welford_add(clr_welford& w, double x);
+
+//Adds the values accumulated in 'b' to 'a'
+void welford_merge(clr_welford& a, const clr_welford& b);
+
+//Takes the values accumulated in 'b' back out of 'a'. 'a's min and max are unchanged.
+void welford_unmerge(clr_welford& a, const clr_welford& b);
+
+//Returns the sample variance (dividing by n-1) of the values in 'w', or 0 if there are fewer than 2
+double welford_variance(const clr_welford& w);
+
+//Empties 'c'
+void covariance_reset(clr_covariance& c);
+
+//Adds the pair (x, y) to 'c'
+void covariance_add(clr_covariance& c, double x, double y);
+
+//Adds the pairs accumulated in 'b' to 'a'
+void covariance_merge(clr_covariance& a, const clr_covariance& b);
+
+//Takes the pairs accumulated in 'b' back out of 'a'
+void covariance_unmerge(clr_covariance& a, const clr_covariance& b);
+
+//Returns the sample covariance (dividing by n-1) of the pairs in 'c', or 0 if there are fewer than 2
+double covariance_value(const clr_covariance& c);
+
+//Empties 's'
+void sigma_reset(clr_sigma& s);
+
+#endif
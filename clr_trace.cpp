@@ -0,0 +1,275 @@
+#include "clr_trace.hpp"
+#include "clr_interpret.hpp"
+#include "clr_arrays.hpp"
+#include "clr_sink.hpp"
+#include "clr_sched.hpp"
+#include <IEGA/string_manip.hpp>
+#include <iostream>
+#include <sstream>
+#include <vector>
+#include <algorithm>
+#include <thread>
+#include <cstdio>
+#include <cstdlib>
+
+using namespace std;
+
+/*
+Formats a number so strtod reads back exactly the same value.
+*/
+static string exact(double d){
+	char buf[32];
+	snprintf(buf, sizeof(buf), "%.17g", d);
+	return buf;
+}
+
+/*
+Creates the trace file at 'path' and records the starting state: the functions
+in 'state's library, its registers and its variables. Registers holding arrays
+are recorded as 0 (registers are always numbers when CLR starts). Returns false
+and describes the problem in 'err' if the file can't be created.
+*/
+bool trace_open(std::string path, const clr_state* state, clr_trace* trace, std::string& err){
+
+	trace->out.open(path.c_str());
+	if (!trace->out.is_open()){
+		err = "Failed to create trace file '" + path + "'.";
+		return false;
+	}
+
+	trace->out << CLR_TRACE_MAGIC << " " << CLR_TRACE_VERSION << "\n";
+
+	for (size_t f = 0 ; f < state->library->functions.size() ; f++){
+		trace->out << "F " << state->library->functions[f].name << "\n";
+	}
+
+	const clr_value* regs[4] = {&state->x, &state->y, &state->z, &state->t};
+	const char* reg_names[4] = {"X", "Y", "Z", "T"};
+	for (size_t r = 0 ; r < 4 ; r++){
+		comp c = regs[r]->arr ? comp(0, 0) : regs[r]->num;
+		trace->out << "R " << reg_names[r] << " " << exact(c.real()) << " " << exact(c.imag()) << "\n";
+	}
+
+	for (size_t v = 0 ; v < state->variables->size() ; v++){
+		const variable& var = (*state->variables)[v];
+		if (var.type == "fml"){
+			trace->out << "D " << var.name << " " << var.formula->text << "\n";
+		}else if (var.type == "arr"){
+			trace->out << "A " << var.name << " " << var.valarr->length;
+			for (size_t k = 0 ; k < var.valarr->length ; k++){
+				trace->out << " " << exact(var.valarr->data[k].real()) << " " << exact(var.valarr->data[k].imag());
+			}
+			trace->out << "\n";
+		}else{
+			trace->out << "V " << var.name << " " << exact(var.valnum.real()) << " " << exact(var.valnum.imag()) << "\n";
+		}
+	}
+
+	trace->out << std::flush;
+	trace->start = std::chrono::steady_clock::now();
+
+	return true;
+}
+
+/*
+Appends 'line' to the trace with the time since the trace was opened. The trace
+is flushed so it is complete even if CLR is killed.
+*/
+void trace_line(clr_trace* trace, const std::string& line){
+	long long us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - trace->start).count();
+	trace->out << "L " << us << " " << line << "\n" << std::flush;
+}
+
+/*
+Returns the value at fraction 'p' (0 to 1) of the sorted values in 'v'.
+*/
+static double percentile(const vector<double>& v, double p){
+	if (v.size() == 0) return 0;
+	size_t idx = (size_t)(p*(v.size()-1) + 0.5);
+	return v[idx];
+}
+
+/*
+Reads the trace at 'path', resets 'state' to the trace's starting state and
+runs each recorded line through interpret_clr as fast as possible. Output from
+the lines is discarded.
+
+With 'threads' or 'sessions' above 1, the lines are replayed by that many
+sessions at once (forks of the starting state) to measure how well independent
+sessions scale. The lines/s printed is then the total over all of them. With
+more sessions than threads, the sessions are interleaved by a scheduler and
+the latencies include the time each line spent waiting for other sessions. Afterwards the number of lines, throughput and the
+latency percentiles of single lines are printed.
+
+'state' must already have its functions loaded. Functions that were loaded when
+the trace was recorded but are missing now are listed as a warning, as lines
+calling them will fail. Returns false (and describes the problem in 'err') if
+the trace can't be read.
+*/
+bool trace_replay(std::string path, clr_state* state, size_t threads, size_t sessions, std::string& err){
+
+	ifstream in(path.c_str());
+	if (!in.is_open()){
+		err = "Failed to open trace file '" + path + "'.";
+		return false;
+	}
+
+	string fline;
+	getline(in, fline);
+	if (fline.compare(0, sizeof(CLR_TRACE_MAGIC)-1, CLR_TRACE_MAGIC) != 0){
+		err = "File '" + path + "' is not a CLR trace.";
+		return false;
+	}
+
+	//Read starting state and lines
+	std::vector<variable>* vars = new std::vector<variable>();
+	state->variables.reset(vars);
+	state->x = cart(0, 0);
+	state->y = cart(0, 0);
+	state->z = cart(0, 0);
+	state->t = cart(0, 0);
+	vector<string> formulas;
+	vector<string> lines;
+	vector<string> missing;
+	long long recorded_us = 0;
+	size_t lnum = 1;
+	while (getline(in, fline)){
+		lnum++;
+		if (fline.length() < 2) continue;
+		istringstream ss(fline.substr(2));
+
+		if (fline[0] == 'L'){
+			size_t space = fline.find(' ', 2);
+			if (space == string::npos) space = fline.length();
+			recorded_us = strtoll(fline.c_str() + 2, NULL, 10);
+			lines.push_back((space < fline.length()) ? fline.substr(space+1) : "");
+		}else if (fline[0] == 'F'){
+			string name;
+			ss >> name;
+			if (find_function(state, name) == NULL) missing.push_back(name);
+		}else if (fline[0] == 'R'){
+			string reg;
+			double re = 0, im = 0;
+			ss >> reg >> re >> im;
+			if (reg == "X") state->x = cart(re, im);
+			else if (reg == "Y") state->y = cart(re, im);
+			else if (reg == "Z") state->z = cart(re, im);
+			else if (reg == "T") state->t = cart(re, im);
+		}else if (fline[0] == 'V' || fline[0] == 'A'){
+			variable v;
+			v.dirty = false;
+			ss >> v.name;
+			if (fline[0] == 'V'){
+				double re = 0, im = 0;
+				ss >> re >> im;
+				v.type = "num";
+				v.valnum = cart(re, im);
+			}else{
+				size_t n = 0;
+				ss >> n;
+				std::shared_ptr<clr_array> arr = new_array(n);
+				for (size_t k = 0 ; k < n ; k++){
+					double re = 0, im = 0;
+					ss >> re >> im;
+					arr->data[k] = cart(re, im);
+				}
+				v.type = "arr";
+				v.valarr = arr;
+				v.valnum = cart(0, 0);
+			}
+			if (ss.fail()){
+				err = "Malformed variable on line " + to_string(lnum) + " of trace '" + path + "'.";
+				return false;
+			}
+			vars->push_back(v);
+		}else if (fline[0] == 'D'){
+			formulas.push_back("DEF " + fline.substr(2));
+		}
+	}
+
+	std::ostream* out = state->out;
+	if (missing.size() > 0){
+		*out << "Warning: The trace used functions which are not loaded:";
+		for (size_t m = 0 ; m < missing.size() ; m++) *out << " " << missing[m];
+		*out << endl;
+	}
+
+	//Silence output while replaying
+	clr_null_buffer discard;
+	ostream silent(&discard);
+	state->out = &silent;
+
+	string print_out;
+	for (size_t f = 0 ; f < formulas.size() ; f++){
+		interpret_clr(formulas[f], state, print_out);
+	}
+
+	//Replay on forks of the starting state, each printing to its own stream
+	if (threads < 1) threads = 1;
+	if (sessions < threads) sessions = threads;
+	vector<clr_state> forks(sessions, fork_state(state));
+	vector<vector<double> > latencies(sessions);
+	vector<size_t> fails(sessions, 0);
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	if (sessions == threads){ //One session per thread
+		auto replay = [&](size_t t){
+			ostream fork_silent(&discard);
+			forks[t].out = &fork_silent;
+			string fork_print_out;
+			latencies[t].reserve(lines.size());
+			for (size_t l = 0 ; l < lines.size() && forks[t].running ; l++){
+				std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+				if (!interpret_clr(lines[l], &forks[t], fork_print_out)) fails[t]++;
+				std::chrono::steady_clock::time_point t1 = std::chrono::steady_clock::now();
+				latencies[t].push_back(std::chrono::duration<double, std::micro>(t1 - t0).count());
+			}
+		};
+		vector<std::thread> workers;
+		for (size_t t = 1 ; t < threads ; t++) workers.push_back(std::thread(replay, t));
+		replay(0);
+		for (size_t w = 0 ; w < workers.size() ; w++) workers[w].join();
+	}else{ //Sessions take turns on the threads (see clr_sched.hpp)
+		vector<std::unique_ptr<ostream> > silents(sessions);
+		vector<std::shared_ptr<clr_job> > jobs(sessions);
+		clr_scheduler sched;
+		sched_start(&sched, threads, CLR_SCHED_SLICE);
+		for (size_t s = 0 ; s < sessions ; s++){
+			silents[s].reset(new ostream(&discard));
+			forks[s].out = silents[s].get();
+			jobs[s] = sched_submit(&sched, &forks[s], lines, 0);
+		}
+		for (size_t s = 0 ; s < sessions ; s++){
+			sched_wait(jobs[s].get());
+			fails[s] = jobs[s]->failed;
+			for (size_t l = 0 ; l < jobs[s]->line_us.size() ; l++){ //Includes time spent waiting for other sessions
+				latencies[s].push_back(jobs[s]->line_us[l] - ((l > 0) ? jobs[s]->line_us[l-1] : 0));
+			}
+		}
+		sched_stop(&sched);
+	}
+	double total = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	state->out = out;
+
+	vector<double> latency;
+	size_t failed = 0;
+	for (size_t s = 0 ; s < sessions ; s++){
+		latency.insert(latency.end(), latencies[s].begin(), latencies[s].end());
+		failed += fails[s];
+	}
+
+	//Report
+	sort(latency.begin(), latency.end());
+	*out << "Replayed " << latency.size() << " lines";
+	if (sessions > 1) *out << " (" << sessions << " sessions on " << threads << " threads)";
+	*out << " in " << dtos(total*1e3, 6, 3) << " ms";
+	if (total > 0) *out << " (" << dtos(latency.size()/total, 6, 3) << " lines/s)";
+	*out << ". " << failed << " failed." << endl;
+	*out << "Latency per line (us): p50 " << dtos(percentile(latency, 0.5), 4, 3);
+	*out << ", p90 " << dtos(percentile(latency, 0.9), 4, 3);
+	*out << ", p99 " << dtos(percentile(latency, 0.99), 4, 3);
+	*out << ", max " << dtos(percentile(latency, 1), 4, 3) << endl;
+	*out << "Recorded session lasted " << dtos(recorded_us/1e6, 6, 3) << " s." << endl;
+
+	return true;
+}
@@ -0,0 +1,53 @@
+/*
+This file declares input traces. A trace records every line given to the
+interpreter, when it was entered, and the state CLR was in when recording
+started. Replaying a trace runs the same lines again from the same state as fast
+as possible, so a real session can be used as a repeatable benchmark.
+
+Created by Grant Giesbrecht on 19.10.2026
+
+*/
+
+#include <string>
+#include <fstream>
+#include <chrono>
+#include "clr_types.hpp"
+
+#ifndef CLR_TRACE_HPP
+#define CLR_TRACE_HPP
+
+#define CLR_TRACE_MAGIC "CLRTRACE"
+#define CLR_TRACE_VERSION 1
+
+/*
+Trace file format. A text file with one record per line:
+
+	CLRTRACE <version>
+	F <name>                      Interpreted or plugin function loaded at the start
+	R <reg> <real> <imag>         Register (X, Y, Z or T) at the start (numbers only)
+	V <name> <real> <imag>        Number variable at the start
+	A <name> <n> <re> <im> ...    Array variable at the start, with its 'n' values
+	D <name> <formula>            Formula variable at the start (see DEF)
+	L <microseconds> <input>      Line given to the interpreter, and when (since the start)
+
+Numbers are written with 17 significant digits so they read back exactly.
+*/
+
+/*
+An open trace being recorded.
+*/
+typedef struct{
+	std::ofstream out;
+	std::chrono::steady_clock::time_point start;
+}clr_trace;
+
+//Creates a trace at 'path' and writes 'state' to it as the starting state
+bool trace_open(std::string path, const clr_state* state, clr_trace* trace, std::string& err);
+
+//Appends a line given to the interpreter to the trace
+void trace_line(clr_trace* trace, const std::string& line);
+
+//Replays the trace at 'path' on 'sessions' forks of 'state' at once, on 'threads' threads, and prints throughput and latencies
+bool trace_replay(std::string path, clr_state* state, size_t threads, size_t sessions, std::string& err);
+
+#endif
@@ -11,6 +11,9 @@ Created by Grant Giesbrecht on 6.6.2019
 #include <vector>
 #include <string>
 #include <complex>
+#include <memory>
+#include <stdint.h>
+#include "clr_stats.hpp"
 
 #ifndef CLR_TYPES_HPP
 #define CLR_TYPES_HPP
@@ -27,6 +30,7 @@ typedef std::complex<double> comp;
  	kwrd = key word
  	func = function
 	flag = flag
+	str = string argument (eg. a file path given to ADDFN)
  */
 typedef struct{
 	std::string type;
@@ -46,50 +50,176 @@ struct ast{
 };
 
 /*
-Represents a CLR function.
+Batched form of a base function. Evaluates the function for 'n' values at once:
+out[k] = f(x[k], y[k]). 'out' may alias 'x'.
+*/
+typedef void (*clr_batch_fnptr) (const comp* x, const comp* y, comp* out, size_t n);
+
+/*
+Describes a natively implemented function: a base function (see the table in
+clr_base_functions.cpp) or a function added by a plugin. Every field can be set
+at compile time, so tables of these need no construction at startup.
+
+name = Function name (ie. how it's called). Uppercase for base functions.
+fnptr = Callback which executes the function
+batchptr = Optional batched version of 'fnptr'. May be NULL.
+helpstr = Help page text. May be NULL for plugin functions.
+*/
+typedef struct{
+    const char* name;
+    comp (*fnptr) (comp, comp);
+    clr_batch_fnptr batchptr;
+    const char* helpstr;
+}clr_native_function;
+
+/*
+Represents a CLR function that is added at runtime - an interpreted function or
+a plugin function. Base functions are not stored as clr_functions; they are
+found with find_base_function().
 
 name = Function name (ie. how it's called)
 interpreted = Bool representing if the function is interpreted (ie. script-based) or a base-function (hard-coded)
 commands = vector of strings containing all commands for the function (only if interpreted)
-fnptr = Function pointer pointing to the C++ funtion which executes the CLR function (Only for base-functions)
+fnptr = Function pointer pointing to the C++ funtion which executes the CLR function (Only for plugin functions)
+batchptr = Optional batched version of 'fnptr'. NULL if the function has none.
 helpstr = String containing the help page information
+compiled = True if 'commands' have been compiled into 'program' (see compile_functions)
+program = Parsed commands, with calls to other interpreted functions inlined (only if compiled)
+program_lines = Index in 'commands' that each tree of 'program' came from (only if compiled)
+source = Path of the .clrf file the function was loaded from (only if interpreted)
 */
 typedef struct{
     std::string name;
     bool interpreted;
     std::vector<std::string> commands;
     comp (*fnptr) (comp, comp);
+    clr_batch_fnptr batchptr;
     std::string helpstr;
+    bool compiled;
+    std::vector<ast> program;
+    std::vector<size_t> program_lines;
+    std::string source;
 }clr_function; //Would be named function, but that's ambiguous.
 
 /*
-Represents a CLR variable. In the current version, only complex<double>s are supported,
-but I'm setting up the infrastructure to expand this if that ever comes up...
+Represents a CLR array, a contiguous block of complex values. An array can also
+be a matrix, whose rows are stored one after another (see clr_matrix.hpp).
+
+data = Pointer to the first value
+length = Number of values
+owner = Keeps the memory 'data' points into alive (eg. a std::vector<comp>). Copies
+	of a clr_array share the same values.
+cols = Number of columns if the array is a matrix (it has length/cols rows), or
+	0 for a plain array. 0 when created with 'new clr_array()'.
+*/
+typedef struct{
+    comp* data;
+    size_t length;
+    std::shared_ptr<void> owner;
+    size_t cols;
+}clr_array;
+
+/*
+An RPN formula bound to a variable with DEF (see clr_formula.hpp).
+
+text = The formula as entered (for display)
+program = Parsed formula
+inputs = Names of the variables the formula reads
+*/
+typedef struct{
+    std::string text;
+    std::vector<ast> program;
+    std::vector<std::string> inputs;
+}clr_formula;
+
+/*
+Represents a CLR variable.
 
 name = Variable name
-type = Variable type. Presently only option is 'num'
-valnum = Value (if a num)
+type = Variable type. Either 'num', 'arr' or 'fml'
+valnum = Value (if a num). Last computed value if a fml (and it's a number)
+valarr = Value (if an arr). Last computed value if a fml (and it's an array).
+	Arrays are shared between variables and forks, so never modify one in
+	place - create a new array instead.
+formula = Formula computing the value (if a fml)
+dirty = True if a fml's inputs have changed since its value was computed
 */
 typedef struct{
     std::string name;
     std::string type;
     comp valnum;
+    std::shared_ptr<const clr_array> valarr;
+    std::shared_ptr<const clr_formula> formula;
+    bool dirty;
 }variable;
 
+/*
+Holds the functions added to an instance of CLR at runtime. Keywords and base
+functions are fixed at compile time and are not part of the library. A library is
+treated as immutable once it's been handed to a 'clr_state' so that any number of
+states (ie. forks of a session) can share a single copy. To change it, use
+writable_library() which copies the library first if anyone else is using it.
+*/
+typedef struct{
+    std::vector<clr_function> functions; //Vector of interpreted and plugin functions
+}clr_library;
+
+/*
+Represents the contents of a register - a single number or an array.
+
+num = Value (if a number)
+arr = Value (if an array). NULL if the register holds a number.
+*/
+struct clr_value{
+    comp num;
+    std::shared_ptr<const clr_array> arr;
+
+    clr_value() : num(0, 0) {}
+    clr_value(comp c) : num(c) {}
+    clr_value(std::shared_ptr<const clr_array> a) : num(0, 0), arr(a) {}
+};
+
+/*
+Position in a stream of random numbers (see clr_random.hpp).
+
+seed = Seed (see SEED). Each seed gives different streams.
+stream = Stream number. The interpreter draws from stream 0, Monte Carlo samples from their own.
+counter = Number of draws taken from the stream
+*/
+typedef struct{
+    uint64_t seed;
+    uint64_t stream;
+    uint64_t counter;
+}clr_rng;
+
+typedef struct clr_session clr_session; //Persistent session store (see clr_session.hpp)
+typedef struct clr_profile clr_profile; //Profile of interpreted functions (see clr_profile.hpp)
+typedef struct clr_job clr_job; //Input being run by a scheduler (see clr_sched.hpp)
+
 /*
  Contains all data for an instance of CLR.
+
+ The library and variable table are reference counted and shared between forks
+ (see fork_state()). Never modify them through these pointers directly - use
+ writable_library() and writable_variables(), which copy on write.
  */
 typedef struct{
-	comp x; //x register
-	comp y; //y register
-	comp z; //z register
-	comp t; //t register
-    std::vector<std::string> keywords; //Vector of all CLR keywords
-    std::vector<clr_function> functions; //Vector of all CLR functions (interpreted & base)
-    std::vector<variable> variables; //Vector of all CLR variables
+	clr_value x; //x register
+	clr_value y; //y register
+	clr_value z; //z register
+	clr_value t; //t register
+    std::shared_ptr<const clr_library> library; //Runtime-added functions (shared, read-only)
+    std::shared_ptr<const std::vector<variable> > variables; //Vector of all CLR variables (shared, copy-on-write)
     bool running; //Specifies if main loop should still run
 	std::string help_dir; //Directory in which to search for help files.
 	bool developer_mode; //Operate in developer mode - display AST, registers, etc.
+	clr_session* session; //Session file that mirrors registers & variables. NULL if none.
+	size_t call_depth; //Number of interpreted function calls currently executing
+	std::shared_ptr<clr_profile> profile; //Profile being recorded or last recorded (see PROFILE). NULL if none.
+	std::ostream* out; //Where commands print (eg. STK, HELP). Never NULL.
+	clr_rng rng; //Random number stream for RAND and RANDN
+	clr_sigma sigma; //Statistics registers fed by S+ and S-
+	clr_job* job; //Scheduled job running on this state, which yields between trees. NULL if none.
 }clr_state;
 
 #endif
@@ -0,0 +1,68 @@
+/*
+Times setting up a CLR state and resolving names, the work which building the
+keywords and base functions as static tables (see clr_keywords.cpp and
+clr_base_functions.cpp) took off startup and off every line. Prints the time
+per state set up, per line lexed and per line evaluated.
+
+Run by 'make -f clr_makefile bench'. Not a test: it never fails.
+
+Created by Grant Giesbrecht on 19.10.2026
+
+*/
+
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include "../clr_interpret.hpp"
+
+#define STATE_REPS 20000
+#define LINE_REPS 200000
+
+using namespace std;
+
+/*
+Returns the nanoseconds since 'start', divided by 'reps'.
+*/
+static double ns_per(std::chrono::steady_clock::time_point start, size_t reps){
+	return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count()/reps;
+}
+
+int main(){
+
+	ostringstream printed;
+
+	//Set up (and tear down) a state, as clr and clr_create do
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for (size_t r = 0 ; r < STATE_REPS ; r++){
+		clr_state state;
+		init_state(&state, "", &printed);
+	}
+	cout << "State set up:      " << ns_per(start, STATE_REPS) << " ns" << endl;
+
+	clr_state state;
+	init_state(&state, "", &printed);
+
+	//Lex a line of base function names (each name is looked up)
+	string line = "1;2*3+sin;cos;tan;asin;ln;abs";
+	vector<token> tks;
+	bool success = true;
+	start = std::chrono::steady_clock::now();
+	for (size_t r = 0 ; r < LINE_REPS ; r++){
+		tks.clear();
+		clr_lex(line, &state, success, tks);
+	}
+	cout << "Lex '" << line << "': " << ns_per(start, LINE_REPS) << " ns" << endl;
+
+	//Evaluate a line calling a base function
+	line = "1;2*3+sin";
+	string print_out;
+	start = std::chrono::steady_clock::now();
+	for (size_t r = 0 ; r < LINE_REPS ; r++){
+		interpret_clr(line, &state, print_out);
+	}
+	cout << "Evaluate '" << line << "': " << ns_per(start, LINE_REPS) << " ns" << endl;
+
+	return 0;
+}
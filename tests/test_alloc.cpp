@@ -0,0 +1,85 @@
+/*
+Checks that evaluating a line CLR has already seen does not allocate. Must be
+built with CLR_ALLOC_STATS (see the test_alloc target in clr_makefile). Each line
+is run a few times to warm up the interpreter's buffers, as in the REPL, and then
+MEMSTAT must report no allocations by the previous line.
+
+Run by 'make -f clr_makefile test' from the repository's root. Exits with 1 if
+any line allocates.
+
+Created by Grant Giesbrecht on 19.10.2026
+
+*/
+
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "../clr_interpret.hpp"
+#include "../clr_memstat.hpp"
+
+#define WARMUP_RUNS 3
+
+using namespace std;
+
+/*
+Runs 'line' on 'state' between alloc_stats_begin_line and alloc_stats_end_line,
+like the REPL. Returns false if it fails.
+*/
+static bool run_line(const string& line, clr_state* state, string& print_out){
+	alloc_stats_begin_line();
+	bool ran = interpret_clr(line, state, print_out);
+	alloc_stats_end_line();
+	return ran;
+}
+
+int main(){
+
+	if (!alloc_stats_enabled()){
+		cout << "FAIL: test_alloc must be built with -DCLR_ALLOC_STATS." << endl;
+		return 1;
+	}
+
+	ostringstream printed;
+	clr_state state;
+	init_state(&state, "", &printed);
+	if (!load_functions("tests/functions.list", "functions", &state)){
+		cout << "FAIL: Could not load tests/functions.list (run from the repository's root)." << endl;
+		return 1;
+	}
+
+	string print_out;
+	run_line("5", &state, print_out);
+	run_line("STO q", &state, print_out);
+
+	vector<string> lines = {"3;4+", "1;2*3+sin", "q;q*", "2 SQR"};
+	int failures = 0;
+	for (size_t l = 0 ; l < lines.size() ; l++){
+		for (size_t r = 0 ; r < WARMUP_RUNS ; r++){
+			if (!run_line(lines[l], &state, print_out)){
+				cout << "FAIL: '" << lines[l] << "' failed:" << endl << print_out;
+				return 1;
+			}
+		}
+
+		//Report, as MEMSTAT prints it, the allocations by the last run
+		printed.str("");
+		run_line("MEMSTAT", &state, print_out);
+		string report = printed.str();
+		const string label = "Allocations by previous line: ";
+		size_t at = report.find(label);
+		if (at == string::npos){
+			cout << "FAIL: MEMSTAT printed no allocations by the previous line:" << endl << report;
+			return 1;
+		}
+		unsigned long allocs = stoul(report.substr(at + label.length()));
+		if (allocs != 0){
+			cout << "FAIL: '" << lines[l] << "' made " << allocs << " allocations after warming up." << endl;
+			failures++;
+		}
+	}
+
+	if (failures > 0) return 1;
+	cout << "test_alloc: passed" << endl;
+	return 0;
+}
@@ -0,0 +1,73 @@
+/*
+Checks that words ending in a sign are lexed as the keywords S+ and S- only when
+that doesn't hide a variable or function: "x;s+" must still add the variable s.
+Also checks that option flags are matched in any case, like keywords.
+
+Run by 'make -f clr_makefile test'. Exits with 1 if any check fails.
+
+Created by Grant Giesbrecht on 19.10.2026
+
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include "../clr_api.h"
+
+static int failures = 0;
+
+/*
+Evaluates 'input' on 'h' and checks that it succeeds and leaves 'expected' in {x}.
+*/
+static void check_x(clr_handle* h, const char* input, double expected){
+	char out[1024];
+	double re, im;
+	if (clr_eval(h, input, strlen(input), out, sizeof(out), NULL) != CLR_OK){
+		printf("FAIL: '%s' failed:\n%s", input, out);
+		failures++;
+		return;
+	}
+	clr_get_register(h, 'x', &re, &im);
+	if (re != expected || im != 0){
+		printf("FAIL: '%s' left {x} = %g%+gi, expected %g\n", input, re, im, expected);
+		failures++;
+	}
+}
+
+/*
+Evaluates 'input' on 'h' and checks that it succeeds.
+*/
+static void check_ok(clr_handle* h, const char* input){
+	char out[1024];
+	if (clr_eval(h, input, strlen(input), out, sizeof(out), NULL) != CLR_OK){
+		printf("FAIL: '%s' failed:\n%s", input, out);
+		failures++;
+	}
+}
+
+int main(void){
+
+	clr_handle* h = clr_create();
+
+	//A variable named s is added, not fed to the statistics registers
+	check_x(h, "2\nSTO s\n5;s+", 7);
+	check_x(h, "10;s-", 8);
+	check_x(h, "SN", 0);
+
+	//...but S+ first on a line is still the keyword
+	check_x(h, "3\nS+\nSN", 1);
+
+	//With no variable s, s+ is the keyword in any case
+	clr_destroy(h);
+	h = clr_create();
+	check_x(h, "4\nS+\n6\ns+\nSMEAN", 5);
+
+	//Options are matched in any case
+	check_ok(h, "RAND -n 4");
+	check_ok(h, "RAND -N 4");
+
+	clr_destroy(h);
+
+	if (failures > 0) return 1;
+	printf("test_lex: passed\n");
+	return 0;
+}
@@ -0,0 +1,199 @@
+/*
+Runs sessions on separate threads through the C API, each with its own output
+callback, and checks that every session's output holds only its own lines, in
+order and unbroken, and that the sessions don't see each other's variables or
+functions. Every thread loads the same function list and uses the same shared
+library at once.
+
+Run by 'make -f clr_makefile test' from the repository's root. Exits with 1 if
+any check fails.
+
+Created by Grant Giesbrecht on 19.10.2026
+
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "../clr_api.h"
+
+#define SESSIONS 8
+#define ROUNDS 200
+
+/*
+Output of one session, appended to by its callback.
+
+text = Everything printed (NUL terminated)
+len = Length of 'text'
+size = Bytes allocated for 'text'
+*/
+typedef struct{
+	char* text;
+	size_t len;
+	size_t size;
+}output_buffer;
+
+/*
+A session run by one thread.
+
+id = Number of the session (its variable is v<id> and holds id+1)
+out = Its output
+failed = Set if any check fails
+message = Why it failed
+*/
+typedef struct{
+	int id;
+	output_buffer out;
+	int failed;
+	char message[256];
+}session;
+
+//Output callback: appends 'text' to the output_buffer 'user'
+static void collect_output(const char* text, size_t len, void* user){
+	output_buffer* buf = (output_buffer*)user;
+	if (buf->len + len + 1 > buf->size){
+		size_t size = 2*(buf->len + len + 1);
+		char* grown = (char*)realloc(buf->text, size);
+		if (grown == NULL) return; //Caught as missing output
+		buf->text = grown;
+		buf->size = size;
+	}
+	memcpy(buf->text + buf->len, text, len);
+	buf->len += len;
+	buf->text[buf->len] = 0;
+}
+
+/*
+Evaluates 'line' on 'h'. Returns 0 and records why in 's' if it fails.
+*/
+static int eval_line(clr_handle* h, session* s, const char* line){
+	char err[512];
+	if (clr_eval(h, line, strlen(line), err, sizeof(err), NULL) != CLR_OK){
+		snprintf(s->message, sizeof(s->message), "'%s' failed", line);
+		s->failed = 1;
+		return 0;
+	}
+	return 1;
+}
+
+/*
+Stores id+1 in v<id>, then each round clears the registers, runs SQR (an
+interpreted function) on v<id>, squares v<id> and prints the stack and
+variables. Every round must leave v<id>^2 in {x} and print the same thing.
+*/
+static void* run_session(void* arg){
+
+	session* s = (session*)arg;
+	double v = s->id + 1;
+	char line[64], square[64];
+
+	clr_handle* h = clr_create();
+	if (h == NULL){
+		snprintf(s->message, sizeof(s->message), "clr_create failed");
+		s->failed = 1;
+		return NULL;
+	}
+	if (clr_load_functions(h, "tests/functions.list", "functions") != CLR_OK){
+		snprintf(s->message, sizeof(s->message), "Could not load tests/functions.list (run from the repository's root)");
+		s->failed = 1;
+		clr_destroy(h);
+		return NULL;
+	}
+	clr_set_output(h, collect_output, &s->out);
+
+	snprintf(line, sizeof(line), "%d\nSTO v%d", s->id + 1, s->id);
+	eval_line(h, s, line);
+	snprintf(line, sizeof(line), "v%d SQR", s->id);
+	snprintf(square, sizeof(square), "v%d;v%d*", s->id, s->id);
+
+	for (int r = 0 ; r < ROUNDS && !s->failed ; r++){
+		double re, im;
+		if (!eval_line(h, s, "CLREG") || !eval_line(h, s, line) || !eval_line(h, s, square)) break;
+		clr_get_register(h, 'x', &re, &im);
+		if (re != v*v || im != 0){
+			snprintf(s->message, sizeof(s->message), "Round %d: '%s' left {x} = %g%+gi, expected %g", r, square, re, im, v*v);
+			s->failed = 1;
+		}
+		if (!eval_line(h, s, "STK") || !eval_line(h, s, "LSVAR")) break;
+	}
+
+	clr_destroy(h);
+	return NULL;
+}
+
+/*
+Checks that 's's output is ROUNDS copies of one round's output, which names its
+own variable and no other session's. Returns 0 and records why in 's' if not.
+*/
+static int check_output(session* s){
+
+	const char* text = (s->out.text != NULL) ? s->out.text : "";
+	if (s->out.len == 0 || s->out.len % ROUNDS != 0){
+		snprintf(s->message, sizeof(s->message), "Printed %zu bytes, not %d equal rounds", s->out.len, ROUNDS);
+		return 0;
+	}
+
+	size_t round_len = s->out.len/ROUNDS;
+	for (int r = 1 ; r < ROUNDS ; r++){
+		if (memcmp(text, text + r*round_len, round_len) != 0){
+			snprintf(s->message, sizeof(s->message), "Round %d printed something different from round 0", r);
+			return 0;
+		}
+	}
+
+	for (int o = 0 ; o < SESSIONS ; o++){
+		char name[32];
+		snprintf(name, sizeof(name), "\tv%d = ", o);
+		int found = (strstr(text, name) != NULL);
+		if (found != (o == s->id)){
+			snprintf(s->message, sizeof(s->message), found ? "Printed session %d's variable" : "Didn't print its variable v%d", o);
+			return 0;
+		}
+	}
+
+	return 1;
+}
+
+int main(void){
+
+	session sessions[SESSIONS];
+	pthread_t threads[SESSIONS];
+	int failures = 0;
+
+	memset(sessions, 0, sizeof(sessions));
+	for (int s = 0 ; s < SESSIONS ; s++){
+		sessions[s].id = s;
+		if (pthread_create(&threads[s], NULL, run_session, &sessions[s]) != 0){
+			printf("FAIL: Could not start thread %d\n", s);
+			return 1;
+		}
+	}
+	for (int s = 0 ; s < SESSIONS ; s++) pthread_join(threads[s], NULL);
+
+	for (int s = 0 ; s < SESSIONS ; s++){
+		if (!sessions[s].failed && !check_output(&sessions[s])) sessions[s].failed = 1;
+		if (sessions[s].failed){
+			printf("FAIL: Session %d: %s\n", s, sessions[s].message);
+			failures++;
+		}
+		free(sessions[s].out.text);
+	}
+
+	//A new session must not see anything the others loaded or stored
+	clr_handle* h = clr_create();
+	char out[1024];
+	if (clr_eval(h, "2 SQR", 5, out, sizeof(out), NULL) == CLR_OK){
+		printf("FAIL: A new session can call SQR without loading it\n");
+		failures++;
+	}
+	if (clr_eval(h, "LSVAR", 5, out, sizeof(out), NULL) != CLR_OK || strstr(out, "\tv0 = ") != NULL){
+		printf("FAIL: A new session lists another session's variables:\n%s", out);
+		failures++;
+	}
+	clr_destroy(h);
+
+	if (failures > 0) return 1;
+	printf("test_sessions: passed\n");
+	return 0;
+}